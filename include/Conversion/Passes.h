@@ -7,6 +7,7 @@
 #include "Conversion/BtorToMemref/ConvertBtorToMemrefPass.h"
 #include "Conversion/BtorToVector/ConvertBtorToVectorPass.h"
 
+#include "Conversion/ebpfToBtor/ConvertebpfToBtorPass.h"
 #include "Conversion/ebpfToLLVM/ConvertebpfToLLVMPass.h"
 
 namespace mlir {
@@ -0,0 +1,20 @@
+#ifndef EBPF_CONVERSION_EBPFTOBTOR_CONVERTEBPFTOBTORPASS_H_
+#define EBPF_CONVERSION_EBPFTOBTOR_CONVERTEBPFTOBTORPASS_H_
+
+#include <memory>
+
+#include "Dialect/Btor/IR/Btor.h"
+#include "Dialect/ebpf/IR/ebpf.h"
+
+namespace mlir {
+class Pass;
+
+namespace ebpf {
+
+/// Creates a pass to encode ebpf functions as btor transition systems.
+std::unique_ptr<mlir::Pass> createConvertebpfToBtorPass();
+
+} // namespace ebpf
+} // namespace mlir
+
+#endif // EBPF_CONVERSION_EBPFTOBTOR_CONVERTEBPFTOBTORPASS_H_
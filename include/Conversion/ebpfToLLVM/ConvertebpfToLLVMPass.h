@@ -16,9 +16,12 @@ class Pass;
 
 namespace ebpf {
 
-/// Collect a set of patterns to lower from ebpf to LLVM dialect
+/// Collect a set of patterns to lower from ebpf to LLVM dialect. With
+/// `nativeRuntime`, maps and helper calls are lowered to calls into the
+/// ebpf runtime library instead of non-deterministic values.
 void populateebpfToLLVMConversionPatterns(ebpfToLLVMTypeConverter &converter,
-                                          RewritePatternSet &patterns);
+                                          RewritePatternSet &patterns,
+                                          bool nativeRuntime = false);
 
 /// Creates a pass to convert the ebpf dialect into the LLVM dialect.
 std::unique_ptr<mlir::Pass> createLowerToLLVMPass();
@@ -35,4 +35,15 @@
 #define GET_OP_CLASSES
 #include "Dialect/ebpf/IR/ebpfOps.h.inc"
 
+namespace mlir {
+namespace ebpf {
+
+/// Module attribute with the maps of the imported object, as a Nx5 tensor
+/// with one (fd, type, key size, value size, max entries) row per map
+inline constexpr llvm::StringLiteral MapsAttrName = "ebpf.maps";
+constexpr size_t MapDescriptorFields = 5;
+
+} // namespace ebpf
+} // namespace mlir
+
 #endif // EBPF_EBPFOPS_H
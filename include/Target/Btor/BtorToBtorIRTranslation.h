@@ -30,6 +30,18 @@ class ModuleOp;
 
 namespace btor {
 
+/// Layout of the model that --import-btor builds
+enum class BtorABI {
+  /// a _main function that runs the model forever
+  Main,
+  /// init, step, bad and constraint functions over the states of the model
+  Step
+};
+
+struct ImportOptions {
+  BtorABI abi = BtorABI::Main;
+};
+
 /// Deserializes the given Btor module and creates a MLIR ModuleOp
 /// in the given `context`. Makes use of btor2parser.
 
@@ -88,6 +100,14 @@ public:
 
   OwningOpRef<mlir::FuncOp> buildMainFunction();
 
+  const std::vector<Btor2Line *> &getStates() const { return m_states; }
+  const std::vector<Btor2Line *> &getInputs() const { return m_inputLines; }
+  const std::vector<Btor2Line *> &getBads() const { return m_bads; }
+
+  /// Adds the functions of the step ABI to module
+  /// @return false if the model cannot be laid out for the step ABI
+  bool buildStepFunctions(ModuleOp module);
+
   btor::BitVecType getBVType(Type opType) {
     return opType.dyn_cast<btor::BitVecType>();
   }
@@ -102,6 +122,7 @@ private:
   StringAttr m_sourceFile = nullptr;
 
   std::vector<Btor2Line *> m_states;
+  std::vector<Btor2Line *> m_inputLines; // in order of input #
   std::vector<Btor2Line *> m_bads;
   std::vector<Btor2Line *> m_nexts;
   std::vector<Btor2Line *> m_constraints;
@@ -148,6 +169,10 @@ private:
                                        Block *body);
   std::vector<Value>
   collectReturnValuesForInit(const std::vector<Type> &returnTypes);
+  FuncOp buildStepABIFunction(ModuleOp module, StringRef name,
+                              const std::vector<Type> &argumentTypes,
+                              const std::vector<Type> &resultTypes);
+  Value buildConditionOf(Btor2Line *line);
 
   // Builder wrappers
   Type getTypeOf(const Btor2Line *line) {
@@ -355,8 +380,10 @@ private:
   }
 };
 
-/// Register the Btor translation
-void registerFromBtorTranslation();
+/// Register the Btor translation. The options are read when the translation
+/// runs, so that they may be bound to command line options, and must outlive
+/// the registration.
+void registerFromBtorTranslation(const ImportOptions &options);
 
 } // namespace btor
 } // namespace mlir
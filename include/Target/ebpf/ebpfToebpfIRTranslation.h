@@ -15,7 +15,12 @@
 #include "mlir/IR/BuiltinOps.h"
 #include "mlir/IR/OwningOpRef.h"
 #include "mlir/Support/LLVM.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
+#include <array>
+#include <bitset>
 #include <fstream>
 #include <map>
 #include <utility>
@@ -29,47 +34,61 @@ class ModuleOp;
 
 namespace ebpf {
 
-/// Deserializes the given ebpf module and creates a MLIR ModuleOp
-/// in the given `context`.
+/// What the importer reports besides the module it builds. The tools own
+/// the command line options that set these.
+struct ImportOptions {
+  /// trace every instruction and block the importer builds
+  bool trace = false;
+  /// do not print the instruction, block and map counts of the import
+  bool quiet = false;
+};
 
-class Deserialize {
+/// True when the import is traced, either through its options or through
+/// -debug-only=ebpf-import
+bool isTraceEnabled(const ImportOptions &options);
+
+/// Builds the body of a single ebpf program section as a FuncOp. Each
+/// instance owns its builder and bookkeeping, so that different sections
+/// can be built concurrently into separate regions.
+
+class SectionBuilder {
 
 public:
   ///===----------------------------------------------------------------------===//
   /// Constructors and Destructors
   ///===----------------------------------------------------------------------===//
 
-  Deserialize(MLIRContext *context, const std::string &s, bool ssa)
-      : m_context(context), m_builder(OpBuilder(m_context)),
-        m_unknownLoc(UnknownLoc::get(m_context)), m_ssa(ssa) {
-    m_modelFile.open(s.c_str());
-    m_sourceFile = m_builder.getStringAttr(s);
+  SectionBuilder(MLIRContext *context, const InstructionSeq &section,
+                 const std::string &name, bool ssa, bool trace)
+      : m_section(section), m_name(name), m_context(context),
+        m_builder(OpBuilder(m_context)),
+        m_unknownLoc(UnknownLoc::get(m_context)), m_ssa(ssa),
+        m_trace(trace) {
+    indexLabels();
   }
 
-  ~Deserialize() {}
+  ~SectionBuilder() {}
 
   ///===----------------------------------------------------------------------===//
-  /// Parse ebpf2 file
-  ///===----------------------------------------------------------------------===//
-
-  bool parseModelIsSuccessful();
-
-  ///===----------------------------------------------------------------------===//
-  /// Create MLIR module
+  /// Create MLIR function
   ///===----------------------------------------------------------------------===//
 
   OwningOpRef<mlir::FuncOp> buildXDPFunction();
   void buildMemFunctionBody();
   void buildSSAFunctionBody();
 
+  size_t getNumInstructions() const { return m_section.size(); }
+  size_t getNumBlocks() const { return m_jumpBlocks.size(); }
+
 private:
   ///===----------------------------------------------------------------------===//
-  /// Parse ebpf file
+  /// ebpf section
   ///===----------------------------------------------------------------------===//
 
-  std::ifstream m_modelFile;
-  StringAttr m_sourceFile = nullptr;
+  const InstructionSeq &m_section;
+  const std::string m_name;
   const size_t m_ebpfRegisters = 11;
+  const int64_t m_stackSize = 512;
   // const size_t m_xdpParameters = 2;
 
   enum REG : size_t {
@@ -86,10 +105,10 @@ private:
     R10_STACK_POINTER = 10
   };
 
-  std::vector<InstructionSeq> m_sections;
   std::vector<size_t> m_startOfNextBlock;
   std::vector<mlir::Value> m_registers;
   std::map<size_t, size_t> m_jmpTargets;
+  std::vector<size_t> m_labelToIndex;
 
   size_t m_numBlocks = 0;
   void incrementBlocks(size_t jmpTo) {
@@ -99,7 +118,12 @@ private:
     }
   }
 
-  size_t getInsByLabel(const size_t label) { return m_jmpTargets.at(label); }
+  void indexLabels();
+
+  size_t getInsByLabel(const size_t label) {
+    assert(label < m_labelToIndex.size());
+    return m_labelToIndex[label];
+  }
 
   bool setInsWithLabel(const size_t label) {
     if (m_jmpTargets.contains(label))
@@ -115,18 +139,24 @@ private:
   OpBuilder m_builder;
   Location m_unknownLoc;
   bool m_ssa;
+  bool m_trace;
+
+  /// Prints to stderr through print when the import is traced
+  void trace(llvm::function_ref<void(llvm::raw_ostream &)> print) const;
 
   std::vector<Block *> m_blocks;
   Block *m_lastBlock = nullptr;
   std::map<size_t, Block *> m_jumpBlocks;
 
-  void createMLIR(Instruction ins, label_t cur_label);
-  void createJmpOp(Jmp jmp, label_t cur_label);
-  void createBinaryOp(Bin bin);
-  void createUnaryOp(Un un);
-  void createMemOp(Mem mem);
-  void createLoadMapOp(LoadMapFd loadMap);
+  void createMLIR(const Instruction &ins, const label_t &cur_label);
+  void createJmpOp(const Jmp &jmp, const label_t &cur_label);
+  void createBinaryOp(const Bin &bin);
+  void createUnaryOp(const Un &un);
+  void createMemOp(const Mem &mem);
+  void createLoadMapOp(const LoadMapFd &loadMap);
+  void createCallOp(const Call &call);
   void createNDOp();
+  void createAccessCheck(const Mem &mem);
   void collectBlocks();
 
   void updateBlocksMap(Block *block, size_t firstOp) {
@@ -134,6 +164,78 @@ private:
     m_jumpBlocks[firstOp] = block;
   }
 
+  ///===----------------------------------------------------------------------===//
+  /// Register liveness
+  ///===----------------------------------------------------------------------===//
+
+  using RegisterSet = std::bitset<REG::R10_STACK_POINTER + 1>;
+
+  /// registers that are live on entry to the block starting at a label
+  std::map<size_t, RegisterSet> m_liveIn;
+  /// registers passed as arguments to each block, in argument order
+  std::map<Block *, std::vector<uint8_t>> m_blockRegisters;
+
+  static void getUsesAndDefs(const Instruction &ins, RegisterSet &uses,
+                             RegisterSet &defs);
+  void computeBlockGraph(std::vector<size_t> &starts,
+                         std::vector<std::vector<size_t>> &succs);
+  void computeLiveness();
+
+  /// index one past the last instruction of block `b`
+  size_t getBlockEnd(const std::vector<size_t> &starts, size_t b) {
+    return b + 1 < starts.size() ? getInsByLabel(starts[b + 1])
+                                 : m_section.size();
+  }
+
+  /// registers that may hold the null result of a map lookup on entry to
+  /// the block starting at a label
+  std::map<size_t, RegisterSet> m_mayBeNullIn;
+  /// the same registers at the instruction that is being built
+  RegisterSet m_mayBeNull;
+
+  static void updateMayBeNull(const Instruction &ins, RegisterSet &mayBeNull);
+  void computeMayBeNull();
+
+  /// Create the block that starts at `label`. In SSA mode, only the
+  /// registers that are live on entry to it become block arguments.
+  Block *createBlockAt(Region *region, size_t label) {
+    std::vector<uint8_t> registers;
+    if (m_ssa) {
+      const auto &live = m_liveIn.at(label);
+      for (uint8_t i = 0; i < m_ebpfRegisters; ++i) {
+        if (live.test(i))
+          registers.push_back(i);
+      }
+    }
+    std::vector<Type> argTypes(registers.size(), m_builder.getI64Type());
+    std::vector<Location> argLocs(registers.size(), m_unknownLoc);
+    auto *block = m_builder.createBlock(region, {}, {argTypes}, {argLocs});
+    m_blockRegisters[block] = std::move(registers);
+    updateBlocksMap(block, label);
+    return block;
+  }
+
+  std::vector<mlir::Value> getBlockOperands(Block *block) {
+    std::vector<mlir::Value> operands;
+    for (auto idx : m_blockRegisters.at(block)) {
+      assert(m_registers.at(idx) && "live register was never defined");
+      operands.push_back(m_registers.at(idx));
+    }
+    return operands;
+  }
+
+  /// Point the registers at the arguments of the block; in SSA mode the
+  /// registers that are not live on entry are left undefined
+  void setRegistersFromBlock(Block *block) {
+    if (!m_ssa)
+      return;
+    std::fill(m_registers.begin(), m_registers.end(), nullptr);
+    const auto &registers = m_blockRegisters.at(block);
+    for (size_t i = 0; i < registers.size(); ++i) {
+      setRegister(registers[i], block->getArgument(i));
+    }
+  }
+
   void setRegister(const uint8_t idx, const mlir::Value &value) {
     if (m_ssa) {
       m_registers.at(idx) = value;
@@ -185,53 +287,40 @@ private:
     }
   }
 
-  void buildJmpOp(size_t from, Jmp jmp) {
+  void buildJmpOp(size_t from, const Jmp &jmp) {
     OpBuilder::InsertionGuard guard(m_builder);
     m_builder.setInsertionPointToEnd(m_lastBlock);
     auto opPosition = m_builder.getInsertionPoint();
     // new blocks
     Block *condBlock = nullptr, *toBlock = nullptr;
-    std::vector<Location> returnLocs(m_ebpfRegisters, m_unknownLoc);
     Block *curBlock = m_lastBlock;
 
     size_t to = jmp.target.from;
     bool isConditional = jmp.cond.has_value();
     assert(to > from && "backjumps not implemented yet");
 
-    if (isConditional) {
-      if (!m_jumpBlocks.contains(from + 1)) {
-        // create the another block for the next operation
-        if (m_ssa) {
-          condBlock = m_builder.createBlock(curBlock->getParent(), {},
-                                            {curBlock->getArgumentTypes()},
-                                            {returnLocs});
-        } else {
-          condBlock = m_builder.createBlock(curBlock->getParent(), {});
-        }
-        updateBlocksMap(condBlock, from + 1);
-        std::cerr << "*** create condBlock at: " << from + 1 << std::endl;
-      } else {
-        condBlock = m_jumpBlocks.at(from + 1);
-      }
+    if (!m_jumpBlocks.contains(from + 1)) {
+      // create the another block for the next operation
+      condBlock = createBlockAt(curBlock->getParent(), from + 1);
+      trace([&](llvm::raw_ostream &os) {
+        os << "create condBlock at: " << from + 1 << "\n";
+      });
+    } else {
+      condBlock = m_jumpBlocks.at(from + 1);
     }
     if (!m_jumpBlocks.contains(to)) {
       // create the to block
-      if (m_ssa) {
-        toBlock =
-            m_builder.createBlock(curBlock->getParent(), {},
-                                  {curBlock->getArgumentTypes()}, {returnLocs});
-      } else {
-        toBlock = m_builder.createBlock(curBlock->getParent(), {});
-      }
-      updateBlocksMap(toBlock, to);
-      std::cerr << "*** create toBlock at: " << to << std::endl;
+      toBlock = createBlockAt(curBlock->getParent(), to);
+      trace([&](llvm::raw_ostream &os) {
+        os << "create toBlock at: " << to << "\n";
+      });
     } else {
       toBlock = m_jumpBlocks.at(to);
     }
     // create branch operation for original block
     m_builder.setInsertionPoint(curBlock, opPosition);
     if (isConditional) {
-      auto cond = jmp.cond.value();
+      const auto &cond = jmp.cond.value();
       auto lhsId = cond.left.v;
       Value rhs;
       if (std::holds_alternative<Imm>(cond.right)) {
@@ -243,20 +332,16 @@ private:
       }
       auto cmpOp = m_builder.create<CmpOp>(m_unknownLoc, getPred(cond.op),
                                            getRegister(lhsId), rhs);
-      if (m_ssa) {
-        m_builder.create<CondBranchOp>(m_unknownLoc, cmpOp, toBlock,
-                                       m_registers, condBlock, m_registers);
-      } else {
-        m_builder.create<CondBranchOp>(m_unknownLoc, cmpOp, toBlock, condBlock);
-      }
+      m_builder.create<CondBranchOp>(m_unknownLoc, cmpOp, toBlock,
+                                     getBlockOperands(toBlock), condBlock,
+                                     getBlockOperands(condBlock));
     } else {
-      if (m_ssa) {
-        m_builder.create<BranchOp>(m_unknownLoc, condBlock, m_registers);
-      } else {
-        m_builder.create<BranchOp>(m_unknownLoc, condBlock);
-      }
+      m_builder.create<BranchOp>(m_unknownLoc, toBlock,
+                                 getBlockOperands(toBlock));
     }
-    std::cerr << "/**/ end block at: " << from << std::endl;
+    trace([&](llvm::raw_ostream &os) {
+      os << "end block at: " << from << "\n";
+    });
     m_lastBlock = condBlock;
     return;
   }
@@ -265,7 +350,6 @@ private:
     auto type = m_builder.getI64Type();
     auto immVal = m_builder.create<ebpf::ConstantOp>(
         m_unknownLoc, type, m_builder.getIntegerAttr(type, imm.v));
-    std::cerr << "--created imm const: " << imm.v << std::endl;
     return immVal;
   }
 
@@ -273,7 +357,6 @@ private:
     auto type = m_builder.getI64Type();
     auto immVal = m_builder.create<ebpf::ConstantOp>(
         m_unknownLoc, type, m_builder.getIntegerAttr(type, value));
-    std::cerr << "--created val const: " << value << std::endl;
     return immVal;
   }
 
@@ -284,7 +367,8 @@ private:
   }
 
   template <typename ebpfOp>
-  mlir::Value buildStoreOp(const Value &base, const Value &offset, Mem mem) {
+  mlir::Value buildStoreOp(const Value &base, const Value &offset,
+                           const Mem &mem) {
     Value writeVal;
     if (std::holds_alternative<Imm>(mem.value)) {
       writeVal = buildConstantOp(std::get<Imm>(mem.value));
@@ -301,9 +385,56 @@ private:
   }
 };
 
-/// Register the ebpf translation
-void registerebpfTranslation();
-void registerebpfMemTranslation();
+/// Deserializes the given ebpf object and creates a MLIR ModuleOp
+/// in the given `context`, with one function per program section.
+
+class Deserialize {
+
+public:
+  ///===----------------------------------------------------------------------===//
+  /// Constructors and Destructors
+  ///===----------------------------------------------------------------------===//
+
+  Deserialize(MLIRContext *context, const std::string &s, bool ssa,
+              const ImportOptions &options)
+      : m_context(context), m_ssa(ssa), m_trace(isTraceEnabled(options)),
+        m_summary(!options.quiet) {
+    m_modelFile.open(s.c_str());
+  }
+
+  ~Deserialize() {}
+
+  ///===----------------------------------------------------------------------===//
+  /// Parse ebpf file
+  ///===----------------------------------------------------------------------===//
+
+  bool parseModelIsSuccessful();
+
+  ///===----------------------------------------------------------------------===//
+  /// Create MLIR module
+  ///===----------------------------------------------------------------------===//
+
+  void buildModule(ModuleOp module);
+
+private:
+  std::ifstream m_modelFile;
+  MLIRContext *m_context;
+  bool m_ssa;
+  bool m_trace;
+  bool m_summary;
+
+  std::vector<InstructionSeq> m_sections;
+  std::vector<std::string> m_sectionNames;
+  std::map<int, std::array<int64_t, MapDescriptorFields>> m_mapDescriptors;
+
+  std::string getFunctionName(const std::string &section);
+};
+
+/// Register the ebpf translation. The options are read when a translation
+/// runs, so that they may be bound to command line options, and must outlive
+/// the registration.
+void registerebpfTranslation(const ImportOptions &options);
+void registerebpfMemTranslation(const ImportOptions &options);
 
 } // namespace ebpf
 } // namespace mlir
@@ -5,6 +5,7 @@
 #include "mlir/Conversion/LLVMCommon/ConversionTarget.h"
 #include "mlir/Conversion/LLVMCommon/VectorPattern.h"
 #include "mlir/Dialect/LLVMIR/LLVMDialect.h"
+#include "mlir/Dialect/StandardOps/IR/Ops.h"
 
 #include <string>
 
@@ -32,11 +33,60 @@ Value getNDValueHelper(Op op, mlir::ConversionPatternRewriter &rewriter,
   return callND;
 }
 
+/// Print a value wider than 64 bits through wordHelper, which takes the id,
+/// the number of the word, the word and the width, from the lowest word up
+template <typename Op>
+void createPrintWordsHelper(Op op, const Value ndValue,
+                            const std::string wordHelper,
+                            mlir::ConversionPatternRewriter &rewriter,
+                            ModuleOp module, Type resultType) {
+  auto loc = op.getLoc();
+  auto i64Type = rewriter.getI64Type();
+  if (!module.lookupSymbol<LLVM::LLVMFuncOp>(wordHelper)) {
+    OpBuilder::InsertionGuard printerGuard(rewriter);
+    rewriter.setInsertionPointToStart(module.getBody());
+    auto wordFuncTy = LLVM::LLVMFunctionType::get(
+        LLVM::LLVMVoidType::get(rewriter.getContext()),
+        {i64Type, i64Type, i64Type, i64Type});
+    rewriter.create<LLVM::LLVMFuncOp>(rewriter.getUnknownLoc(), wordHelper,
+                                      wordFuncTy);
+  }
+  auto constant = [&](Type type, int64_t value) -> Value {
+    return rewriter.create<LLVM::ConstantOp>(
+        loc, type, rewriter.getIntegerAttr(type, value));
+  };
+  const unsigned width = resultType.getIntOrFloatBitWidth();
+  Value value = ndValue;
+  if (ndValue.getType() != resultType) {
+    value = rewriter.create<LLVM::ZExtOp>(loc, resultType, ndValue);
+  }
+  Value ndValueId =
+      rewriter.create<LLVM::ConstantOp>(loc, i64Type, op.idAttr());
+  Value ndValueWidth = constant(i64Type, width);
+  for (unsigned word = 0; word * 64 < width; ++word) {
+    Value shifted = value;
+    if (word > 0) {
+      shifted = rewriter.create<LLVM::LShrOp>(loc, value,
+                                              constant(resultType, word * 64));
+    }
+    Value bits = rewriter.create<LLVM::TruncOp>(loc, i64Type, shifted);
+    rewriter.create<LLVM::CallOp>(
+        loc, TypeRange({}), wordHelper,
+        ValueRange({ndValueId, constant(i64Type, word), bits, ndValueWidth}));
+  }
+}
+
 template <typename Op>
 void createPrintFunctionHelper(Op op, const Value ndValue,
                                const std::string printHelper,
+                               const std::string wordHelper,
                                mlir::ConversionPatternRewriter &rewriter,
                                ModuleOp module, Type resultType) {
+  if (resultType.getIntOrFloatBitWidth() > 64) {
+    createPrintWordsHelper(op, ndValue, wordHelper, rewriter, module,
+                           resultType);
+    return;
+  }
   auto printFunc = module.lookupSymbol<LLVM::LLVMFuncOp>(printHelper);
   auto i64Type = rewriter.getI64Type();
   if (!printFunc) {
@@ -55,16 +105,11 @@ void createPrintFunctionHelper(Op op, const Value ndValue,
       rewriter.create<LLVM::ZExtOp>(op.getLoc(), i64Type, ndValueWidth);
   Value ndValueId = rewriter.create<LLVM::ConstantOp>(
       op.getLoc(), rewriter.getI64Type(), op.idAttr());
-  // TODO: We need to handle values with bitwidth > 64
-  auto needsExt = ndValue.getType().getIntOrFloatBitWidth() <= 64;
-  if (needsExt) {
-    Value zextNDValue =
-        rewriter.create<LLVM::ZExtOp>(op.getLoc(), i64Type, ndValue);
-    rewriter.create<LLVM::CallOp>(
-        op.getLoc(), TypeRange({}), printHelper,
-        ValueRange({ndValueId, zextNDValue, zextNDWidth}));
-    return;
-  }
+  Value zextNDValue =
+      rewriter.create<LLVM::ZExtOp>(op.getLoc(), i64Type, ndValue);
+  rewriter.create<LLVM::CallOp>(
+      op.getLoc(), TypeRange({}), printHelper,
+      ValueRange({ndValueId, zextNDValue, zextNDWidth}));
 }
 
 //===----------------------------------------------------------------------===//
@@ -81,8 +126,9 @@ struct NDStateOpLowering : public ConvertOpToLLVMPattern<btor::NDStateOp> {
     auto callND = getNDValueHelper(op, rewriter, module, opType);
     // add helper function for printing
     std::string printHelper = "btor2mlir_print_state_num";
-    createPrintFunctionHelper(op, callND, printHelper, rewriter, module,
-                              opType);
+    std::string wordHelper = "btor2mlir_print_state_word";
+    createPrintFunctionHelper(op, callND, printHelper, wordHelper, rewriter,
+                              module, opType);
     if (opType.getIntOrFloatBitWidth() <
         callND.getType().getIntOrFloatBitWidth()) {
       rewriter.replaceOpWithNewOp<LLVM::TruncOp>(op, TypeRange({opType}),
@@ -104,8 +150,9 @@ struct InputOpLowering : public ConvertOpToLLVMPattern<btor::InputOp> {
     auto callND = getNDValueHelper(op, rewriter, module, opType);
     // add helper function for printing
     std::string printHelper = "btor2mlir_print_input_num";
-    createPrintFunctionHelper(op, callND, printHelper, rewriter, module,
-                              opType);
+    std::string wordHelper = "btor2mlir_print_input_word";
+    createPrintFunctionHelper(op, callND, printHelper, wordHelper, rewriter,
+                              module, opType);
     if (opType.getIntOrFloatBitWidth() <
         callND.getType().getIntOrFloatBitWidth()) {
       rewriter.replaceOpWithNewOp<LLVM::TruncOp>(op, TypeRange({opType}),
@@ -116,6 +163,161 @@ struct InputOpLowering : public ConvertOpToLLVMPattern<btor::InputOp> {
     return success();
   }
 };
+
+//===----------------------------------------------------------------------===//
+// Checkpoints
+//===----------------------------------------------------------------------===//
+
+LLVM::LLVMFuncOp getOrInsertHook(ModuleOp module, OpBuilder &builder,
+                                 StringRef name, Type result,
+                                 ArrayRef<Type> params) {
+  if (auto func = module.lookupSymbol<LLVM::LLVMFuncOp>(name)) {
+    return func;
+  }
+  OpBuilder::InsertionGuard guard(builder);
+  builder.setInsertionPointToStart(module.getBody());
+  return builder.create<LLVM::LLVMFuncOp>(
+      builder.getUnknownLoc(), name,
+      LLVM::LLVMFunctionType::get(result, params));
+}
+
+/// @return the width of a bit-vector state that the hooks can record, or 0
+unsigned getRecordedWidth(Type type) {
+  unsigned width = 0;
+  if (auto bitVecType = type.dyn_cast<btor::BitVecType>()) {
+    width = bitVecType.getWidth();
+  } else if (auto integerType = type.dyn_cast<IntegerType>()) {
+    width = integerType.getWidth();
+  }
+  return width <= 64 ? width : 0;
+}
+
+/// @return value as an integer of its width, which the lowering of the btor
+/// dialect resolves once the states are integers
+Value castToInteger(OpBuilder &builder, Location loc, Value value,
+                    unsigned width) {
+  auto integerType = builder.getIntegerType(width);
+  if (value.getType() == integerType) {
+    return value;
+  }
+  return builder
+      .create<UnrealizedConversionCastOp>(loc, TypeRange({integerType}),
+                                          ValueRange({value}))
+      .getResult(0);
+}
+
+/// @brief Let the runtime see and replace the states of the main loop: a
+/// call at the head of the loop asks whether the states are due to be
+/// recorded, and the initial states can be replaced by recorded ones when
+/// the runtime resumes a run. States are named by their BTOR2 ids, from the
+/// btor.state_ids attribute of the importer, or else by their position in
+/// the loop. Only bit-vectors of up to 64 bits are recorded; a model with
+/// other states cannot be resumed.
+/// @param func, the main function with an init block and a loop block
+void insertCheckpoints(FuncOp func) {
+  Region &region = func.getBody();
+  if (region.getBlocks().size() != 2) {
+    return;
+  }
+  Block &entry = region.front();
+  Block *loop = &region.back();
+  auto initBranch = dyn_cast<BranchOp>(entry.getTerminator());
+  if (!initBranch || initBranch.getDest() != loop) {
+    return;
+  }
+
+  auto module = func->getParentOfType<ModuleOp>();
+  OpBuilder builder(func.getContext());
+  auto loc = func.getLoc();
+  auto i1Type = builder.getI1Type();
+  auto i64Type = builder.getI64Type();
+  auto voidType = LLVM::LLVMVoidType::get(func.getContext());
+  auto resumeFunc =
+      getOrInsertHook(module, builder, "btor2mlir_resume", i1Type, {i1Type});
+  auto resumeStateFunc = getOrInsertHook(
+      module, builder, "btor2mlir_resume_state", i64Type, {i64Type});
+  auto dueFunc =
+      getOrInsertHook(module, builder, "btor2mlir_checkpoint_due", i1Type, {});
+  auto printFunc =
+      getOrInsertHook(module, builder, "btor2mlir_print_checkpoint_num",
+                      voidType, {i64Type, i64Type, i64Type});
+
+  auto stateIds = func->getAttrOfType<ArrayAttr>(
+      btor::BtorDialect::getStateIdsAttrName());
+  if (stateIds && stateIds.size() != loop->getNumArguments()) {
+    stateIds = nullptr;
+  }
+  auto getStateId = [&](unsigned i) -> int64_t {
+    if (!stateIds) {
+      return i;
+    }
+    return stateIds.getValue()[i].cast<IntegerAttr>().getInt();
+  };
+  auto constant = [&](int64_t value) {
+    return builder.create<LLVM::ConstantOp>(
+        loc, i64Type, builder.getI64IntegerAttr(value));
+  };
+  const bool resumable =
+      llvm::all_of(loop->getArgumentTypes(),
+                   [](Type type) { return getRecordedWidth(type) != 0; });
+
+  // the runtime answers before any initial state is drawn
+  builder.setInsertionPointToStart(&entry);
+  Value isResumable = builder.create<LLVM::ConstantOp>(
+      loc, i1Type, builder.getBoolAttr(resumable));
+  Value resume =
+      builder.create<LLVM::CallOp>(loc, resumeFunc, ValueRange({isResumable}))
+          .getResult(0);
+  if (resumable) {
+    builder.setInsertionPoint(initBranch);
+    for (unsigned i = 0; i < initBranch.getNumOperands(); ++i) {
+      Value init = initBranch.getOperand(i);
+      const unsigned width = getRecordedWidth(init.getType());
+      Value recorded =
+          builder.create<LLVM::CallOp>(loc, resumeStateFunc,
+                                       ValueRange({constant(getStateId(i))}))
+              .getResult(0);
+      if (width != 64) {
+        recorded = builder.create<LLVM::TruncOp>(
+            loc, builder.getIntegerType(width), recorded);
+      }
+      Value selected = builder.create<LLVM::SelectOp>(
+          loc, resume, recorded, castToInteger(builder, loc, init, width));
+      if (selected.getType() != init.getType()) {
+        selected = builder
+                       .create<UnrealizedConversionCastOp>(
+                           loc, TypeRange({init.getType()}),
+                           ValueRange({selected}))
+                       .getResult(0);
+      }
+      initBranch.setOperand(i, selected);
+    }
+  }
+
+  // ^loop(states): cond_br due, ^record, ^body
+  Block *body = loop->splitBlock(loop->begin());
+  Block *record = builder.createBlock(body);
+  builder.setInsertionPointToEnd(loop);
+  Value due = builder.create<LLVM::CallOp>(loc, dueFunc, ValueRange())
+                  .getResult(0);
+  builder.create<LLVM::CondBrOp>(loc, due, record, body);
+  builder.setInsertionPointToEnd(record);
+  for (BlockArgument state : loop->getArguments()) {
+    const unsigned width = getRecordedWidth(state.getType());
+    if (!width) {
+      continue;
+    }
+    Value value = castToInteger(builder, loc, state, width);
+    if (width != 64) {
+      value = builder.create<LLVM::ZExtOp>(loc, i64Type, value);
+    }
+    builder.create<LLVM::CallOp>(
+        loc, printFunc,
+        ValueRange({constant(getStateId(state.getArgNumber())), value,
+                    constant(width)}));
+  }
+  builder.create<LLVM::BrOp>(loc, ValueRange(), body);
+}
 } // end anonymous namespace
 
 //===----------------------------------------------------------------------===//
@@ -140,6 +342,12 @@ struct BtorNDToLLVMLoweringPass
     RewritePatternSet patterns(&getContext());
     BtorToLLVMTypeConverter converter(&getContext());
 
+    if (checkpoints) {
+      if (auto main = getOperation().lookupSymbol<FuncOp>("_main")) {
+        insertCheckpoints(main);
+      }
+    }
+
     mlir::btor::populateBTORNDTOLLVMConversionPatterns(converter, patterns);
 
     target.addIllegalOp<btor::NDStateOp, btor::InputOp>();
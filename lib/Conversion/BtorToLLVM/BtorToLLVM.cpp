@@ -7,8 +7,11 @@
 #include "mlir/Conversion/StandardToLLVM/ConvertStandardToLLVM.h"
 #include "mlir/Dialect/LLVMIR/LLVMDialect.h"
 #include "mlir/Dialect/MemRef/IR/MemRef.h"
+#include "mlir/Dialect/StandardOps/IR/Ops.h"
 #include "mlir/IR/TypeRange.h"
 #include "mlir/IR/TypeUtilities.h"
+#include "mlir/Interfaces/ControlFlowInterfaces.h"
+#include "llvm/Support/MathExtras.h"
 
 #include <string>
 
@@ -743,6 +746,590 @@ URemOpLowering::matchAndRewrite(mlir::btor::URemOp op, OpAdaptor adaptor,
   return success();
 }
 
+//===----------------------------------------------------------------------===//
+// Coverage Counters
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+constexpr StringLiteral coverageCounters = "btor2mlir_coverage";
+constexpr StringLiteral coverageSize = "btor2mlir_coverage_size";
+
+/// @return the width of a bit-vector, or 0 for other types
+unsigned getBitVecWidth(Type type) {
+  if (auto bitVecType = type.dyn_cast<btor::BitVecType>()) {
+    return bitVecType.getWidth();
+  }
+  if (auto integerType = type.dyn_cast<IntegerType>()) {
+    return integerType.getWidth();
+  }
+  return 0;
+}
+
+/// @return the bit-vector value as the integer that it is lowered to. The
+/// instrumentation is built before the conversion, and its casts fold away
+/// when the btor operations are lowered.
+Value castToInteger(OpBuilder &builder, Location loc, Value value) {
+  auto integerType = builder.getIntegerType(getBitVecWidth(value.getType()));
+  if (value.getType() == integerType) {
+    return value;
+  }
+  return builder
+      .create<UnrealizedConversionCastOp>(loc, TypeRange({integerType}),
+                                          ValueRange({value}))
+      .getResult(0);
+}
+
+/// @brief Adds zext(condition) to the 8-bit counter at index, wrapping
+/// around like the inline counters of SanitizerCoverage
+void incrementCounter(OpBuilder &builder, Location loc, Value counters,
+                      unsigned index, Value condition) {
+  auto i8Type = builder.getI8Type();
+  Value offset = builder.create<LLVM::ConstantOp>(
+      loc, builder.getI64Type(), builder.getI64IntegerAttr(index));
+  Value counter = builder.create<LLVM::GEPOp>(loc, counters.getType(),
+                                              counters, ValueRange{offset});
+  Value count = builder.create<LLVM::LoadOp>(loc, counter);
+  Value increment = builder.create<LLVM::ZExtOp>(loc, i8Type, condition);
+  builder.create<LLVM::StoreOp>(
+      loc, builder.create<LLVM::AddOp>(loc, count, increment), counter);
+}
+
+/// @brief Counts, in a global array of 8-bit counters, how often each bit
+/// of a state toggles from one step to the next, each arm of an ite is
+/// taken, and each bad or constraint is false and true.
+/// The counters of the state bits come first, least significant bit first,
+/// followed by two counters for each ite, bad and constraint of the loop, in
+/// the order of the operations: the first one counts a false condition.
+/// @param main, _main as built by the btor importer
+void insertCoverageCounters(ModuleOp module, Operation *main) {
+  Region &region = main->getRegion(0);
+  if (region.empty()) {
+    return;
+  }
+  auto initBranch = dyn_cast<BranchOpInterface>(region.front().getTerminator());
+  if (!initBranch || initBranch->getNumSuccessors() != 1) {
+    return;
+  }
+  Block *loop = initBranch->getSuccessor(0);
+  BranchOpInterface backEdge;
+  for (Block &block : region) {
+    auto branch = dyn_cast<BranchOpInterface>(block.getTerminator());
+    if (&block != &region.front() && branch &&
+        branch->getNumSuccessors() == 1 && branch->getSuccessor(0) == loop) {
+      backEdge = branch;
+    }
+  }
+  if (!backEdge) {
+    return;
+  }
+
+  unsigned size = 0;
+  for (BlockArgument state : loop->getArguments()) {
+    size += getBitVecWidth(state.getType());
+  }
+  SmallVector<Operation *> conditions;
+  for (Block &block : llvm::drop_begin(region.getBlocks())) {
+    for (Operation &op : block) {
+      if (isa<btor::IteOp, btor::AssertNotOp, btor::ConstraintOp>(op)) {
+        conditions.push_back(&op);
+      }
+    }
+  }
+  size += 2 * conditions.size();
+  if (size == 0) {
+    return;
+  }
+
+  OpBuilder builder(module.getContext());
+  auto loc = main->getLoc();
+  auto i8Type = builder.getI8Type();
+  auto i64Type = builder.getI64Type();
+  auto arrayType = LLVM::LLVMArrayType::get(i8Type, size);
+  builder.setInsertionPointToStart(module.getBody());
+  auto global = builder.create<LLVM::GlobalOp>(
+      loc, arrayType, /*isConstant=*/false, LLVM::Linkage::External,
+      coverageCounters,
+      DenseElementsAttr::get(RankedTensorType::get({size}, i8Type),
+                             APInt(8, 0)));
+  builder.create<LLVM::GlobalOp>(loc, i64Type, /*isConstant=*/true,
+                                 LLVM::Linkage::External, coverageSize,
+                                 builder.getI64IntegerAttr(size));
+
+  builder.setInsertionPointToStart(loop);
+  Value counters = builder.create<LLVM::BitcastOp>(
+      loc, LLVM::LLVMPointerType::get(i8Type),
+      builder.create<LLVM::AddressOfOp>(loc, global));
+
+  // state bits that differ between this step and the next
+  unsigned index = 0;
+  builder.setInsertionPoint(backEdge);
+  auto next = *backEdge.getSuccessorOperands(0);
+  for (BlockArgument state : loop->getArguments()) {
+    const unsigned width = getBitVecWidth(state.getType());
+    if (!width) {
+      continue;
+    }
+    auto type = builder.getIntegerType(width);
+    Value toggled = builder.create<LLVM::XOrOp>(
+        loc, castToInteger(builder, loc, state),
+        castToInteger(builder, loc, next[state.getArgNumber()]));
+    for (unsigned bit = 0; bit < width; ++bit) {
+      Value shifted = toggled;
+      if (bit > 0) {
+        shifted = builder.create<LLVM::LShrOp>(
+            loc, toggled,
+            builder.create<LLVM::ConstantOp>(
+                loc, type, builder.getIntegerAttr(type, bit)));
+      }
+      Value isSet =
+          builder.create<LLVM::TruncOp>(loc, builder.getI1Type(), shifted);
+      incrementCounter(builder, loc, counters, index++, isSet);
+    }
+  }
+
+  // both outcomes of each condition, counted before it is used
+  for (Operation *op : conditions) {
+    builder.setInsertionPoint(op);
+    Value condition = castToInteger(builder, op->getLoc(), op->getOperand(0));
+    Value isFalse = builder.create<LLVM::XOrOp>(
+        op->getLoc(), condition,
+        builder.create<LLVM::ConstantOp>(op->getLoc(), builder.getI1Type(),
+                                         builder.getBoolAttr(true)));
+    incrementCounter(builder, op->getLoc(), counters, index++, isFalse);
+    incrementCounter(builder, op->getLoc(), counters, index++, condition);
+  }
+}
+} // end anonymous namespace
+
+//===----------------------------------------------------------------------===//
+// Constraint Retries
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+LLVM::LLVMFuncOp getOrInsertHook(ModuleOp module, OpBuilder &builder,
+                                 StringRef name, Type result) {
+  if (auto func = module.lookupSymbol<LLVM::LLVMFuncOp>(name)) {
+    return func;
+  }
+  OpBuilder::InsertionGuard guard(builder);
+  builder.setInsertionPointToStart(module.getBody());
+  return builder.create<LLVM::LLVMFuncOp>(
+      builder.getUnknownLoc(), name, LLVM::LLVMFunctionType::get(result, {}));
+}
+
+/// @brief Lets the runtime reject the values drawn in a step that violate a
+/// constraint: the step starts over from the same states, which are block
+/// arguments of the loop, as long as btor2mlir_retry_step allows it. The
+/// constraint is only assumed once the runtime gives up. Each step begins
+/// with a call to btor2mlir_step_begin. The constraints of the init block
+/// are assumed as before, since there is no step to start over.
+/// The branches are std operations on the btor values, so that they are
+/// lowered along with the rest of _main.
+/// @param main, _main as built by the btor importer
+void insertConstraintRetries(ModuleOp module, Operation *main) {
+  Region &region = main->getRegion(0);
+  if (region.empty()) {
+    return;
+  }
+  auto initBranch = dyn_cast<BranchOpInterface>(region.front().getTerminator());
+  if (!initBranch || initBranch->getNumSuccessors() != 1) {
+    return;
+  }
+  Block *loop = initBranch->getSuccessor(0);
+  // arrays lowered to memrefs are updated in place
+  if (!llvm::all_of(loop->getArgumentTypes(), [](Type type) {
+        return type.isa<btor::BitVecType, IntegerType, VectorType>();
+      })) {
+    return;
+  }
+  SmallVector<btor::ConstraintOp> constraints;
+  // the init block is left out
+  for (Block &block : llvm::drop_begin(region.getBlocks())) {
+    for (auto constraint : block.getOps<btor::ConstraintOp>()) {
+      constraints.push_back(constraint);
+    }
+  }
+  if (constraints.empty()) {
+    return;
+  }
+
+  OpBuilder builder(module.getContext());
+  auto voidType = LLVM::LLVMVoidType::get(module.getContext());
+  auto stepBeginFunc =
+      getOrInsertHook(module, builder, "btor2mlir_step_begin", voidType);
+  auto retryFunc = getOrInsertHook(module, builder, "btor2mlir_retry_step",
+                                   builder.getI1Type());
+  builder.setInsertionPointToStart(loop);
+  builder.create<LLVM::CallOp>(main->getLoc(), stepBeginFunc, ValueRange());
+
+  SmallVector<Value> states(loop->getArguments().begin(),
+                            loop->getArguments().end());
+  for (auto constraint : constraints) {
+    // ^bb: ... cond_br %c, ^continue, ^reject
+    // ^reject: cond_br retry(), ^loop(states), ^assume
+    // ^assume: btor.constraint(%c); br ^continue
+    auto loc = constraint.getLoc();
+    Block *block = constraint->getBlock();
+    Block *continuation =
+        block->splitBlock(std::next(Block::iterator(constraint)));
+    Block *assume = builder.createBlock(continuation);
+    Block *reject = builder.createBlock(assume);
+
+    builder.setInsertionPointToEnd(block);
+    builder.create<CondBranchOp>(
+        loc, castToInteger(builder, loc, constraint.constraint()),
+        continuation, reject);
+    builder.setInsertionPointToEnd(reject);
+    Value retry =
+        builder.create<LLVM::CallOp>(loc, retryFunc, ValueRange()).getResult(0);
+    builder.create<CondBranchOp>(loc, retry, loop, states, assume,
+                                 ValueRange());
+    constraint->moveBefore(assume, assume->end());
+    builder.setInsertionPointToEnd(assume);
+    builder.create<BranchOp>(loc, continuation);
+  }
+}
+} // end anonymous namespace
+
+//===----------------------------------------------------------------------===//
+// Step ABI
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+/// @brief Where a state or an input lives in its packed 64-bit words
+struct PackedField {
+  // bit offset of the value, or of the first element of an array
+  unsigned offset = 0;
+  unsigned width = 0;
+  // zero for bit-vectors
+  unsigned indexWidth = 0;
+  // bits per element of an array
+  unsigned stride = 0;
+};
+
+/// @brief Packs bit-vectors, widest first, into the first word with room
+/// for them, so that no value narrower than a word straddles two words.
+/// Values of 64 bits or more start a word of their own. The elements of
+/// arrays follow out of line, each in the fewest power of two bytes that
+/// hold it.
+/// @return the number of words
+unsigned layoutPackedFields(ArrayRef<Type> types,
+                            SmallVectorImpl<PackedField> &fields) {
+  fields.assign(types.size(), PackedField());
+  SmallVector<unsigned> order;
+  for (unsigned i = 0; i < types.size(); ++i) {
+    if (types[i].isa<IntegerType>()) {
+      order.push_back(i);
+    }
+  }
+  llvm::stable_sort(order, [&](unsigned lhs, unsigned rhs) {
+    return types[lhs].getIntOrFloatBitWidth() >
+           types[rhs].getIntOrFloatBitWidth();
+  });
+  // bits used in each word
+  SmallVector<unsigned> used;
+  for (unsigned i : order) {
+    PackedField &field = fields[i];
+    field.width = types[i].getIntOrFloatBitWidth();
+    if (field.width >= 64) {
+      field.offset = used.size() * 64;
+      used.append(llvm::divideCeil(field.width, 64), 64);
+      continue;
+    }
+    auto word = llvm::find_if(
+        used, [&](unsigned bits) { return bits + field.width <= 64; });
+    if (word == used.end()) {
+      used.push_back(0);
+      word = std::prev(used.end());
+    }
+    field.offset = (word - used.begin()) * 64 + *word;
+    *word += field.width;
+  }
+
+  unsigned words = used.size();
+  for (unsigned i = 0; i < types.size(); ++i) {
+    auto vectorType = types[i].dyn_cast<VectorType>();
+    if (!vectorType) {
+      continue;
+    }
+    PackedField &field = fields[i];
+    field.width = vectorType.getElementTypeBitWidth();
+    field.indexWidth = llvm::Log2_64(vectorType.getNumElements());
+    field.stride = std::max<uint64_t>(8, llvm::PowerOf2Ceil(field.width));
+    field.offset = words * 64;
+    words += llvm::divideCeil(vectorType.getNumElements() * field.stride, 64);
+  }
+  return words;
+}
+
+Value buildI64Constant(OpBuilder &builder, Location loc, uint64_t value) {
+  return builder.create<LLVM::ConstantOp>(
+      loc, builder.getI64Type(),
+      builder.getI64IntegerAttr(static_cast<int64_t>(value)));
+}
+
+Value buildWordAddress(OpBuilder &builder, Location loc, Value words,
+                       unsigned index) {
+  return builder.create<LLVM::GEPOp>(
+      loc, words.getType(), words,
+      ValueRange{buildI64Constant(builder, loc, index)});
+}
+
+/// @brief Reads the elements of an array, in order of their index
+Value loadPackedArray(OpBuilder &builder, Location loc, Value words,
+                      const PackedField &field, VectorType type) {
+  auto storageType = builder.getIntegerType(field.stride);
+  Value elements = builder.create<LLVM::BitcastOp>(
+      loc, LLVM::LLVMPointerType::get(storageType),
+      buildWordAddress(builder, loc, words, field.offset / 64));
+  Value array = builder.create<LLVM::UndefOp>(loc, type);
+  for (int64_t i = 0; i < type.getNumElements(); ++i) {
+    Value index = buildI64Constant(builder, loc, i);
+    Value element = builder.create<LLVM::LoadOp>(
+        loc, builder.create<LLVM::GEPOp>(loc, elements.getType(), elements,
+                                         ValueRange{index}));
+    if (field.stride != field.width) {
+      element =
+          builder.create<LLVM::TruncOp>(loc, type.getElementType(), element);
+    }
+    array = builder.create<LLVM::InsertElementOp>(loc, type, array, element,
+                                                  index);
+  }
+  return array;
+}
+
+void storePackedArray(OpBuilder &builder, Location loc, Value words,
+                      const PackedField &field, Value array) {
+  auto type = array.getType().cast<VectorType>();
+  auto storageType = builder.getIntegerType(field.stride);
+  Value elements = builder.create<LLVM::BitcastOp>(
+      loc, LLVM::LLVMPointerType::get(storageType),
+      buildWordAddress(builder, loc, words, field.offset / 64));
+  for (int64_t i = 0; i < type.getNumElements(); ++i) {
+    Value index = buildI64Constant(builder, loc, i);
+    Value element = builder.create<LLVM::ExtractElementOp>(
+        loc, type.getElementType(), array, index);
+    if (field.stride != field.width) {
+      element = builder.create<LLVM::ZExtOp>(loc, storageType, element);
+    }
+    builder.create<LLVM::StoreOp>(
+        loc, element,
+        builder.create<LLVM::GEPOp>(loc, elements.getType(), elements,
+                                    ValueRange{index}));
+  }
+}
+
+Value loadPackedField(OpBuilder &builder, Location loc, Value words,
+                      const PackedField &field, Type type) {
+  if (auto vectorType = type.dyn_cast<VectorType>()) {
+    return loadPackedArray(builder, loc, words, field, vectorType);
+  }
+  const unsigned word = field.offset / 64;
+  if (field.width > 64) {
+    Value value;
+    for (unsigned i = 0; i < llvm::divideCeil(field.width, 64); ++i) {
+      Value part = builder.create<LLVM::ZExtOp>(
+          loc, type,
+          builder.create<LLVM::LoadOp>(
+              loc, buildWordAddress(builder, loc, words, word + i)));
+      if (i > 0) {
+        part = builder.create<LLVM::ShlOp>(
+            loc, part,
+            builder.create<LLVM::ConstantOp>(
+                loc, type, builder.getIntegerAttr(type, 64 * i)));
+      }
+      if (value) {
+        part = builder.create<LLVM::OrOp>(loc, value, part);
+      }
+      value = part;
+    }
+    return value;
+  }
+  Value value = builder.create<LLVM::LoadOp>(
+      loc, buildWordAddress(builder, loc, words, word));
+  if (const unsigned bit = field.offset % 64) {
+    value = builder.create<LLVM::LShrOp>(loc, value,
+                                         buildI64Constant(builder, loc, bit));
+  }
+  if (field.width < 64) {
+    value = builder.create<LLVM::TruncOp>(loc, type, value);
+  }
+  return value;
+}
+
+/// @brief Writes value into its bits, keeping the other fields of its word
+void storePackedField(OpBuilder &builder, Location loc, Value words,
+                      const PackedField &field, Value value) {
+  if (value.getType().isa<VectorType>()) {
+    storePackedArray(builder, loc, words, field, value);
+    return;
+  }
+  auto i64Type = builder.getI64Type();
+  const unsigned word = field.offset / 64;
+  if (field.width > 64) {
+    for (unsigned i = 0; i < llvm::divideCeil(field.width, 64); ++i) {
+      Value part = value;
+      if (i > 0) {
+        part = builder.create<LLVM::LShrOp>(
+            loc, value,
+            builder.create<LLVM::ConstantOp>(
+                loc, value.getType(),
+                builder.getIntegerAttr(value.getType(), 64 * i)));
+      }
+      builder.create<LLVM::StoreOp>(
+          loc, builder.create<LLVM::TruncOp>(loc, i64Type, part),
+          buildWordAddress(builder, loc, words, word + i));
+    }
+    return;
+  }
+  Value address = buildWordAddress(builder, loc, words, word);
+  if (field.width == 64) {
+    builder.create<LLVM::StoreOp>(loc, value, address);
+    return;
+  }
+  const unsigned bit = field.offset % 64;
+  Value bits = builder.create<LLVM::ZExtOp>(loc, i64Type, value);
+  if (bit) {
+    bits = builder.create<LLVM::ShlOp>(loc, bits,
+                                       buildI64Constant(builder, loc, bit));
+  }
+  const uint64_t kept = ~(llvm::maskTrailingOnes<uint64_t>(field.width) << bit);
+  Value others = builder.create<LLVM::AndOp>(
+      loc, builder.create<LLVM::LoadOp>(loc, address),
+      buildI64Constant(builder, loc, kept));
+  builder.create<LLVM::StoreOp>(
+      loc, builder.create<LLVM::OrOp>(loc, others, bits), address);
+}
+
+/// @brief Describes packed fields with the globals <prefix>_words,
+/// <prefix>_count and <prefix>_layout, which holds the offset, width, index
+/// width and stride of each field
+void insertLayoutGlobals(OpBuilder &builder, Location loc, StringRef prefix,
+                         unsigned words, ArrayRef<PackedField> fields) {
+  auto i64Type = builder.getI64Type();
+  builder.create<LLVM::GlobalOp>(loc, i64Type, /*isConstant=*/true,
+                                 LLVM::Linkage::External,
+                                 (prefix + "_words").str(),
+                                 builder.getI64IntegerAttr(words));
+  builder.create<LLVM::GlobalOp>(loc, i64Type, /*isConstant=*/true,
+                                 LLVM::Linkage::External,
+                                 (prefix + "_count").str(),
+                                 builder.getI64IntegerAttr(fields.size()));
+  if (fields.empty()) {
+    return;
+  }
+  SmallVector<int64_t> layout;
+  for (const PackedField &field : fields) {
+    layout.append({field.offset, field.width, field.indexWidth, field.stride});
+  }
+  const int64_t size = layout.size();
+  builder.create<LLVM::GlobalOp>(
+      loc, LLVM::LLVMArrayType::get(i64Type, size), /*isConstant=*/true,
+      LLVM::Linkage::External, (prefix + "_layout").str(),
+      DenseElementsAttr::get(RankedTensorType::get({size}, i64Type),
+                             ArrayRef<int64_t>(layout)));
+}
+
+/// @brief Wraps the functions of the step abi, built by the btor importer
+/// with --abi=step, into entry points over packed states and inputs:
+///   void btor_init(uint64_t *state);
+///   void btor_step(uint64_t *state, const uint64_t *inputs);
+///   uint64_t btor_bad(const uint64_t *state, const uint64_t *inputs);
+///   int btor_constraint(const uint64_t *state, const uint64_t *inputs);
+/// The globals btor_state_* and btor_input_* describe the layout.
+void insertStepABI(ModuleOp module) {
+  auto initFunc = module.lookupSymbol<LLVM::LLVMFuncOp>("btor_init_values");
+  auto stepFunc = module.lookupSymbol<LLVM::LLVMFuncOp>("btor_step_values");
+  auto badFunc = module.lookupSymbol<LLVM::LLVMFuncOp>("btor_bad_values");
+  auto constraintFunc =
+      module.lookupSymbol<LLVM::LLVMFuncOp>("btor_constraint_values");
+  if (!initFunc || !stepFunc || !badFunc || !constraintFunc) {
+    return;
+  }
+  ArrayRef<Type> types = stepFunc.getType().getParams();
+  const unsigned numStates = initFunc.getType().getNumParams();
+  SmallVector<PackedField> stateFields, inputFields;
+  const unsigned stateWords =
+      layoutPackedFields(types.take_front(numStates), stateFields);
+  const unsigned inputWords =
+      layoutPackedFields(types.drop_front(numStates), inputFields);
+
+  OpBuilder builder(module.getContext());
+  auto loc = stepFunc.getLoc();
+  builder.setInsertionPointToEnd(module.getBody());
+  insertLayoutGlobals(builder, loc, "btor_state", stateWords, stateFields);
+  insertLayoutGlobals(builder, loc, "btor_input", inputWords, inputFields);
+
+  auto wordsType = LLVM::LLVMPointerType::get(builder.getI64Type());
+  auto buildEntry = [&](StringRef name, Type result, unsigned numArguments) {
+    builder.setInsertionPointToEnd(module.getBody());
+    auto func = builder.create<LLVM::LLVMFuncOp>(
+        loc, name,
+        LLVM::LLVMFunctionType::get(
+            result, SmallVector<Type>(numArguments, wordsType)));
+    Block *entry = func.addEntryBlock();
+    builder.setInsertionPointToStart(entry);
+    return entry;
+  };
+  auto loadArguments = [&](Block *entry, unsigned numArguments) {
+    SmallVector<Value> arguments;
+    for (unsigned i = 0; i < numArguments; ++i) {
+      const bool isState = i < numStates;
+      arguments.push_back(loadPackedField(
+          builder, loc, entry->getArgument(isState ? 0 : 1),
+          isState ? stateFields[i] : inputFields[i - numStates], types[i]));
+    }
+    return arguments;
+  };
+  auto storeStates = [&](Block *entry, LLVM::CallOp call) {
+    if (numStates == 0) {
+      return;
+    }
+    Value result = call.getResult(0);
+    for (unsigned i = 0; i < numStates; ++i) {
+      Value state = result;
+      // multiple results are returned in a struct
+      if (numStates > 1) {
+        state = builder.create<LLVM::ExtractValueOp>(
+            loc, types[i], result, builder.getI64ArrayAttr(i));
+      }
+      storePackedField(builder, loc, entry->getArgument(0), stateFields[i],
+                       state);
+    }
+  };
+  auto voidType = LLVM::LLVMVoidType::get(module.getContext());
+
+  Block *entry = buildEntry("btor_init", voidType, 1);
+  storeStates(entry, builder.create<LLVM::CallOp>(
+                         loc, initFunc, loadArguments(entry, numStates)));
+  builder.create<LLVM::ReturnOp>(loc, ValueRange());
+
+  entry = buildEntry("btor_step", voidType, 2);
+  storeStates(entry, builder.create<LLVM::CallOp>(
+                         loc, stepFunc, loadArguments(entry, types.size())));
+  builder.create<LLVM::ReturnOp>(loc, ValueRange());
+
+  entry = buildEntry("btor_bad", builder.getI64Type(), 2);
+  Value bads =
+      builder
+          .create<LLVM::CallOp>(loc, badFunc, loadArguments(entry, types.size()))
+          .getResult(0);
+  builder.create<LLVM::ReturnOp>(loc, bads);
+
+  entry = buildEntry("btor_constraint", builder.getI32Type(), 2);
+  Value holds = builder
+                    .create<LLVM::CallOp>(loc, constraintFunc,
+                                          loadArguments(entry, types.size()))
+                    .getResult(0);
+  builder.create<LLVM::ReturnOp>(
+      loc, ValueRange{builder.create<LLVM::ZExtOp>(loc, builder.getI32Type(),
+                                                   holds)});
+}
+} // end anonymous namespace
+
 //===----------------------------------------------------------------------===//
 // Pass Definition
 //===----------------------------------------------------------------------===//
@@ -768,6 +1355,16 @@ void BtorToLLVMLoweringPass::runOnOperation() {
   RewritePatternSet patterns(&getContext());
   BtorToLLVMTypeConverter converter(&getContext(), true);
 
+  if (auto main = SymbolTable::lookupSymbolIn(getOperation(), "_main")) {
+    // the counters of a constraint count every attempt
+    if (coverage) {
+      insertCoverageCounters(getOperation(), main);
+    }
+    if (retryConstraints) {
+      insertConstraintRetries(getOperation(), main);
+    }
+  }
+
   mlir::btor::populateBtorToLLVMConversionPatterns(converter, patterns);
   mlir::populateStdToLLVMConversionPatterns(converter, patterns);
 
@@ -807,7 +1404,10 @@ void BtorToLLVMLoweringPass::runOnOperation() {
   if (failed(applyPartialConversion(getOperation(), target,
                                     std::move(patterns)))) {
     signalPassFailure();
+    return;
   }
+  // the entry points call the lowered functions of the step abi
+  insertStepABI(getOperation());
 }
 
 //===----------------------------------------------------------------------===//
@@ -19,11 +19,59 @@ LogicalResult shouldConvertToVector(Type &arrayType) {
   return failure();
 }
 
+/// Print an element wider than 64 bits through wordHelper, which takes the
+/// id, the index, the number of the word, the word and the width, from the
+/// lowest word up
+template <typename Op>
+void createPrintWordsHelper(Op op, const Value ndValue, const int64_t index,
+                            const std::string wordHelper,
+                            mlir::ConversionPatternRewriter &rewriter,
+                            ModuleOp module, Type resultType) {
+  auto loc = op.getLoc();
+  auto i64Type = rewriter.getI64Type();
+  if (!module.lookupSymbol<LLVM::LLVMFuncOp>(wordHelper)) {
+    OpBuilder::InsertionGuard printerGuard(rewriter);
+    rewriter.setInsertionPointToStart(module.getBody());
+    auto wordFuncTy = LLVM::LLVMFunctionType::get(
+        LLVM::LLVMVoidType::get(rewriter.getContext()),
+        {i64Type, i64Type, i64Type, i64Type, i64Type});
+    rewriter.create<LLVM::LLVMFuncOp>(rewriter.getUnknownLoc(), wordHelper,
+                                      wordFuncTy);
+  }
+  auto constant = [&](Type type, int64_t value) -> Value {
+    return rewriter.create<LLVM::ConstantOp>(
+        loc, type, rewriter.getIntegerAttr(type, value));
+  };
+  const unsigned width = resultType.getIntOrFloatBitWidth();
+  Value ndValueId =
+      rewriter.create<LLVM::ConstantOp>(loc, i64Type, op.idAttr());
+  Value indexInArray = constant(i64Type, index);
+  Value ndValueWidth = constant(i64Type, width);
+  for (unsigned word = 0; word * 64 < width; ++word) {
+    Value shifted = ndValue;
+    if (word > 0) {
+      shifted = rewriter.create<LLVM::LShrOp>(loc, ndValue,
+                                              constant(resultType, word * 64));
+    }
+    Value bits = rewriter.create<LLVM::TruncOp>(loc, i64Type, shifted);
+    rewriter.create<LLVM::CallOp>(loc, TypeRange({}), wordHelper,
+                                  ValueRange({ndValueId, indexInArray,
+                                              constant(i64Type, word), bits,
+                                              ndValueWidth}));
+  }
+}
+
 template <typename Op>
 void createPrintFunctionHelper(Op op, const Value ndValue, const int64_t index,
                                const std::string printHelper,
+                               const std::string wordHelper,
                                mlir::ConversionPatternRewriter &rewriter,
                                ModuleOp module, Type resultType) {
+  if (resultType.getIntOrFloatBitWidth() > 64) {
+    createPrintWordsHelper(op, ndValue, index, wordHelper, rewriter, module,
+                           resultType);
+    return;
+  }
   auto printFunc = module.lookupSymbol<LLVM::LLVMFuncOp>(printHelper);
   auto i64Type = rewriter.getI64Type();
   if (!printFunc) {
@@ -44,16 +92,11 @@ void createPrintFunctionHelper(Op op, const Value ndValue, const int64_t index,
       op.getLoc(), rewriter.getI64Type(), op.idAttr());
   Value indexInArray = rewriter.create<LLVM::ConstantOp>(
       op.getLoc(), rewriter.getI64Type(), rewriter.getI64IntegerAttr(index));
-  // TODO: We need to handle values with bitwidth > 64
-  auto needsExt = ndValue.getType().getIntOrFloatBitWidth() <= 64;
-  if (needsExt) {
-    Value zextNDValue =
-        rewriter.create<LLVM::ZExtOp>(op.getLoc(), i64Type, ndValue);
-    rewriter.create<LLVM::CallOp>(
-        op.getLoc(), TypeRange({}), printHelper,
-        ValueRange({ndValueId, indexInArray, zextNDValue, zextNDWidth}));
-    return;
-  }
+  Value zextNDValue =
+      rewriter.create<LLVM::ZExtOp>(op.getLoc(), i64Type, ndValue);
+  rewriter.create<LLVM::CallOp>(
+      op.getLoc(), TypeRange({}), printHelper,
+      ValueRange({ndValueId, indexInArray, zextNDValue, zextNDWidth}));
 }
 
 unsigned numConcats(unsigned opWidth, unsigned ndFunc = 32) {
@@ -140,8 +183,9 @@ struct ArrayOpLowering : public ConvertOpToLLVMPattern<mlir::btor::ArrayOp> {
       rewriter.create<memref::StoreOp>(loc, callND, newArray,
                                        ValueRange({idx}));
       std::string printHelper = "btor2mlir_print_array_state_num";
-      createPrintFunctionHelper(arrayOp, callND, i, printHelper, rewriter,
-                                module, memType.getElementType());
+      std::string wordHelper = "btor2mlir_print_array_state_word";
+      createPrintFunctionHelper(arrayOp, callND, i, printHelper, wordHelper,
+                                rewriter, module, memType.getElementType());
     }
     rewriter.replaceOp(arrayOp, newArray);
     return success();
@@ -0,0 +1,680 @@
+#include "Conversion/ebpfToBtor/ConvertebpfToBtorPass.h"
+#include "Dialect/Btor/IR/Btor.h"
+#include "Dialect/ebpf/IR/ebpf.h"
+
+#include "../PassDetail.h"
+#include "mlir/Dialect/StandardOps/IR/Ops.h"
+#include "mlir/IR/Builders.h"
+#include "mlir/IR/BuiltinOps.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/TypeSwitch.h"
+#include "llvm/Support/MathExtras.h"
+
+#include <vector>
+
+using namespace mlir;
+
+#define PASS_NAME "convert-ebpf-to-btor"
+#define EBPF_REGISTERS 11
+#define EBPF_STACK_POINTER 10
+#define EBPF_STACK_SIZE 512
+#define EBPF_STACK_INDEX_WIDTH 9
+/* above 4GB, so that the 32bit packet pointers of xdp_md never alias it */
+#define EBPF_STACK_TOP 0x200000000
+
+namespace {
+
+//===----------------------------------------------------------------------===//
+// Transition System Builder
+//===----------------------------------------------------------------------===//
+
+/// Encodes an ebpf function as a btor transition system that executes one of
+/// its basic blocks per step. Every block is evaluated on the current state,
+/// and the program counter selects which one determines the next state.
+///
+/// Block arguments are passed through register slots: the i-th argument of a
+/// block reads slot i, so the entry block reads r0 to r10. Values that are
+/// used outside of their block get a state of their own. Once the function
+/// returns, the program counter stays at its exit value with r0 holding the
+/// returned value.
+class TransitionSystemBuilder {
+public:
+  explicit TransitionSystemBuilder(FuncOp func)
+      : m_func(func), m_context(func.getContext()), m_builder(m_context),
+        m_loc(func.getLoc()) {}
+
+  /// Build the transition system, or return null if an op has no encoding
+  FuncOp build();
+
+private:
+  FuncOp m_func;
+  MLIRContext *m_context;
+  OpBuilder m_builder;
+  Location m_loc;
+
+  ///===--------------------------------------------------------------------===//
+  /// State layout: pc, register slots, carried values, stack and memory
+  ///===--------------------------------------------------------------------===//
+
+  std::vector<Block *> m_blocks;
+  llvm::DenseMap<Block *, unsigned> m_blockIndex;
+  llvm::DenseMap<Value, unsigned> m_carried;
+  unsigned m_numSlots = EBPF_REGISTERS;
+  unsigned m_pcWidth = 1;
+
+  unsigned getPcState() const { return 0; }
+  unsigned getSlotState(unsigned i) const { return 1 + i; }
+  unsigned getCarriedState(unsigned i) const { return 1 + m_numSlots + i; }
+  unsigned getStackState() const { return 1 + m_numSlots + m_carried.size(); }
+  unsigned getMemoryState() const { return getStackState() + 1; }
+  unsigned getNumStates() const { return getMemoryState() + 1; }
+
+  LogicalResult analyze();
+  std::vector<Type> getStateTypes();
+  std::vector<Value> buildInit(const std::vector<Type> &stateTypes);
+
+  ///===--------------------------------------------------------------------===//
+  /// Next state
+  ///===--------------------------------------------------------------------===//
+
+  std::vector<Value> m_states;
+  std::vector<Value> m_pcIs;
+  // the value each state takes after the blocks that change it
+  std::vector<std::vector<std::pair<unsigned, Value>>> m_updates;
+  unsigned m_nextInput = 0;
+  unsigned m_nextBad = 0;
+
+  void update(unsigned state, unsigned block, Value value) {
+    m_updates.at(state).emplace_back(block, value);
+  }
+  std::vector<Value> buildNext();
+
+  ///===--------------------------------------------------------------------===//
+  /// Encoding of the current block
+  ///===--------------------------------------------------------------------===//
+
+  unsigned m_curBlock = 0;
+  llvm::DenseMap<Value, Value> m_values;
+  Value m_stack, m_memory;
+
+  LogicalResult encodeBlock(Block &block);
+  LogicalResult encodeOp(Operation &op);
+  LogicalResult encodeTerminator(Operation &op);
+  Value lookup(Value value);
+
+  void setResult(Operation *op, Value value) {
+    m_values[op->getResult(0)] = value;
+  }
+
+  Type convertType(Type type) {
+    return btor::BitVecType::get(m_context, type.getIntOrFloatBitWidth());
+  }
+
+  unsigned getWidth(Value value) {
+    return value.getType().cast<btor::BitVecType>().getWidth();
+  }
+
+  Value buildConstant(unsigned width, const APInt &value) {
+    return m_builder.create<btor::ConstantOp>(
+        m_loc, btor::BitVecType::get(m_context, width),
+        m_builder.getIntegerAttr(m_builder.getIntegerType(width, false),
+                                 value.zextOrTrunc(width)));
+  }
+
+  Value buildConstant(unsigned width, uint64_t value) {
+    return buildConstant(width, APInt(64, value));
+  }
+
+  Value buildInput(Type type) {
+    return m_builder.create<btor::InputOp>(
+        m_loc, type,
+        m_builder.getIntegerAttr(m_builder.getIntegerType(64, false),
+                                 m_nextInput++));
+  }
+
+  Value buildIte(Value condition, Value lhs, Value rhs) {
+    if (lhs == rhs)
+      return lhs;
+    return m_builder.create<btor::IteOp>(m_loc, condition, lhs, rhs);
+  }
+
+  Value buildSlice(Value value, unsigned upper, unsigned lower);
+  Value buildConcat(Value high, Value low);
+  Value buildZExt(Value value, unsigned width);
+  Value buildByteOrder(Value value, unsigned width, bool swap);
+
+  template <typename btorOp, typename ebpfOp>
+  LogicalResult encodeBinaryOp(ebpfOp op) {
+    setResult(op, m_builder.create<btorOp>(m_loc, lookup(op.lhs()),
+                                           lookup(op.rhs())));
+    return success();
+  }
+
+  template <typename btorOp, typename ebpfOp>
+  LogicalResult encodeShiftOp(ebpfOp op);
+
+  template <typename btorOp, typename ebpfOp>
+  LogicalResult encodeDivOp(ebpfOp op, bool keepDividend);
+
+  ///===--------------------------------------------------------------------===//
+  /// Memory
+  ///===--------------------------------------------------------------------===//
+
+  Value getStackIndex(Value address, Value &inStack);
+  Value buildReadByte(Value address);
+  void buildWriteByte(Value address, Value byte);
+  Value buildLoad(Value base, Value offset, unsigned bytes);
+  void buildStore(Value base, Value offset, Value value, unsigned bytes);
+};
+
+LogicalResult TransitionSystemBuilder::analyze() {
+  for (Block &block : m_func.getBody()) {
+    m_blockIndex[&block] = m_blocks.size();
+    m_blocks.push_back(&block);
+    m_numSlots = std::max<unsigned>(m_numSlots, block.getNumArguments());
+  }
+  // one more program counter value marks the return
+  m_pcWidth = std::max(1u, llvm::Log2_64_Ceil(m_blocks.size() + 1));
+
+  auto collectCarried = [&](Value value, Block *block) {
+    for (Operation *user : value.getUsers()) {
+      if (user->getBlock() != block) {
+        m_carried.try_emplace(value, m_carried.size());
+        return;
+      }
+    }
+  };
+  for (Block *block : m_blocks) {
+    for (BlockArgument arg : block->getArguments()) {
+      collectCarried(arg, block);
+    }
+    for (Operation &op : *block) {
+      if (isa<ebpf::AllocaOp>(op)) {
+        return op.emitError("registers must be promoted before encoding, "
+                            "run ebpf-promote-registers first");
+      }
+      // constants are materialized again wherever they are used
+      if (isa<ebpf::ConstantOp>(op))
+        continue;
+      for (Value result : op.getResults()) {
+        collectCarried(result, block);
+      }
+    }
+  }
+  return success();
+}
+
+std::vector<Type> TransitionSystemBuilder::getStateTypes() {
+  auto regType = btor::BitVecType::get(m_context, 64);
+  auto byteType = btor::BitVecType::get(m_context, 8);
+  std::vector<Type> types(getNumStates(), regType);
+  types[getPcState()] = btor::BitVecType::get(m_context, m_pcWidth);
+  for (auto &[value, index] : m_carried) {
+    types[getCarriedState(index)] = convertType(value.getType());
+  }
+  types[getStackState()] = btor::ArrayType::get(
+      m_context, btor::BitVecType::get(m_context, EBPF_STACK_INDEX_WIDTH),
+      byteType);
+  types[getMemoryState()] = btor::ArrayType::get(m_context, regType, byteType);
+  return types;
+}
+
+std::vector<Value>
+TransitionSystemBuilder::buildInit(const std::vector<Type> &stateTypes) {
+  std::vector<Value> init(getNumStates(), nullptr);
+  auto stateId = [&](unsigned i) {
+    return m_builder.getIntegerAttr(m_builder.getIntegerType(64, false), i);
+  };
+  init[getPcState()] = buildConstant(m_pcWidth, 0);
+  // only the stack pointer is known, r1 holds the context pointer
+  for (unsigned i = getSlotState(0); i < getStackState(); ++i) {
+    if (i == getSlotState(EBPF_STACK_POINTER)) {
+      init[i] = buildConstant(64, EBPF_STACK_TOP);
+      continue;
+    }
+    init[i] = m_builder.create<btor::NDStateOp>(m_loc, stateTypes[i],
+                                                stateId(i));
+  }
+  for (unsigned i : {getStackState(), getMemoryState()}) {
+    init[i] = m_builder.create<btor::ArrayOp>(m_loc, stateTypes[i], stateId(i));
+  }
+  return init;
+}
+
+std::vector<Value> TransitionSystemBuilder::buildNext() {
+  // states keep their value unless the block at pc changes them
+  std::vector<Value> next(m_states);
+  for (unsigned state = 0; state < getNumStates(); ++state) {
+    for (auto &[block, value] : llvm::reverse(m_updates[state])) {
+      next[state] = buildIte(m_pcIs[block], value, next[state]);
+    }
+  }
+  return next;
+}
+
+Value TransitionSystemBuilder::lookup(Value value) {
+  if (Value encoded = m_values.lookup(value))
+    return encoded;
+  if (auto constant = value.getDefiningOp<ebpf::ConstantOp>()) {
+    Value encoded = buildConstant(constant.getType().getIntOrFloatBitWidth(),
+                                  constant.valueAttr().getValue());
+    m_values[value] = encoded;
+    return encoded;
+  }
+  assert(m_carried.count(value) && "value of another block is not carried");
+  return m_states[getCarriedState(m_carried.lookup(value))];
+}
+
+Value TransitionSystemBuilder::buildSlice(Value value, unsigned upper,
+                                          unsigned lower) {
+  const unsigned width = getWidth(value);
+  if (upper == width - 1 && lower == 0)
+    return value;
+  auto resType = btor::BitVecType::get(m_context, upper - lower + 1);
+  return m_builder.create<btor::SliceOp>(m_loc, resType, value,
+                                         buildConstant(width, upper),
+                                         buildConstant(width, lower));
+}
+
+Value TransitionSystemBuilder::buildConcat(Value high, Value low) {
+  auto resType =
+      btor::BitVecType::get(m_context, getWidth(high) + getWidth(low));
+  return m_builder.create<btor::ConcatOp>(m_loc, resType, high, low);
+}
+
+Value TransitionSystemBuilder::buildZExt(Value value, unsigned width) {
+  if (getWidth(value) == width)
+    return value;
+  return m_builder.create<btor::UExtOp>(
+      m_loc, value, btor::BitVecType::get(m_context, width));
+}
+
+/// Isolate the low `width` bits, swapping their bytes if requested. Memory is
+/// little endian, so only big endian conversions and swaps reorder bytes.
+Value TransitionSystemBuilder::buildByteOrder(Value value, unsigned width,
+                                              bool swap) {
+  const unsigned regWidth = getWidth(value);
+  if (!swap)
+    return buildZExt(buildSlice(value, width - 1, 0), regWidth);
+  Value result = buildSlice(value, 7, 0);
+  for (unsigned lower = 8; lower < width; lower += 8) {
+    result = buildConcat(result, buildSlice(value, lower + 7, lower));
+  }
+  return buildZExt(result, regWidth);
+}
+
+template <typename btorOp, typename ebpfOp>
+LogicalResult TransitionSystemBuilder::encodeShiftOp(ebpfOp op) {
+  // only the low bits of the shift amount are used
+  Value lhs = lookup(op.lhs());
+  const unsigned width = getWidth(lhs);
+  Value amount = m_builder.create<btor::AndOp>(m_loc, lookup(op.rhs()),
+                                               buildConstant(width, width - 1));
+  setResult(op, m_builder.create<btorOp>(m_loc, lhs, amount));
+  return success();
+}
+
+/// Division by zero gives zero, and modulo by zero keeps the dividend
+template <typename btorOp, typename ebpfOp>
+LogicalResult TransitionSystemBuilder::encodeDivOp(ebpfOp op,
+                                                   bool keepDividend) {
+  Value lhs = lookup(op.lhs()), rhs = lookup(op.rhs());
+  Value zero = buildConstant(getWidth(rhs), 0);
+  Value isZero = m_builder.create<btor::CmpOp>(m_loc, btor::BtorPredicate::eq,
+                                               rhs, zero);
+  Value res = m_builder.create<btorOp>(m_loc, lhs, rhs);
+  setResult(op, buildIte(isZero, keepDividend ? lhs : zero, res));
+  return success();
+}
+
+//===----------------------------------------------------------------------===//
+// Memory
+//===----------------------------------------------------------------------===//
+
+/// Bytes in [EBPF_STACK_TOP - EBPF_STACK_SIZE, EBPF_STACK_TOP) live in the
+/// stack array, every other address in the memory array
+Value TransitionSystemBuilder::getStackIndex(Value address, Value &inStack) {
+  Value offset = m_builder.create<btor::SubOp>(
+      m_loc, address, buildConstant(64, EBPF_STACK_TOP - EBPF_STACK_SIZE));
+  inStack = m_builder.create<btor::CmpOp>(m_loc, btor::BtorPredicate::ult,
+                                          offset,
+                                          buildConstant(64, EBPF_STACK_SIZE));
+  return buildSlice(offset, EBPF_STACK_INDEX_WIDTH - 1, 0);
+}
+
+Value TransitionSystemBuilder::buildReadByte(Value address) {
+  Value inStack;
+  Value index = getStackIndex(address, inStack);
+  auto byteType = btor::BitVecType::get(m_context, 8);
+  Value fromStack =
+      m_builder.create<btor::ReadOp>(m_loc, byteType, m_stack, index);
+  Value fromMemory =
+      m_builder.create<btor::ReadOp>(m_loc, byteType, m_memory, address);
+  return buildIte(inStack, fromStack, fromMemory);
+}
+
+void TransitionSystemBuilder::buildWriteByte(Value address, Value byte) {
+  Value inStack;
+  Value index = getStackIndex(address, inStack);
+  Value stack = m_builder.create<btor::WriteOp>(m_loc, m_stack.getType(),
+                                                byte, m_stack, index);
+  Value memory = m_builder.create<btor::WriteOp>(m_loc, m_memory.getType(),
+                                                 byte, m_memory, address);
+  m_stack = buildIte(inStack, stack, m_stack);
+  m_memory = buildIte(inStack, m_memory, memory);
+}
+
+Value TransitionSystemBuilder::buildLoad(Value base, Value offset,
+                                         unsigned bytes) {
+  Value address = m_builder.create<btor::AddOp>(m_loc, base, offset);
+  Value value = buildReadByte(address);
+  for (unsigned i = 1; i < bytes; ++i) {
+    Value next = m_builder.create<btor::AddOp>(m_loc, address,
+                                               buildConstant(64, i));
+    value = buildConcat(buildReadByte(next), value);
+  }
+  /* narrow loads zero the upper bits of the register */
+  return buildZExt(value, getWidth(base));
+}
+
+void TransitionSystemBuilder::buildStore(Value base, Value offset, Value value,
+                                         unsigned bytes) {
+  Value address = m_builder.create<btor::AddOp>(m_loc, base, offset);
+  for (unsigned i = 0; i < bytes; ++i) {
+    Value next = i == 0 ? address
+                        : m_builder.create<btor::AddOp>(
+                              m_loc, address, buildConstant(64, i));
+    buildWriteByte(next, buildSlice(value, 8 * i + 7, 8 * i));
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// Op Encodings
+//===----------------------------------------------------------------------===//
+
+LogicalResult TransitionSystemBuilder::encodeOp(Operation &op) {
+  return llvm::TypeSwitch<Operation *, LogicalResult>(&op)
+      // constants are materialized by lookup
+      .Case([&](ebpf::ConstantOp) { return success(); })
+      // arithmetic
+      .Case([&](ebpf::AddOp op) { return encodeBinaryOp<btor::AddOp>(op); })
+      .Case([&](ebpf::SubOp op) { return encodeBinaryOp<btor::SubOp>(op); })
+      .Case([&](ebpf::MulOp op) { return encodeBinaryOp<btor::MulOp>(op); })
+      .Case([&](ebpf::OrOp op) { return encodeBinaryOp<btor::OrOp>(op); })
+      .Case([&](ebpf::AndOp op) { return encodeBinaryOp<btor::AndOp>(op); })
+      .Case([&](ebpf::XOrOp op) { return encodeBinaryOp<btor::XOrOp>(op); })
+      .Case([&](ebpf::LSHOp op) { return encodeShiftOp<btor::ShiftLLOp>(op); })
+      .Case([&](ebpf::RSHOp op) { return encodeShiftOp<btor::ShiftRLOp>(op); })
+      .Case([&](ebpf::ShiftRAOp op) {
+        return encodeShiftOp<btor::ShiftRAOp>(op);
+      })
+      .Case([&](ebpf::UDivOp op) {
+        return encodeDivOp<btor::UDivOp>(op, false);
+      })
+      .Case([&](ebpf::SDivOp op) {
+        return encodeDivOp<btor::SDivOp>(op, false);
+      })
+      .Case([&](ebpf::UModOp op) {
+        return encodeDivOp<btor::URemOp>(op, true);
+      })
+      .Case([&](ebpf::SModOp op) {
+        return encodeDivOp<btor::SRemOp>(op, true);
+      })
+      .Case([&](ebpf::NegOp op) {
+        setResult(op,
+                  m_builder.create<btor::NegOp>(m_loc, lookup(op.operand())));
+        return success();
+      })
+      .Case([&](ebpf::CmpOp op) {
+        Value lhs = lookup(op.lhs()), rhs = lookup(op.rhs());
+        if (op.getPredicate() == ebpf::ebpfPredicate::set) {
+          Value bits = m_builder.create<btor::AndOp>(m_loc, lhs, rhs);
+          setResult(op, m_builder.create<btor::CmpOp>(
+                            m_loc, btor::BtorPredicate::ne, bits,
+                            buildConstant(getWidth(bits), 0)));
+          return success();
+        }
+        // the remaining predicates share their encoding with btor
+        setResult(op, m_builder.create<btor::CmpOp>(
+                          m_loc,
+                          static_cast<btor::BtorPredicate>(op.getPredicate()),
+                          lhs, rhs));
+        return success();
+      })
+      // byte order
+      .Case([&](ebpf::BE16 op) {
+        setResult(op, buildByteOrder(lookup(op.operand()), 16, true));
+        return success();
+      })
+      .Case([&](ebpf::BE32 op) {
+        setResult(op, buildByteOrder(lookup(op.operand()), 32, true));
+        return success();
+      })
+      .Case([&](ebpf::BE64 op) {
+        setResult(op, buildByteOrder(lookup(op.operand()), 64, true));
+        return success();
+      })
+      .Case([&](ebpf::LE16 op) {
+        setResult(op, buildByteOrder(lookup(op.operand()), 16, false));
+        return success();
+      })
+      .Case([&](ebpf::LE32 op) {
+        setResult(op, buildByteOrder(lookup(op.operand()), 32, false));
+        return success();
+      })
+      .Case([&](ebpf::LE64 op) {
+        setResult(op, buildByteOrder(lookup(op.operand()), 64, false));
+        return success();
+      })
+      .Case([&](ebpf::SWAP16 op) {
+        setResult(op, buildByteOrder(lookup(op.operand()), 16, true));
+        return success();
+      })
+      .Case([&](ebpf::SWAP32 op) {
+        setResult(op, buildByteOrder(lookup(op.operand()), 32, true));
+        return success();
+      })
+      .Case([&](ebpf::SWAP64 op) {
+        setResult(op, buildByteOrder(lookup(op.operand()), 64, true));
+        return success();
+      })
+      // memory
+      .Case([&](ebpf::LoadOp op) {
+        setResult(op, buildLoad(lookup(op.lhs()), lookup(op.rhs()), 8));
+        return success();
+      })
+      .Case([&](ebpf::Load32Op op) {
+        setResult(op, buildLoad(lookup(op.lhs()), lookup(op.rhs()), 4));
+        return success();
+      })
+      .Case([&](ebpf::Load16Op op) {
+        setResult(op, buildLoad(lookup(op.lhs()), lookup(op.rhs()), 2));
+        return success();
+      })
+      .Case([&](ebpf::Load8Op op) {
+        setResult(op, buildLoad(lookup(op.lhs()), lookup(op.rhs()), 1));
+        return success();
+      })
+      .Case([&](ebpf::StoreOp op) {
+        buildStore(lookup(op.lhs()), lookup(op.offset()), lookup(op.rhs()), 8);
+        return success();
+      })
+      .Case([&](ebpf::Store32Op op) {
+        buildStore(lookup(op.lhs()), lookup(op.offset()), lookup(op.rhs()), 4);
+        return success();
+      })
+      .Case([&](ebpf::Store16Op op) {
+        buildStore(lookup(op.lhs()), lookup(op.offset()), lookup(op.rhs()), 2);
+        return success();
+      })
+      .Case([&](ebpf::Store8Op op) {
+        buildStore(lookup(op.lhs()), lookup(op.offset()), lookup(op.rhs()), 1);
+        return success();
+      })
+      // helpers, maps and unknown values are inputs of the system
+      .Case<ebpf::CallOp, ebpf::LoadMapOp, ebpf::NDOp>([&](auto op) {
+        setResult(op, buildInput(convertType(op.getType())));
+        return success();
+      })
+      .Case([&](ebpf::AssertOp op) {
+        // it is bad to reach the assertion with a false condition
+        Value failed = m_builder.create<btor::NotOp>(m_loc, lookup(op.arg()));
+        Value bad =
+            m_builder.create<btor::AndOp>(m_loc, m_pcIs[m_curBlock], failed);
+        m_builder.create<btor::AssertNotOp>(
+            m_loc, bad,
+            m_builder.getIntegerAttr(m_builder.getIntegerType(64, false),
+                                     m_nextBad++));
+        return success();
+      })
+      .Case<BranchOp, CondBranchOp, ReturnOp>(
+          [&](auto) { return encodeTerminator(op); })
+      .Default([&](Operation *op) {
+        return op->emitError("no btor encoding for this operation");
+      });
+}
+
+LogicalResult TransitionSystemBuilder::encodeTerminator(Operation &op) {
+  const unsigned block = m_curBlock;
+  auto pcOf = [&](Block *dest) {
+    return buildConstant(m_pcWidth, m_blockIndex.lookup(dest));
+  };
+  if (auto ret = dyn_cast<ReturnOp>(op)) {
+    update(getPcState(), block, buildConstant(m_pcWidth, m_blocks.size()));
+    if (ret.getNumOperands() > 0) {
+      update(getSlotState(0), block, lookup(ret.getOperand(0)));
+    }
+    return success();
+  }
+  if (auto br = dyn_cast<BranchOp>(op)) {
+    update(getPcState(), block, pcOf(br.getDest()));
+    auto operands = br.getOperands();
+    for (unsigned i = 0; i < operands.size(); ++i) {
+      update(getSlotState(i), block, lookup(operands[i]));
+    }
+    return success();
+  }
+  auto condBr = cast<CondBranchOp>(op);
+  Value cond = lookup(condBr.getCondition());
+  update(getPcState(), block,
+         buildIte(cond, pcOf(condBr.getTrueDest()),
+                  pcOf(condBr.getFalseDest())));
+  auto trueOperands = condBr.getTrueOperands();
+  auto falseOperands = condBr.getFalseOperands();
+  const unsigned numOperands =
+      std::max(trueOperands.size(), falseOperands.size());
+  for (unsigned i = 0; i < numOperands; ++i) {
+    // a successor without this argument keeps the slot as it is
+    Value slot = m_states[getSlotState(i)];
+    Value onTrue = i < trueOperands.size() ? lookup(trueOperands[i]) : slot;
+    Value onFalse = i < falseOperands.size() ? lookup(falseOperands[i]) : slot;
+    update(getSlotState(i), block, buildIte(cond, onTrue, onFalse));
+  }
+  return success();
+}
+
+LogicalResult TransitionSystemBuilder::encodeBlock(Block &block) {
+  m_values.clear();
+  for (BlockArgument arg : block.getArguments()) {
+    m_values[arg] = m_states[getSlotState(arg.getArgNumber())];
+  }
+  m_stack = m_states[getStackState()];
+  m_memory = m_states[getMemoryState()];
+  for (Operation &op : block) {
+    if (failed(encodeOp(op)))
+      return failure();
+  }
+  if (m_stack != m_states[getStackState()])
+    update(getStackState(), m_curBlock, m_stack);
+  if (m_memory != m_states[getMemoryState()])
+    update(getMemoryState(), m_curBlock, m_memory);
+  // values used by other blocks keep their latest definition
+  for (auto &[value, index] : m_carried) {
+    if (value.getParentBlock() == &block)
+      update(getCarriedState(index), m_curBlock, m_values.lookup(value));
+  }
+  return success();
+}
+
+FuncOp TransitionSystemBuilder::build() {
+  if (failed(analyze()))
+    return nullptr;
+
+  FuncOp system = FuncOp::create(m_loc, m_func.getName(),
+                                 FunctionType::get(m_context, {}, {}));
+  Block *init = system.addEntryBlock();
+  m_builder.setInsertionPointToStart(init);
+  auto stateTypes = getStateTypes();
+  auto initStates = buildInit(stateTypes);
+
+  // the loop block takes the states and computes their next values
+  std::vector<Location> stateLocs(stateTypes.size(), m_loc);
+  Block *loop = m_builder.createBlock(&system.getBody(), {}, stateTypes,
+                                      stateLocs);
+  m_states.assign(loop->getArguments().begin(), loop->getArguments().end());
+  m_updates.assign(getNumStates(), {});
+  for (unsigned b = 0; b < m_blocks.size(); ++b) {
+    m_pcIs.push_back(m_builder.create<btor::CmpOp>(
+        m_loc, btor::BtorPredicate::eq, m_states[getPcState()],
+        buildConstant(m_pcWidth, b)));
+  }
+  for (unsigned b = 0; b < m_blocks.size(); ++b) {
+    m_curBlock = b;
+    if (failed(encodeBlock(*m_blocks[b]))) {
+      system.erase();
+      return nullptr;
+    }
+  }
+  m_builder.create<BranchOp>(m_loc, loop, buildNext());
+
+  m_builder.setInsertionPointToEnd(init);
+  m_builder.create<BranchOp>(m_loc, loop, initStates);
+  return system;
+}
+
+//===----------------------------------------------------------------------===//
+// Pass Definition
+//===----------------------------------------------------------------------===//
+
+/// Imported ebpf functions take the registers and return r0
+bool isebpfFunction(FuncOp func) {
+  auto i64Type = IntegerType::get(func.getContext(), 64);
+  auto type = func.getType();
+  return !func.isExternal() && type.getNumInputs() == EBPF_REGISTERS &&
+         type.getNumResults() == 1 && type.getResult(0) == i64Type &&
+         llvm::all_of(type.getInputs(), [&](Type t) { return t == i64Type; });
+}
+
+struct ebpfToBtorPass : public ConvertebpfToBtorBase<ebpfToBtorPass> {
+
+  ebpfToBtorPass() = default;
+
+  void getDependentDialects(DialectRegistry &registry) const override {
+    registry.insert<btor::BtorDialect>();
+  }
+  StringRef getArgument() const final { return PASS_NAME; }
+  void runOnOperation() override;
+};
+} // end anonymous namespace
+
+void ebpfToBtorPass::runOnOperation() {
+  ModuleOp module = getOperation();
+  std::vector<FuncOp> funcs;
+  for (FuncOp func : module.getOps<FuncOp>()) {
+    if (isebpfFunction(func))
+      funcs.push_back(func);
+  }
+  for (FuncOp func : funcs) {
+    TransitionSystemBuilder builder(func);
+    FuncOp system = builder.build();
+    if (!system)
+      return signalPassFailure();
+    OpBuilder(func).insert(system);
+    func.erase();
+  }
+}
+
+/// Create a pass encoding ebpf functions as btor transition systems
+std::unique_ptr<mlir::Pass> mlir::ebpf::createConvertebpfToBtorPass() {
+  return std::make_unique<ebpfToBtorPass>();
+}
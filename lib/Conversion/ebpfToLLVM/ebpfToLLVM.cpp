@@ -7,8 +7,10 @@
 #include "mlir/Conversion/StandardToLLVM/ConvertStandardToLLVM.h"
 #include "mlir/Dialect/LLVMIR/LLVMDialect.h"
 #include "mlir/Dialect/MemRef/IR/MemRef.h"
+#include "mlir/IR/Matchers.h"
 #include "mlir/IR/TypeRange.h"
 #include "mlir/IR/TypeUtilities.h"
+#include "llvm/Support/SwapByteOrder.h"
 
 #include <string>
 
@@ -18,6 +20,8 @@ using namespace mlir;
 #define MINUS1_32 4294967295
 #define MINUS1_16 65535
 #define MINUS1_8 255
+/* ebpf memory, such as packet data, gives no alignment guarantees */
+#define EBPF_ACCESS_ALIGNMENT 1
 
 namespace {
 
@@ -94,137 +98,129 @@ struct NegOpLowering : public ConvertOpToLLVMPattern<ebpf::NegOp> {
   }
 };
 
-struct StoreOpLowering : public ConvertOpToLLVMPattern<ebpf::StoreOp> {
-  using ConvertOpToLLVMPattern<ebpf::StoreOp>::ConvertOpToLLVMPattern;
+/// Convert the low `width` bits of the operand between host and the requested
+/// byte order. Only the conversions that need to reorder bytes on this host
+/// call `llvm.bswap`; the others reduce to a zero extension of the low bits.
+template <typename ebpfOp, unsigned width, bool swap>
+struct ByteOrderOpLoweringBase : public ConvertOpToLLVMPattern<ebpfOp> {
+  using ConvertOpToLLVMPattern<ebpfOp>::ConvertOpToLLVMPattern;
+  using OpAdaptor = typename ConvertOpToLLVMPattern<ebpfOp>::OpAdaptor;
   LogicalResult
-  matchAndRewrite(ebpf::StoreOp storeOp, OpAdaptor adaptor,
+  matchAndRewrite(ebpfOp op, OpAdaptor adaptor,
                   ConversionPatternRewriter &rewriter) const override {
-    auto loc = storeOp.getLoc();
-    auto base = adaptor.lhs(), offset = adaptor.offset();
-    auto val = adaptor.rhs();
-
-    Value addr = rewriter.create<LLVM::AddOp>(loc, base, offset);
-    auto reg = rewriter.create<LLVM::IntToPtrOp>(
-        loc, LLVM::LLVMPointerType::get(rewriter.getI64Type()), addr);
-    rewriter.replaceOpWithNewOp<LLVM::StoreOp>(storeOp, val, reg);
+    auto loc = op.getLoc();
+    Value val = adaptor.operand();
+    Type opType = val.getType();
+    auto narrowType = rewriter.getIntegerType(width);
+    if (width < opType.getIntOrFloatBitWidth()) {
+      val = rewriter.create<LLVM::TruncOp>(loc, narrowType, val);
+    }
+    if (swap) {
+      const std::string bswap = "llvm.bswap.i" + std::to_string(width);
+      auto module = op->template getParentOfType<ModuleOp>();
+      auto bswapFunc = module.template lookupSymbol<LLVM::LLVMFuncOp>(bswap);
+      if (!bswapFunc) {
+        OpBuilder::InsertionGuard guard(rewriter);
+        rewriter.setInsertionPointToStart(module.getBody());
+        auto bswapFuncTy = LLVM::LLVMFunctionType::get(narrowType, {narrowType});
+        bswapFunc = rewriter.create<LLVM::LLVMFuncOp>(rewriter.getUnknownLoc(),
+                                                      bswap, bswapFuncTy);
+      }
+      val = rewriter.create<LLVM::CallOp>(loc, bswapFunc, val).getResult(0);
+    }
+    if (width < opType.getIntOrFloatBitWidth()) {
+      val = rewriter.create<LLVM::ZExtOp>(loc, opType, val);
+    }
+    rewriter.replaceOp(op, val);
     return success();
   }
 };
 
-struct Store8OpLowering : public ConvertOpToLLVMPattern<ebpf::Store8Op> {
-  using ConvertOpToLLVMPattern<ebpf::Store8Op>::ConvertOpToLLVMPattern;
-  LogicalResult
-  matchAndRewrite(ebpf::Store8Op store8Op, OpAdaptor adaptor,
-                  ConversionPatternRewriter &rewriter) const override {
-    auto loc = store8Op.getLoc();
-    auto base = adaptor.lhs(), offset = adaptor.offset();
-    auto val = adaptor.rhs();
-    /* mask to isolate the 8bits*/
-    auto mask = rewriter.create<LLVM::ConstantOp>(
-        loc, rewriter.getI64Type(), rewriter.getI64IntegerAttr(MINUS1_8));
-    auto newVal = rewriter.create<LLVM::AndOp>(loc, val, mask);
-    rewriter.replaceOpWithNewOp<ebpf::StoreOp>(store8Op, base, offset, newVal);
-    return success();
-  }
-};
+using BE16OpLowering =
+    ByteOrderOpLoweringBase<ebpf::BE16, 16, llvm::sys::IsLittleEndianHost>;
+using BE32OpLowering =
+    ByteOrderOpLoweringBase<ebpf::BE32, 32, llvm::sys::IsLittleEndianHost>;
+using BE64OpLowering =
+    ByteOrderOpLoweringBase<ebpf::BE64, 64, llvm::sys::IsLittleEndianHost>;
+using LE16OpLowering =
+    ByteOrderOpLoweringBase<ebpf::LE16, 16, llvm::sys::IsBigEndianHost>;
+using LE32OpLowering =
+    ByteOrderOpLoweringBase<ebpf::LE32, 32, llvm::sys::IsBigEndianHost>;
+using LE64OpLowering =
+    ByteOrderOpLoweringBase<ebpf::LE64, 64, llvm::sys::IsBigEndianHost>;
+using SWAP16OpLowering = ByteOrderOpLoweringBase<ebpf::SWAP16, 16, true>;
+using SWAP32OpLowering = ByteOrderOpLoweringBase<ebpf::SWAP32, 32, true>;
+using SWAP64OpLowering = ByteOrderOpLoweringBase<ebpf::SWAP64, 64, true>;
+
+/// Compute the pointer for a `width` bit access at base + offset. The offset
+/// is applied with a byte GEP on the base pointer, so that LLVM keeps track of
+/// which object each access belongs to.
+static Value getAccessPtr(ConversionPatternRewriter &rewriter, Location loc,
+                          Value base, Value offset, unsigned width) {
+  auto bytePtrType = LLVM::LLVMPointerType::get(rewriter.getI8Type());
+  Value basePtr = rewriter.create<LLVM::IntToPtrOp>(loc, bytePtrType, base);
+  Value bytePtr = rewriter.create<LLVM::GEPOp>(loc, bytePtrType, basePtr,
+                                               ValueRange{offset});
+  if (width == 8)
+    return bytePtr;
+  auto ptrType = LLVM::LLVMPointerType::get(rewriter.getIntegerType(width));
+  return rewriter.create<LLVM::BitcastOp>(loc, ptrType, bytePtr);
+}
 
-struct Store16OpLowering : public ConvertOpToLLVMPattern<ebpf::Store16Op> {
-  using ConvertOpToLLVMPattern<ebpf::Store16Op>::ConvertOpToLLVMPattern;
+template <typename ebpfStoreOp, unsigned width>
+struct StoreOpLoweringBase : public ConvertOpToLLVMPattern<ebpfStoreOp> {
+  using ConvertOpToLLVMPattern<ebpfStoreOp>::ConvertOpToLLVMPattern;
+  using OpAdaptor = typename ConvertOpToLLVMPattern<ebpfStoreOp>::OpAdaptor;
   LogicalResult
-  matchAndRewrite(ebpf::Store16Op store16Op, OpAdaptor adaptor,
+  matchAndRewrite(ebpfStoreOp storeOp, OpAdaptor adaptor,
                   ConversionPatternRewriter &rewriter) const override {
-    auto loc = store16Op.getLoc();
+    auto loc = storeOp.getLoc();
     auto base = adaptor.lhs(), offset = adaptor.offset();
-    auto val = adaptor.rhs();
-    /* mask to isolate the 16bits*/
-    auto mask = rewriter.create<LLVM::ConstantOp>(
-        loc, rewriter.getI64Type(), rewriter.getI64IntegerAttr(MINUS1_16));
-    auto newVal = rewriter.create<LLVM::AndOp>(loc, val, mask);
-    rewriter.replaceOpWithNewOp<ebpf::StoreOp>(store16Op, base, offset, newVal);
-    return success();
-  }
-};
+    Value val = adaptor.rhs();
 
-struct Store32OpLowering : public ConvertOpToLLVMPattern<ebpf::Store32Op> {
-  using ConvertOpToLLVMPattern<ebpf::Store32Op>::ConvertOpToLLVMPattern;
-  LogicalResult
-  matchAndRewrite(ebpf::Store32Op store32Op, OpAdaptor adaptor,
-                  ConversionPatternRewriter &rewriter) const override {
-    auto loc = store32Op.getLoc();
-    auto base = adaptor.lhs(), offset = adaptor.offset();
-    auto val = adaptor.rhs();
-    /* mask to isolate the 32bits*/
-    auto mask = rewriter.create<LLVM::ConstantOp>(
-        loc, rewriter.getI64Type(), rewriter.getI64IntegerAttr(MINUS1_32));
-    auto newVal = rewriter.create<LLVM::AndOp>(loc, val, mask);
-    rewriter.replaceOpWithNewOp<ebpf::StoreOp>(store32Op, base, offset, newVal);
+    auto ptr = getAccessPtr(rewriter, loc, base, offset, width);
+    if (width < 64) {
+      /* only the low bits are written */
+      val = rewriter.create<LLVM::TruncOp>(
+          loc, rewriter.getIntegerType(width), val);
+    }
+    rewriter.replaceOpWithNewOp<LLVM::StoreOp>(storeOp, val, ptr,
+                                               EBPF_ACCESS_ALIGNMENT);
     return success();
   }
 };
 
-struct LoadOpLowering : public ConvertOpToLLVMPattern<ebpf::LoadOp> {
-  using ConvertOpToLLVMPattern<ebpf::LoadOp>::ConvertOpToLLVMPattern;
-  LogicalResult
-  matchAndRewrite(ebpf::LoadOp loadOp, OpAdaptor adaptor,
-                  ConversionPatternRewriter &rewriter) const override {
-    auto loc = loadOp.getLoc();
-    auto base = adaptor.lhs(), offset = adaptor.rhs();
+using StoreOpLowering = StoreOpLoweringBase<ebpf::StoreOp, 64>;
+using Store32OpLowering = StoreOpLoweringBase<ebpf::Store32Op, 32>;
+using Store16OpLowering = StoreOpLoweringBase<ebpf::Store16Op, 16>;
+using Store8OpLowering = StoreOpLoweringBase<ebpf::Store8Op, 8>;
 
-    Value addr = rewriter.create<LLVM::AddOp>(loc, base, offset);
-    auto reg = rewriter.create<LLVM::IntToPtrOp>(
-        loc, LLVM::LLVMPointerType::get(rewriter.getI64Type()), addr);
-    rewriter.replaceOpWithNewOp<LLVM::LoadOp>(loadOp, reg);
-    return success();
-  }
-};
-
-struct Load8OpLowering : public ConvertOpToLLVMPattern<ebpf::Load8Op> {
-  using ConvertOpToLLVMPattern<ebpf::Load8Op>::ConvertOpToLLVMPattern;
+template <typename ebpfLoadOp, unsigned width>
+struct LoadOpLoweringBase : public ConvertOpToLLVMPattern<ebpfLoadOp> {
+  using ConvertOpToLLVMPattern<ebpfLoadOp>::ConvertOpToLLVMPattern;
+  using OpAdaptor = typename ConvertOpToLLVMPattern<ebpfLoadOp>::OpAdaptor;
   LogicalResult
-  matchAndRewrite(ebpf::Load8Op load8Op, OpAdaptor adaptor,
+  matchAndRewrite(ebpfLoadOp loadOp, OpAdaptor adaptor,
                   ConversionPatternRewriter &rewriter) const override {
-    auto loc = load8Op.getLoc();
+    auto loc = loadOp.getLoc();
     auto base = adaptor.lhs(), offset = adaptor.rhs();
-    auto val = rewriter.create<ebpf::LoadOp>(loc, base, offset);
-    /* mask to isolate the 8bits*/
-    auto mask = rewriter.create<LLVM::ConstantOp>(
-        loc, rewriter.getI64Type(), rewriter.getI64IntegerAttr(MINUS1_8));
-    rewriter.replaceOpWithNewOp<LLVM::AndOp>(load8Op, val, mask);
-    return success();
-  }
-};
 
-struct Load16OpLowering : public ConvertOpToLLVMPattern<ebpf::Load16Op> {
-  using ConvertOpToLLVMPattern<ebpf::Load16Op>::ConvertOpToLLVMPattern;
-  LogicalResult
-  matchAndRewrite(ebpf::Load16Op load16Op, OpAdaptor adaptor,
-                  ConversionPatternRewriter &rewriter) const override {
-    auto loc = load16Op.getLoc();
-    auto base = adaptor.lhs(), offset = adaptor.rhs();
-    auto val = rewriter.create<ebpf::LoadOp>(loc, base, offset);
-    /* mask to isolate the 16bits*/
-    auto mask = rewriter.create<LLVM::ConstantOp>(
-        loc, rewriter.getI64Type(), rewriter.getI64IntegerAttr(MINUS1_16));
-    rewriter.replaceOpWithNewOp<LLVM::AndOp>(load16Op, val, mask);
+    auto ptr = getAccessPtr(rewriter, loc, base, offset, width);
+    Value val =
+        rewriter.create<LLVM::LoadOp>(loc, ptr, EBPF_ACCESS_ALIGNMENT);
+    if (width < 64) {
+      /* narrow loads zero the upper bits of the register */
+      val = rewriter.create<LLVM::ZExtOp>(loc, loadOp.getType(), val);
+    }
+    rewriter.replaceOp(loadOp, val);
     return success();
   }
 };
 
-struct Load32OpLowering : public ConvertOpToLLVMPattern<ebpf::Load32Op> {
-  using ConvertOpToLLVMPattern<ebpf::Load32Op>::ConvertOpToLLVMPattern;
-  LogicalResult
-  matchAndRewrite(ebpf::Load32Op load32Op, OpAdaptor adaptor,
-                  ConversionPatternRewriter &rewriter) const override {
-    auto loc = load32Op.getLoc();
-    auto base = adaptor.lhs(), offset = adaptor.rhs();
-    auto val = rewriter.create<ebpf::LoadOp>(loc, base, offset);
-    /* mask to isolate the 32bits*/
-    auto mask = rewriter.create<LLVM::ConstantOp>(
-        loc, rewriter.getI64Type(), rewriter.getI64IntegerAttr(MINUS1_32));
-    rewriter.replaceOpWithNewOp<LLVM::AndOp>(load32Op, val, mask);
-    return success();
-  }
-};
+using LoadOpLowering = LoadOpLoweringBase<ebpf::LoadOp, 64>;
+using Load32OpLowering = LoadOpLoweringBase<ebpf::Load32Op, 32>;
+using Load16OpLowering = LoadOpLoweringBase<ebpf::Load16Op, 16>;
+using Load8OpLowering = LoadOpLoweringBase<ebpf::Load8Op, 8>;
 
 struct MoveOpLowering : public ConvertOpToLLVMPattern<ebpf::MoveOp> {
   using ConvertOpToLLVMPattern<ebpf::MoveOp>::ConvertOpToLLVMPattern;
@@ -311,27 +307,178 @@ struct LoadMapOpLowering : public ConvertOpToLLVMPattern<ebpf::LoadMapOp> {
   }
 };
 
+/// Declare the function `name` at the start of the module, unless it exists
+static LLVM::LLVMFuncOp
+lookupOrCreateFunc(ConversionPatternRewriter &rewriter, ModuleOp module,
+                   StringRef name, LLVM::LLVMFunctionType type) {
+  auto func = module.lookupSymbol<LLVM::LLVMFuncOp>(name);
+  if (!func) {
+    OpBuilder::InsertionGuard guard(rewriter);
+    rewriter.setInsertionPointToStart(module.getBody());
+    func = rewriter.create<LLVM::LLVMFuncOp>(rewriter.getUnknownLoc(), name,
+                                             type);
+  }
+  return func;
+}
+
+/// Replace `op` with a call to nd_64, which returns a non-deterministic value
+static void replaceWithNDCall(Operation *op,
+                              ConversionPatternRewriter &rewriter) {
+  auto module = op->getParentOfType<ModuleOp>();
+  auto havocFunc = lookupOrCreateFunc(
+      rewriter, module, "nd_64",
+      LLVM::LLVMFunctionType::get(rewriter.getI64Type(), {}));
+  rewriter.replaceOpWithNewOp<LLVM::CallOp>(op, havocFunc, llvm::None);
+}
+
 struct NDOpLowering : public ConvertOpToLLVMPattern<ebpf::NDOp> {
   using ConvertOpToLLVMPattern<ebpf::NDOp>::ConvertOpToLLVMPattern;
   LogicalResult
   matchAndRewrite(ebpf::NDOp ndOp, OpAdaptor adaptor,
                   ConversionPatternRewriter &rewriter) const override {
-    /* we resolve with an nd call for now*/
-    const std::string havoc = "nd_64";
-    auto module = ndOp->getParentOfType<ModuleOp>();
-    auto havocFunc = module.lookupSymbol<LLVM::LLVMFuncOp>(havoc);
-    if (!havocFunc) {
-      OpBuilder::InsertionGuard guard(rewriter);
-      rewriter.setInsertionPointToStart(module.getBody());
-      auto havocFuncTy = LLVM::LLVMFunctionType::get(rewriter.getI64Type(), {});
-      havocFunc = rewriter.create<LLVM::LLVMFuncOp>(rewriter.getUnknownLoc(),
-                                                    havoc, havocFuncTy);
+    replaceWithNDCall(ndOp, rewriter);
+    return success();
+  }
+};
+
+struct CallOpLowering : public ConvertOpToLLVMPattern<ebpf::CallOp> {
+  using ConvertOpToLLVMPattern<ebpf::CallOp>::ConvertOpToLLVMPattern;
+  LogicalResult
+  matchAndRewrite(ebpf::CallOp callOp, OpAdaptor adaptor,
+                  ConversionPatternRewriter &rewriter) const override {
+    /* helpers return a non-deterministic value for verification */
+    replaceWithNDCall(callOp, rewriter);
+    return success();
+  }
+};
+
+/// Branch to a call of `failure` when the condition does not hold
+struct AssertOpLowering : public ConvertOpToLLVMPattern<ebpf::AssertOp> {
+  AssertOpLowering(LLVMTypeConverter &converter, StringRef failure)
+      : ConvertOpToLLVMPattern<ebpf::AssertOp>(converter), failure(failure) {}
+
+  LogicalResult
+  matchAndRewrite(ebpf::AssertOp assertOp, OpAdaptor adaptor,
+                  ConversionPatternRewriter &rewriter) const override {
+    auto loc = assertOp.getLoc();
+    auto module = assertOp->getParentOfType<ModuleOp>();
+    auto failureFunc = lookupOrCreateFunc(
+        rewriter, module, failure,
+        LLVM::LLVMFunctionType::get(LLVM::LLVMVoidType::get(getContext()),
+                                    {}));
+    Block *opBlock = rewriter.getInsertionBlock();
+    auto opPosition = rewriter.getInsertionPoint();
+    Block *continuationBlock = rewriter.splitBlock(opBlock, opPosition);
+    Block *failureBlock = rewriter.createBlock(opBlock->getParent());
+    rewriter.create<LLVM::CallOp>(loc, failureFunc, llvm::None);
+    rewriter.create<LLVM::UnreachableOp>(loc);
+    rewriter.setInsertionPointToEnd(opBlock);
+    rewriter.replaceOpWithNewOp<LLVM::CondBrOp>(assertOp, adaptor.arg(),
+                                                continuationBlock,
+                                                failureBlock);
+    return success();
+  }
+
+  const std::string failure;
+};
+
+//===----------------------------------------------------------------------===//
+// Native Runtime Lowerings
+//===----------------------------------------------------------------------===//
+
+/// Name of the runtime function implementing the helper with the given id
+static const char *getNativeHelperName(uint64_t helper) {
+  switch (helper) {
+  case 1:
+    return "ebpf_helper_map_lookup_elem";
+  case 2:
+    return "ebpf_helper_map_update_elem";
+  case 3:
+    return "ebpf_helper_map_delete_elem";
+  case 5:
+    return "ebpf_helper_ktime_get_ns";
+  case 6:
+    return "ebpf_helper_trace_printk";
+  case 7:
+    return "ebpf_helper_get_prandom_u32";
+  case 8:
+    return "ebpf_helper_get_smp_processor_id";
+  default:
+    return nullptr;
+  }
+}
+
+struct NativeCallOpLowering : public ConvertOpToLLVMPattern<ebpf::CallOp> {
+  using ConvertOpToLLVMPattern<ebpf::CallOp>::ConvertOpToLLVMPattern;
+  LogicalResult
+  matchAndRewrite(ebpf::CallOp callOp, OpAdaptor adaptor,
+                  ConversionPatternRewriter &rewriter) const override {
+    auto module = callOp->getParentOfType<ModuleOp>();
+    auto i64Type = rewriter.getI64Type();
+    const char *helper = getNativeHelperName(callOp.func());
+    if (!helper) {
+      /* the runtime reports the helper and aborts */
+      auto unsupportedFunc = lookupOrCreateFunc(
+          rewriter, module, "ebpf_helper_unsupported",
+          LLVM::LLVMFunctionType::get(i64Type, {i64Type}));
+      Value id = rewriter.create<LLVM::ConstantOp>(
+          callOp.getLoc(), i64Type,
+          rewriter.getI64IntegerAttr(callOp.func()));
+      rewriter.replaceOpWithNewOp<LLVM::CallOp>(callOp, unsupportedFunc, id);
+      return success();
     }
-    rewriter.replaceOpWithNewOp<LLVM::CallOp>(ndOp, havocFunc, llvm::None);
+    std::vector<Type> argTypes(adaptor.args().size(), i64Type);
+    auto helperFunc =
+        lookupOrCreateFunc(rewriter, module, helper,
+                           LLVM::LLVMFunctionType::get(i64Type, argTypes));
+    rewriter.replaceOpWithNewOp<LLVM::CallOp>(callOp, helperFunc,
+                                              adaptor.args());
     return success();
   }
 };
 
+struct NativeLoadMapOpLowering
+    : public ConvertOpToLLVMPattern<ebpf::LoadMapOp> {
+  using ConvertOpToLLVMPattern<ebpf::LoadMapOp>::ConvertOpToLLVMPattern;
+  LogicalResult
+  matchAndRewrite(ebpf::LoadMapOp loadMapOp, OpAdaptor adaptor,
+                  ConversionPatternRewriter &rewriter) const override {
+    auto loc = loadMapOp.getLoc();
+    auto module = loadMapOp->getParentOfType<ModuleOp>();
+    auto i64Type = rewriter.getI64Type();
+    APInt fd;
+    if (!matchPattern(loadMapOp.rhs(), m_ConstantInt(&fd))) {
+      return loadMapOp.emitError("map descriptor is not a constant");
+    }
+    // find the descriptor recorded by the importer
+    auto maps = module->getAttrOfType<DenseIntElementsAttr>(
+        ebpf::MapsAttrName);
+    if (!maps) {
+      return loadMapOp.emitError("module has no ebpf map descriptors");
+    }
+    auto fields = llvm::to_vector(maps.getValues<int64_t>());
+    for (size_t row = 0; row < fields.size();
+         row += ebpf::MapDescriptorFields) {
+      if (fields[row] != fd.getSExtValue()) {
+        continue;
+      }
+      /* the runtime creates the map on first use */
+      std::vector<Value> args;
+      for (size_t i = 0; i < ebpf::MapDescriptorFields; ++i) {
+        args.push_back(rewriter.create<LLVM::ConstantOp>(
+            loc, i64Type, rewriter.getI64IntegerAttr(fields[row + i])));
+      }
+      std::vector<Type> argTypes(args.size(), i64Type);
+      auto mapFunc =
+          lookupOrCreateFunc(rewriter, module, "ebpf_map_get",
+                             LLVM::LLVMFunctionType::get(i64Type, argTypes));
+      rewriter.replaceOpWithNewOp<LLVM::CallOp>(loadMapOp, mapFunc, args);
+      return success();
+    }
+    return loadMapOp.emitError("no descriptor for map ") << fd.getSExtValue();
+  }
+};
+
 struct AllocaOpLowering : public ConvertOpToLLVMPattern<ebpf::AllocaOp> {
   using ConvertOpToLLVMPattern<ebpf::AllocaOp>::ConvertOpToLLVMPattern;
   LogicalResult
@@ -374,7 +521,12 @@ void ebpfToLLVMLoweringPass::runOnOperation() {
   RewritePatternSet patterns(&getContext());
   ebpfToLLVMTypeConverter converter(&getContext(), true);
 
-  mlir::ebpf::populateebpfToLLVMConversionPatterns(converter, patterns);
+  if (runtime != "nd" && runtime != "native") {
+    getOperation().emitError("unknown ebpf runtime: ") << runtime;
+    return signalPassFailure();
+  }
+  mlir::ebpf::populateebpfToLLVMConversionPatterns(converter, patterns,
+                                                   runtime == "native");
   mlir::populateStdToLLVMConversionPatterns(converter, patterns);
 
   /// Configure conversion to lift ebpf; Anything else is fine.
@@ -384,7 +536,8 @@ void ebpfToLLVMLoweringPass::runOnOperation() {
                       ebpf::SWAP32, ebpf::SWAP64>();
 
   /// misc operators
-  target.addIllegalOp<ebpf::ConstantOp, ebpf::NDOp, ebpf::AllocaOp>();
+  target.addIllegalOp<ebpf::ConstantOp, ebpf::NDOp, ebpf::CallOp,
+                      ebpf::AllocaOp, ebpf::AssertOp>();
 
   /// binary operators
   // logical
@@ -413,7 +566,8 @@ void ebpfToLLVMLoweringPass::runOnOperation() {
 //===----------------------------------------------------------------------===//
 
 void mlir::ebpf::populateebpfToLLVMConversionPatterns(
-    ebpfToLLVMTypeConverter &converter, RewritePatternSet &patterns) {
+    ebpfToLLVMTypeConverter &converter, RewritePatternSet &patterns,
+    bool nativeRuntime) {
   patterns.add<
       AddOpLowering, SubOpLowering, MulOpLowering, SModOpLowering,
       UModOpLowering, AndOpLowering, SDivOpLowering, UDivOpLowering,
@@ -422,7 +576,18 @@ void mlir::ebpf::populateebpfToLLVMConversionPatterns(
       StoreOpLowering, Store8OpLowering, Store16OpLowering, Store32OpLowering,
       LoadOpLowering, Load8OpLowering, Load16OpLowering, Load32OpLowering,
       MoveOpLowering, Move8OpLowering, Move16OpLowering, Move32OpLowering,
-      LoadMapOpLowering, NDOpLowering, AllocaOpLowering>(converter);
+      NDOpLowering, AllocaOpLowering, BE16OpLowering,
+      BE32OpLowering, BE64OpLowering, LE16OpLowering, LE32OpLowering,
+      LE64OpLowering, SWAP16OpLowering, SWAP32OpLowering, SWAP64OpLowering>(
+      converter);
+  if (nativeRuntime) {
+    patterns.add<NativeCallOpLowering, NativeLoadMapOpLowering>(converter);
+    /* the runtime reports the failed check and aborts */
+    patterns.add<AssertOpLowering>(converter, "ebpf_assertion_failed");
+  } else {
+    patterns.add<CallOpLowering, LoadMapOpLowering>(converter);
+    patterns.add<AssertOpLowering>(converter, "__VERIFIER_error");
+  }
 }
 
 /// Create a pass for lowering operations the remaining `ebpf` operations
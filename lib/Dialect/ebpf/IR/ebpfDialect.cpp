@@ -26,3 +26,13 @@ void ebpfDialect::initialize() {
 #include "Dialect/ebpf/IR/ebpfOps.cpp.inc"
       >();
 }
+
+Operation *ebpfDialect::materializeConstant(OpBuilder &builder,
+                                            Attribute value, Type type,
+                                            Location loc) {
+  if (!value.isa<IntegerAttr>()) {
+    return nullptr;
+  }
+  return builder.create<ebpf::ConstantOp>(loc, type,
+                                          value.cast<IntegerAttr>());
+}
@@ -8,6 +8,11 @@
 
 #include "Dialect/ebpf/IR/ebpf.h"
 
+#include "mlir/Dialect/CommonFolders.h"
+#include "mlir/IR/Matchers.h"
+#include "mlir/IR/PatternMatch.h"
+#include "llvm/Support/SwapByteOrder.h"
+
 using namespace mlir;
 using namespace mlir::ebpf;
 
@@ -57,3 +62,331 @@ template <typename Op> LogicalResult verifyConstantOp(Op op) {
 
 #define GET_OP_CLASSES
 #include "Dialect/ebpf/IR/ebpfOps.cpp.inc"
+
+//===----------------------------------------------------------------------===//
+// Folders
+//===----------------------------------------------------------------------===//
+
+namespace {
+bool isConstant(Attribute attr, int64_t value) {
+  auto intAttr = attr.dyn_cast_or_null<IntegerAttr>();
+  return intAttr && intAttr.getValue() == value;
+}
+
+bool isAllOnes(Attribute attr) {
+  auto intAttr = attr.dyn_cast_or_null<IntegerAttr>();
+  return intAttr && intAttr.getValue().isAllOnes();
+}
+
+/// ebpf shifts only use the low bits of the shift amount
+APInt getShiftAmount(const APInt &value, const APInt &amount) {
+  return APInt(value.getBitWidth(),
+               amount.getLimitedValue() & (value.getBitWidth() - 1));
+}
+
+/// Isolate the low `width` bits of `value`, optionally swapping their bytes
+APInt convertByteOrder(const APInt &value, unsigned width, bool swap) {
+  APInt narrow = value.zextOrTrunc(width);
+  if (swap) {
+    narrow = narrow.byteSwap();
+  }
+  return narrow.zextOrTrunc(value.getBitWidth());
+}
+
+template <typename Op>
+OpFoldResult foldByteOrderOp(Op op, ArrayRef<Attribute> operands,
+                             unsigned width, bool swap) {
+  auto operand = operands[0].dyn_cast_or_null<IntegerAttr>();
+  if (!operand) {
+    return {};
+  }
+  return IntegerAttr::get(op.getType(),
+                          convertByteOrder(operand.getValue(), width, swap));
+}
+} // namespace
+
+OpFoldResult ebpf::ConstantOp::fold(ArrayRef<Attribute> operands) {
+  assert(operands.empty() && "constant has no operands");
+  return valueAttr();
+}
+
+OpFoldResult ebpf::AddOp::fold(ArrayRef<Attribute> operands) {
+  if (isConstant(operands[1], 0)) {
+    return lhs();
+  }
+  return constFoldBinaryOp<IntegerAttr>(
+      operands, [](const APInt &a, const APInt &b) { return a + b; });
+}
+
+OpFoldResult ebpf::SubOp::fold(ArrayRef<Attribute> operands) {
+  if (isConstant(operands[1], 0)) {
+    return lhs();
+  }
+  if (lhs() == rhs()) {
+    return IntegerAttr::get(getType(), 0);
+  }
+  return constFoldBinaryOp<IntegerAttr>(
+      operands, [](const APInt &a, const APInt &b) { return a - b; });
+}
+
+OpFoldResult ebpf::MulOp::fold(ArrayRef<Attribute> operands) {
+  if (isConstant(operands[1], 1)) {
+    return lhs();
+  }
+  if (isConstant(operands[1], 0)) {
+    return operands[1];
+  }
+  return constFoldBinaryOp<IntegerAttr>(
+      operands, [](const APInt &a, const APInt &b) { return a * b; });
+}
+
+// ebpf defines division by zero to give zero, and modulo by zero to leave
+// the dividend unchanged
+OpFoldResult ebpf::SDivOp::fold(ArrayRef<Attribute> operands) {
+  if (isConstant(operands[1], 1)) {
+    return lhs();
+  }
+  return constFoldBinaryOp<IntegerAttr>(
+      operands, [](const APInt &a, const APInt &b) {
+        return b.isZero() ? APInt(a.getBitWidth(), 0) : a.sdiv(b);
+      });
+}
+
+OpFoldResult ebpf::UDivOp::fold(ArrayRef<Attribute> operands) {
+  if (isConstant(operands[1], 1)) {
+    return lhs();
+  }
+  return constFoldBinaryOp<IntegerAttr>(
+      operands, [](const APInt &a, const APInt &b) {
+        return b.isZero() ? APInt(a.getBitWidth(), 0) : a.udiv(b);
+      });
+}
+
+OpFoldResult ebpf::SModOp::fold(ArrayRef<Attribute> operands) {
+  return constFoldBinaryOp<IntegerAttr>(
+      operands,
+      [](const APInt &a, const APInt &b) { return b.isZero() ? a : a.srem(b); });
+}
+
+OpFoldResult ebpf::UModOp::fold(ArrayRef<Attribute> operands) {
+  return constFoldBinaryOp<IntegerAttr>(
+      operands,
+      [](const APInt &a, const APInt &b) { return b.isZero() ? a : a.urem(b); });
+}
+
+OpFoldResult ebpf::OrOp::fold(ArrayRef<Attribute> operands) {
+  if (isConstant(operands[1], 0) || lhs() == rhs()) {
+    return lhs();
+  }
+  if (isAllOnes(operands[1])) {
+    return operands[1];
+  }
+  return constFoldBinaryOp<IntegerAttr>(
+      operands, [](const APInt &a, const APInt &b) { return a | b; });
+}
+
+OpFoldResult ebpf::AndOp::fold(ArrayRef<Attribute> operands) {
+  if (isAllOnes(operands[1]) || lhs() == rhs()) {
+    return lhs();
+  }
+  if (isConstant(operands[1], 0)) {
+    return operands[1];
+  }
+  return constFoldBinaryOp<IntegerAttr>(
+      operands, [](const APInt &a, const APInt &b) { return a & b; });
+}
+
+OpFoldResult ebpf::XOrOp::fold(ArrayRef<Attribute> operands) {
+  if (isConstant(operands[1], 0)) {
+    return lhs();
+  }
+  if (lhs() == rhs()) {
+    return IntegerAttr::get(getType(), 0);
+  }
+  return constFoldBinaryOp<IntegerAttr>(
+      operands, [](const APInt &a, const APInt &b) { return a ^ b; });
+}
+
+OpFoldResult ebpf::LSHOp::fold(ArrayRef<Attribute> operands) {
+  if (isConstant(operands[1], 0)) {
+    return lhs();
+  }
+  return constFoldBinaryOp<IntegerAttr>(
+      operands, [](const APInt &a, const APInt &b) {
+        return a.shl(getShiftAmount(a, b));
+      });
+}
+
+OpFoldResult ebpf::RSHOp::fold(ArrayRef<Attribute> operands) {
+  if (isConstant(operands[1], 0)) {
+    return lhs();
+  }
+  return constFoldBinaryOp<IntegerAttr>(
+      operands, [](const APInt &a, const APInt &b) {
+        return a.lshr(getShiftAmount(a, b));
+      });
+}
+
+OpFoldResult ebpf::ShiftRAOp::fold(ArrayRef<Attribute> operands) {
+  if (isConstant(operands[1], 0)) {
+    return lhs();
+  }
+  return constFoldBinaryOp<IntegerAttr>(
+      operands, [](const APInt &a, const APInt &b) {
+        return a.ashr(getShiftAmount(a, b));
+      });
+}
+
+OpFoldResult ebpf::NegOp::fold(ArrayRef<Attribute> operands) {
+  auto operand = operands[0].dyn_cast_or_null<IntegerAttr>();
+  if (!operand) {
+    return {};
+  }
+  return IntegerAttr::get(getType(), -operand.getValue());
+}
+
+// byte order conversions are relative to the host, matching the lowering
+OpFoldResult ebpf::BE16::fold(ArrayRef<Attribute> operands) {
+  return foldByteOrderOp(*this, operands, 16, llvm::sys::IsLittleEndianHost);
+}
+
+OpFoldResult ebpf::BE32::fold(ArrayRef<Attribute> operands) {
+  return foldByteOrderOp(*this, operands, 32, llvm::sys::IsLittleEndianHost);
+}
+
+OpFoldResult ebpf::BE64::fold(ArrayRef<Attribute> operands) {
+  return foldByteOrderOp(*this, operands, 64, llvm::sys::IsLittleEndianHost);
+}
+
+OpFoldResult ebpf::LE16::fold(ArrayRef<Attribute> operands) {
+  return foldByteOrderOp(*this, operands, 16, llvm::sys::IsBigEndianHost);
+}
+
+OpFoldResult ebpf::LE32::fold(ArrayRef<Attribute> operands) {
+  return foldByteOrderOp(*this, operands, 32, llvm::sys::IsBigEndianHost);
+}
+
+OpFoldResult ebpf::LE64::fold(ArrayRef<Attribute> operands) {
+  return foldByteOrderOp(*this, operands, 64, llvm::sys::IsBigEndianHost);
+}
+
+OpFoldResult ebpf::SWAP16::fold(ArrayRef<Attribute> operands) {
+  return foldByteOrderOp(*this, operands, 16, true);
+}
+
+OpFoldResult ebpf::SWAP32::fold(ArrayRef<Attribute> operands) {
+  return foldByteOrderOp(*this, operands, 32, true);
+}
+
+OpFoldResult ebpf::SWAP64::fold(ArrayRef<Attribute> operands) {
+  return foldByteOrderOp(*this, operands, 64, true);
+}
+
+//===----------------------------------------------------------------------===//
+// Canonicalization Patterns
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// and(and(x, c1), c2) -> and(x, c1 & c2), as left behind by the MOVSX masks
+struct MergeAndMasks : public OpRewritePattern<ebpf::AndOp> {
+  using OpRewritePattern<ebpf::AndOp>::OpRewritePattern;
+  LogicalResult matchAndRewrite(ebpf::AndOp op,
+                                PatternRewriter &rewriter) const override {
+    APInt outer, inner;
+    auto innerOp = op.lhs().getDefiningOp<ebpf::AndOp>();
+    if (!innerOp || !matchPattern(op.rhs(), m_ConstantInt(&outer)) ||
+        !matchPattern(innerOp.rhs(), m_ConstantInt(&inner))) {
+      return failure();
+    }
+    Value mask = rewriter.create<ebpf::ConstantOp>(
+        op.getLoc(), op.getType(),
+        rewriter.getIntegerAttr(op.getType(), outer & inner));
+    rewriter.replaceOpWithNewOp<ebpf::AndOp>(op, innerOp.lhs(), mask);
+    return success();
+  }
+};
+
+/// and(loadN(...), c) -> loadN(...) when c keeps all N loaded bits, since
+/// narrow loads already zero the upper bits
+struct RedundantLoadMask : public OpRewritePattern<ebpf::AndOp> {
+  using OpRewritePattern<ebpf::AndOp>::OpRewritePattern;
+  LogicalResult matchAndRewrite(ebpf::AndOp op,
+                                PatternRewriter &rewriter) const override {
+    APInt mask;
+    if (!matchPattern(op.rhs(), m_ConstantInt(&mask))) {
+      return failure();
+    }
+    unsigned width = 0;
+    if (auto *load = op.lhs().getDefiningOp()) {
+      if (isa<ebpf::Load8Op>(load)) {
+        width = 8;
+      } else if (isa<ebpf::Load16Op>(load)) {
+        width = 16;
+      } else if (isa<ebpf::Load32Op>(load)) {
+        width = 32;
+      }
+    }
+    if (width == 0 || width >= mask.getBitWidth() ||
+        mask.countTrailingOnes() < width) {
+      return failure();
+    }
+    rewriter.replaceOp(op, op.lhs());
+    return success();
+  }
+};
+
+/// load(alloca, c) -> v after store(alloca, c, v) in the same block, when
+/// the alloca is only used as the address of loads and stores. The register
+/// slots of memory mode imports then fold to the constants stored in them.
+struct ForwardAllocaStore : public OpRewritePattern<ebpf::LoadOp> {
+  using OpRewritePattern<ebpf::LoadOp>::OpRewritePattern;
+  LogicalResult matchAndRewrite(ebpf::LoadOp op,
+                                PatternRewriter &rewriter) const override {
+    auto alloca = op.lhs().getDefiningOp<ebpf::AllocaOp>();
+    APInt offset;
+    if (!alloca || !matchPattern(op.rhs(), m_ConstantInt(&offset))) {
+      return failure();
+    }
+    auto isMemoryOp = [](Operation *user) {
+      return isa<ebpf::LoadOp, ebpf::Load32Op, ebpf::Load16Op, ebpf::Load8Op,
+                 ebpf::StoreOp, ebpf::Store32Op, ebpf::Store16Op,
+                 ebpf::Store8Op>(user);
+    };
+    // otherwise the slot may be written through another address
+    for (OpOperand &use : alloca->getUses()) {
+      if (use.getOperandNumber() != 0 || !isMemoryOp(use.getOwner())) {
+        return failure();
+      }
+    }
+    for (Operation *prev = op->getPrevNode(); prev;
+         prev = prev->getPrevNode()) {
+      if (!isa<ebpf::StoreOp, ebpf::Store32Op, ebpf::Store16Op,
+               ebpf::Store8Op>(prev) ||
+          prev->getOperand(0) != alloca.getResult()) {
+        continue;
+      }
+      // the latest store to the slot must write the loaded bytes exactly
+      auto store = dyn_cast<ebpf::StoreOp>(prev);
+      APInt storeOffset;
+      if (!store ||
+          !matchPattern(store.offset(), m_ConstantInt(&storeOffset)) ||
+          storeOffset != offset) {
+        return failure();
+      }
+      rewriter.replaceOp(op, store.rhs());
+      return success();
+    }
+    return failure();
+  }
+};
+} // namespace
+
+void ebpf::LoadOp::getCanonicalizationPatterns(RewritePatternSet &patterns,
+                                               MLIRContext *context) {
+  patterns.add<ForwardAllocaStore>(context);
+}
+
+void ebpf::AndOp::getCanonicalizationPatterns(RewritePatternSet &patterns,
+                                              MLIRContext *context) {
+  patterns.add<MergeAndMasks, RedundantLoadMask>(context);
+}
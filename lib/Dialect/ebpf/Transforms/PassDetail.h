@@ -0,0 +1,24 @@
+//===- PassDetail.h - ebpf Pass class details -------------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef EBPF_DIALECT_TRANSFORMS_PASSDETAIL_H
+#define EBPF_DIALECT_TRANSFORMS_PASSDETAIL_H
+
+#include "mlir/IR/BuiltinOps.h"
+#include "mlir/Pass/Pass.h"
+
+namespace mlir {
+namespace ebpf {
+
+#define GEN_PASS_CLASSES
+#include "Dialect/ebpf/Transforms/Passes.h.inc"
+
+} // namespace ebpf
+} // namespace mlir
+
+#endif // EBPF_DIALECT_TRANSFORMS_PASSDETAIL_H
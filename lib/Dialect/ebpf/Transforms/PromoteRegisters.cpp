@@ -0,0 +1,194 @@
+//===- PromoteRegisters.cpp - Promote ebpf registers to SSA ------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "Dialect/ebpf/Transforms/PromoteRegisters.h"
+#include "Dialect/ebpf/IR/ebpf.h"
+#include "PassDetail.h"
+
+#include "mlir/Interfaces/ControlFlowInterfaces.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SetVector.h"
+
+using namespace mlir;
+using namespace ebpf;
+
+namespace {
+bool isZeroOffset(Value offset) {
+  auto constant = offset.getDefiningOp<ebpf::ConstantOp>();
+  return constant && constant.valueAttr().getValue().isZero();
+}
+
+/// @brief A register slot is an alloca that is only read and written as a
+/// whole 64bit value, and whose address never escapes
+/// @param alloca
+/// @return true if every use is a zero offset load or store through alloca
+bool isRegisterSlot(AllocaOp &alloca) {
+  Value slot = alloca.result();
+  for (Operation *user : slot.getUsers()) {
+    if (auto load = dyn_cast<ebpf::LoadOp>(user)) {
+      if (load.lhs() != slot || !isZeroOffset(load.rhs()))
+        return false;
+    } else if (auto store = dyn_cast<ebpf::StoreOp>(user)) {
+      if (store.lhs() != slot || store.rhs() == slot ||
+          !isZeroOffset(store.offset()))
+        return false;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// @brief Drop block arguments that are unused, or that receive the same
+/// value along every incoming edge
+/// @param region
+/// @param firstSlotArg, index of the first argument added for the slots
+/// @return void
+void pruneBlockArguments(Region &region,
+                         const llvm::DenseMap<Block *, unsigned> &firstSlotArg) {
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (Block &block : llvm::drop_begin(region.getBlocks())) {
+      const unsigned first = firstSlotArg.lookup(&block);
+      std::vector<std::pair<Block *, unsigned>> preds;
+      for (auto it = block.pred_begin(); it != block.pred_end(); ++it) {
+        preds.emplace_back(*it, it.getSuccessorIndex());
+      }
+      for (unsigned idx = block.getNumArguments(); idx-- > first;) {
+        BlockArgument arg = block.getArgument(idx);
+        Value incoming;
+        bool unique = true;
+        for (auto &[pred, succIdx] : preds) {
+          auto branch = cast<BranchOpInterface>(pred->getTerminator());
+          Value value = (*branch.getSuccessorOperands(succIdx))[idx];
+          if (value == arg || value == incoming)
+            continue;
+          unique = !incoming;
+          incoming = value;
+          if (!unique)
+            break;
+        }
+        if (!arg.use_empty()) {
+          if (!unique || !incoming)
+            continue;
+          arg.replaceAllUsesWith(incoming);
+        }
+        for (auto &[pred, succIdx] : preds) {
+          auto branch = cast<BranchOpInterface>(pred->getTerminator());
+          branch.getMutableSuccessorOperands(succIdx)->erase(idx);
+        }
+        block.eraseArgument(idx);
+        changed = true;
+      }
+    }
+  }
+}
+
+struct PromoteRegistersPass
+    : public PromoteRegistersBase<PromoteRegistersPass> {
+  void runOnOperation() override {
+    FuncOp func = getOperation();
+    Region &region = func.getBody();
+    if (region.empty())
+      return;
+
+    // every edge must be able to carry the promoted values
+    for (Block &block : region) {
+      Operation *terminator = block.getTerminator();
+      if (terminator->getNumSuccessors() > 0 &&
+          !isa<BranchOpInterface>(terminator))
+        return;
+    }
+
+    llvm::DenseMap<Value, unsigned> slots;
+    std::vector<AllocaOp> allocas;
+    func.walk([&](AllocaOp alloca) {
+      if (isRegisterSlot(alloca)) {
+        slots[alloca.result()] = allocas.size();
+        allocas.push_back(alloca);
+      }
+    });
+    if (allocas.empty())
+      return;
+
+    // every block but the entry receives the current value of each slot
+    Block &entry = region.front();
+    Type regType = allocas.front().getType();
+    llvm::DenseMap<Block *, unsigned> firstSlotArg;
+    for (Block &block : llvm::drop_begin(region.getBlocks())) {
+      firstSlotArg[&block] = block.getNumArguments();
+      for (size_t i = 0; i < allocas.size(); ++i) {
+        block.addArgument(regType, func.getLoc());
+      }
+    }
+
+    // reading a slot before it is written gives zero
+    Value zero;
+    auto getZero = [&]() {
+      if (!zero) {
+        OpBuilder builder(&entry, entry.begin());
+        zero = builder.create<ebpf::ConstantOp>(
+            func.getLoc(), regType, builder.getIntegerAttr(regType, 0));
+      }
+      return zero;
+    };
+
+    llvm::SetVector<Operation *> offsets;
+    for (Block &block : region) {
+      std::vector<Value> current(allocas.size(), nullptr);
+      if (&block != &entry) {
+        const unsigned first = firstSlotArg.lookup(&block);
+        for (size_t i = 0; i < allocas.size(); ++i) {
+          current[i] = block.getArgument(first + i);
+        }
+      }
+      for (Operation &op : llvm::make_early_inc_range(block)) {
+        if (auto load = dyn_cast<ebpf::LoadOp>(&op)) {
+          auto it = slots.find(load.lhs());
+          if (it == slots.end())
+            continue;
+          Value &value = current[it->second];
+          load.result().replaceAllUsesWith(value ? value : getZero());
+          offsets.insert(load.rhs().getDefiningOp());
+          load.erase();
+        } else if (auto store = dyn_cast<ebpf::StoreOp>(&op)) {
+          auto it = slots.find(store.lhs());
+          if (it == slots.end())
+            continue;
+          current[it->second] = store.rhs();
+          offsets.insert(store.offset().getDefiningOp());
+          store.erase();
+        } else if (auto branch = dyn_cast<BranchOpInterface>(&op)) {
+          for (auto &value : current) {
+            if (!value)
+              value = getZero();
+          }
+          for (unsigned i = 0; i < op.getNumSuccessors(); ++i) {
+            branch.getMutableSuccessorOperands(i)->append(current);
+          }
+        }
+      }
+    }
+
+    for (auto alloca : allocas) {
+      alloca.erase();
+    }
+    // the importer builds a fresh zero offset for every register access
+    for (Operation *offset : offsets) {
+      if (offset && offset->use_empty())
+        offset->erase();
+    }
+    pruneBlockArguments(region, firstSlotArg);
+  }
+};
+} // namespace
+
+std::unique_ptr<mlir::Pass> mlir::ebpf::promoteRegisters() {
+  return std::make_unique<PromoteRegistersPass>();
+}
@@ -11,6 +11,7 @@
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/SourceMgr.h"
 
+#include <algorithm>
 #include <iostream>
 #include <string>
 
@@ -49,6 +50,7 @@ Deserialize::parseModelLine(Btor2Line *l,
     break;
 
   case BTOR2_TAG_input:
+    m_inputLines.push_back(l);
     m_inputs[l->lineno] = numberedCommands.first;
     numberedCommands.first = numberedCommands.first + 1;
     break;
@@ -578,6 +580,14 @@ OwningOpRef<FuncOp> Deserialize::buildMainFunction() {
   FuncOp::build(m_builder, state, "_main",
                 FunctionType::get(m_context, {}, {}));
   OwningOpRef<FuncOp> funcOp = cast<FuncOp>(Operation::create(state));
+  // the lowering names the arguments of the loop by the ids of their states,
+  // e.g. in the checkpoints of a trace
+  SmallVector<int64_t> stateIds;
+  for (auto stateLine : m_states) {
+    stateIds.push_back(stateLine->id);
+  }
+  funcOp->setAttr(btor::BtorDialect::getStateIdsAttrName(),
+                  m_builder.getI64ArrayAttr(stateIds));
   Region &region = funcOp->getBody();
   OpBuilder::InsertionGuard guard(m_builder);
   auto *body = m_builder.createBlock(&region, {}, {}, {});
@@ -598,8 +608,140 @@ OwningOpRef<FuncOp> Deserialize::buildMainFunction() {
   return funcOp;
 }
 
+FuncOp
+Deserialize::buildStepABIFunction(ModuleOp module, StringRef name,
+                                  const std::vector<Type> &argumentTypes,
+                                  const std::vector<Type> &resultTypes) {
+  m_builder.setInsertionPointToEnd(module.getBody());
+  auto funcOp = m_builder.create<FuncOp>(
+      m_unknownLoc, name,
+      FunctionType::get(m_context, argumentTypes, resultTypes));
+  m_builder.setInsertionPointToStart(funcOp.addEntryBlock());
+  // clear cache so that values are mapped to the right Basic Block
+  m_cache.clear();
+  return funcOp;
+}
+
+///===----------------------------------------------------------------------===//
+/// The condition of a bad or constraint line, negated if its argument is
+///===----------------------------------------------------------------------===//
+Value Deserialize::buildConditionOf(Btor2Line *line) {
+  auto argument = line->args[0];
+  toOp(getLineById(std::abs(argument)));
+  if (!valueAtIdIsInCache(argument)) {
+    createNegateLine(argument, line->lineno,
+                     getFromCacheById(std::abs(argument)));
+  }
+  return getFromCacheById(argument);
+}
+
+///===----------------------------------------------------------------------===//
+/// The step ABI outlines the model into functions over the values of its
+/// states and inputs, in the order of their numbers:
+///
+///   btor_init_values(states) -> states
+///   btor_step_values(states, inputs) -> next states
+///   btor_bad_values(states, inputs) -> !btor.bv<64>, bit i for bad i
+///   btor_constraint_values(states, inputs) -> !btor.bv<1>
+///
+/// States without an init or a next keep the values they are passed, so the
+/// caller chooses them. Bads past the 63rd all set bit 63. The btor to llvm
+/// lowering wraps these functions into entry points over packed states.
+///===----------------------------------------------------------------------===//
+bool Deserialize::buildStepFunctions(ModuleOp module) {
+  std::vector<Type> stateTypes, argumentTypes;
+  for (auto state : m_states) {
+    // arrays are lowered to vectors when they have at most 32 elements
+    if (state->sort.tag == BTOR2_TAG_SORT_array &&
+        (m_sorts.at(state->sort.array.index)->sort.bitvec.width > 5 ||
+         m_sorts.at(state->sort.array.element)->sort.bitvec.width > 64)) {
+      emitError(FileLineColLoc::get(m_sourceFile, state->lineno, 0))
+          << "the step abi supports arrays of at most 32 elements of at "
+             "most 64 bits";
+      return false;
+    }
+    stateTypes.push_back(getTypeOf(state));
+  }
+  argumentTypes = stateTypes;
+  for (auto input : m_inputLines) {
+    if (input->sort.tag == BTOR2_TAG_SORT_array) {
+      emitError(FileLineColLoc::get(m_sourceFile, input->lineno, 0))
+          << "the step abi does not support array inputs";
+      return false;
+    }
+    argumentTypes.push_back(getTypeOf(input));
+  }
+  const unsigned numStates = m_states.size();
+  auto setCacheWithArguments = [&](FuncOp funcOp, bool withInputs) {
+    auto arguments = funcOp.getArguments();
+    for (unsigned i = 0; i < numStates; ++i) {
+      if (withInputs || m_states.at(i)->init == 0) {
+        setCacheWithId(m_states.at(i)->id, arguments[i]);
+      }
+    }
+    for (unsigned i = 0; withInputs && i < m_inputLines.size(); ++i) {
+      setCacheWithId(m_inputLines.at(i)->id, arguments[numStates + i]);
+    }
+  };
+
+  auto initFunc =
+      buildStepABIFunction(module, "btor_init_values", stateTypes, stateTypes);
+  setCacheWithArguments(initFunc, false);
+  for (auto state : m_states) {
+    if (state->init) {
+      toOp(m_inits.at(state->id));
+    }
+  }
+  buildReturnOp(collectReturnValuesForInit(stateTypes));
+
+  auto stepFunc = buildStepABIFunction(module, "btor_step_values",
+                                       argumentTypes, stateTypes);
+  setCacheWithArguments(stepFunc, true);
+  for (auto next : m_nexts) {
+    toOp(next);
+  }
+  std::vector<Value> results(numStates, nullptr);
+  for (unsigned i = 0; i < numStates; ++i) {
+    int64_t nextState = m_states.at(i)->next;
+    results[i] = nextState == 0 ? stepFunc.getArgument(i)
+                                : getFromCacheById(nextState);
+  }
+  buildReturnOp(results);
+
+  auto maskType = btor::BitVecType::get(m_context, 64);
+  auto badFunc = buildStepABIFunction(module, "btor_bad_values", argumentTypes,
+                                      {maskType});
+  setCacheWithArguments(badFunc, true);
+  Value mask = buildConstantOp(64, "zero", 10, 0)->getResult(0);
+  for (auto bad : m_bads) {
+    auto lineId = bad->lineno;
+    Value bit = buildExtOp<btor::UExtOp>(buildConditionOf(bad), 64, lineId)
+                    ->getResult(0);
+    unsigned number = std::min(map_bads.at(lineId), 63u);
+    Value shift =
+        buildConstantOp(64, std::to_string(number), 10, lineId)->getResult(0);
+    bit = buildBinaryOp<btor::ShiftLLOp>(bit, shift, lineId)->getResult(0);
+    mask = buildBinaryOp<btor::OrOp>(mask, bit, lineId)->getResult(0);
+  }
+  buildReturnOp({mask});
+
+  auto holdsType = btor::BitVecType::get(m_context, 1);
+  auto constraintFunc = buildStepABIFunction(
+      module, "btor_constraint_values", argumentTypes, {holdsType});
+  setCacheWithArguments(constraintFunc, true);
+  Value holds = buildConstantOp(1, "one", 10, 0)->getResult(0);
+  for (auto constraint : m_constraints) {
+    holds = buildBinaryOp<btor::AndOp>(holds, buildConditionOf(constraint),
+                                       constraint->lineno)
+                ->getResult(0);
+  }
+  buildReturnOp({holds});
+  return true;
+}
+
 static OwningOpRef<ModuleOp> deserializeModule(const llvm::MemoryBuffer *input,
-                                               MLIRContext *context) {
+                                               MLIRContext *context,
+                                               const ImportOptions &options) {
   context->loadDialect<btor::BtorDialect, StandardOpsDialect>();
 
   OwningOpRef<ModuleOp> owningModule(ModuleOp::create(FileLineColLoc::get(
@@ -607,6 +749,11 @@ static OwningOpRef<ModuleOp> deserializeModule(const llvm::MemoryBuffer *input,
 
   Deserialize deserialize(context, input->getBufferIdentifier().str());
   if (deserialize.parseModelIsSuccessful()) {
+    if (options.abi == BtorABI::Step) {
+      if (!deserialize.buildStepFunctions(*owningModule))
+        return {};
+      return owningModule;
+    }
     OwningOpRef<FuncOp> mainFunc = deserialize.buildMainFunction();
     if (!mainFunc)
       return owningModule;
@@ -619,12 +766,14 @@ static OwningOpRef<ModuleOp> deserializeModule(const llvm::MemoryBuffer *input,
 
 namespace mlir {
 namespace btor {
-void registerFromBtorTranslation() {
+void registerFromBtorTranslation(const ImportOptions &options) {
   TranslateToMLIRRegistration fromBtor(
-      "import-btor", [](llvm::SourceMgr &sourceMgr, MLIRContext *context) {
+      "import-btor",
+      [&options](llvm::SourceMgr &sourceMgr, MLIRContext *context) {
         assert(sourceMgr.getNumBuffers() == 1 && "expected one buffer");
         return deserializeModule(
-            sourceMgr.getMemoryBuffer(sourceMgr.getMainFileID()), context);
+            sourceMgr.getMemoryBuffer(sourceMgr.getMainFileID()), context,
+            options);
       });
 }
 } // namespace btor
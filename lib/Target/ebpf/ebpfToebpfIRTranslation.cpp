@@ -6,35 +6,51 @@
 #include "mlir/IR/Builders.h"
 #include "mlir/IR/BuiltinOps.h"
 #include "mlir/IR/Dialect.h"
+#include "mlir/IR/Threading.h"
 #include "mlir/Translation.h"
+#include "llvm/ADT/ScopeExit.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Debug.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/SourceMgr.h"
 
+#include <algorithm>
+#include <cctype>
 #include <iostream>
 #include <string>
 
 using namespace mlir;
 using namespace mlir::ebpf;
 
+#define DEBUG_TYPE "ebpf-import"
+
+bool mlir::ebpf::isTraceEnabled(const ImportOptions &options) {
+  bool enabled = options.trace;
+  LLVM_DEBUG(enabled = true);
+  return enabled;
+}
+
+void SectionBuilder::trace(
+    llvm::function_ref<void(llvm::raw_ostream &)> print) const {
+  if (m_trace) {
+    print(llvm::errs());
+  }
+}
+
 #define MINUS1_32 4294967295
 #define MINUS1_16 65535
 #define MINUS1_8 255
 
-void Deserialize::createJmpOp(Jmp jmp, label_t cur_label) {
-  // std::cerr << " --> f:" << jmp.target.from;
-  // std::cerr << ", t: " << jmp.target.to << std::endl;
+void SectionBuilder::createJmpOp(const Jmp &jmp, const label_t &cur_label) {
   assert(jmp.target.from > cur_label.from);
-  InstructionSeq prog = m_sections.front();
-  const auto &[label, ins, line_info] = prog.at(jmp.target.from);
-  // std::cerr << "  l: " << label.from << ", j-f:" << jmp.target.from
-  //           << std::endl;
+  const auto &[label, ins, line_info] =
+      m_section.at(getInsByLabel(jmp.target.from));
   assert(label.from == jmp.target.from);
   buildJmpOp(cur_label.from, jmp);
   return;
 }
 
-void Deserialize::createUnaryOp(Un un) {
+void SectionBuilder::createUnaryOp(const Un &un) {
   using Op = Un::Op;
   Value rhs, res;
   rhs = getRegister(un.dst.v);
@@ -73,7 +89,7 @@ void Deserialize::createUnaryOp(Un un) {
   setRegister(un.dst.v, res);
 }
 
-void Deserialize::createBinaryOp(Bin bin) {
+void SectionBuilder::createBinaryOp(const Bin &bin) {
   using Op = Bin::Op;
   Value rhs, lhs, res;
   lhs = getRegister(bin.dst.v);
@@ -145,7 +161,8 @@ void Deserialize::createBinaryOp(Bin bin) {
   return;
 }
 
-void Deserialize::createMemOp(Mem mem) {
+void SectionBuilder::createMemOp(const Mem &mem) {
+  createAccessCheck(mem);
   Value res;
   auto offset = buildConstantOp(mem.access.offset);
   switch (mem.access.width) {
@@ -183,7 +200,34 @@ void Deserialize::createMemOp(Mem mem) {
   }
 }
 
-void Deserialize::createLoadMapOp(LoadMapFd loadMap) {
+/// Guard a memory access with the checks of the kernel verifier: accesses
+/// through the stack pointer stay in the stack frame, and the result of a
+/// map lookup is not dereferenced while it is null
+void SectionBuilder::createAccessCheck(const Mem &mem) {
+  const auto base = mem.access.basereg.v;
+  if (base == REG::R10_STACK_POINTER) {
+    const int64_t offset = mem.access.offset;
+    if (offset >= -m_stackSize && offset + mem.access.width <= 0)
+      return;
+    // the offset is known, so the access fails whenever it is reached
+    trace([&](llvm::raw_ostream &os) {
+      os << "stack access out of bounds at " << offset << "\n";
+    });
+    auto type = m_builder.getI1Type();
+    Value inBounds = m_builder.create<ebpf::ConstantOp>(
+        m_unknownLoc, type, m_builder.getIntegerAttr(type, 0));
+    m_builder.create<ebpf::AssertOp>(m_unknownLoc, inBounds);
+    return;
+  }
+  if (!m_mayBeNull.test(base))
+    return;
+  Value notNull = m_builder.create<ebpf::CmpOp>(
+      m_unknownLoc, ebpf::ebpfPredicate::ne, getRegister(base),
+      buildConstantOp(0));
+  m_builder.create<ebpf::AssertOp>(m_unknownLoc, notNull);
+}
+
+void SectionBuilder::createLoadMapOp(const LoadMapFd &loadMap) {
   Value res, map;
   auto dst = loadMap.dst.v;
   map = buildConstantOp(loadMap.mapfd);
@@ -191,103 +235,111 @@ void Deserialize::createLoadMapOp(LoadMapFd loadMap) {
   setRegister(dst, res);
 }
 
-void Deserialize::createNDOp() {
+void SectionBuilder::createCallOp(const Call &call) {
+  // helpers take their arguments in R1 to R5 and return in R0
+  std::vector<Value> args;
+  for (uint8_t i = REG::R1_ARG; i <= REG::R5_ARG; ++i) {
+    args.push_back(getRegister(i));
+  }
+  Value res = m_builder.create<ebpf::CallOp>(
+      m_unknownLoc, m_builder.getI64Type(),
+      m_builder.getI64IntegerAttr(call.func), args);
+  setRegister(REG::R0_RETURN_VALUE, res);
+}
+
+void SectionBuilder::createNDOp() {
   Value res = m_builder.create<NDOp>(m_unknownLoc, m_builder.getI64Type());
   setRegister(0, res);
 }
 
-void Deserialize::createMLIR(Instruction ins, label_t cur_label) {
-  std::cerr << cur_label.from << " ";
+void SectionBuilder::createMLIR(const Instruction &ins,
+                                const label_t &cur_label) {
+  trace([&](llvm::raw_ostream &os) { os << cur_label.from << " "; });
+  // the checks of an instruction see the registers before it writes them
+  auto trackNull =
+      llvm::make_scope_exit([&] { updateMayBeNull(ins, m_mayBeNull); });
   if (std::holds_alternative<Undefined>(ins)) {
-    // std::cerr << "undefined" << std::endl;
     return;
   } else if (std::holds_alternative<Bin>(ins)) {
-    auto binOp = std::get<Bin>(ins);
-    // std::cerr << "bin: ";
+    const auto &binOp = std::get<Bin>(ins);
     createBinaryOp(binOp);
     return;
   } else if (std::holds_alternative<Un>(ins)) {
-    auto unOp = std::get<Un>(ins);
-    // std::cerr << "unary" << std::endl;
+    const auto &unOp = std::get<Un>(ins);
     createUnaryOp(unOp);
     return;
   } else if (std::holds_alternative<LoadMapFd>(ins)) {
-    auto mapOp = std::get<LoadMapFd>(ins);
-    std::cerr << "LoadMapFd" << std::endl;
+    const auto &mapOp = std::get<LoadMapFd>(ins);
+    trace([&](llvm::raw_ostream &os) { os << "LoadMapFd\n"; });
     createLoadMapOp(mapOp);
     return;
   } else if (std::holds_alternative<Call>(ins)) {
-    auto callOp = std::get<Call>(ins);
-    std::cerr << "-- call: " << callOp.func + 0 << std::endl;
-    createNDOp();
-    if (callOp.is_map_lookup) {
-      std::cerr << "Map Lookup" << std::endl;
-      return;
-    }
-    std::cerr << "Other Call" << std::endl;
-    // assert(false);
+    const auto &callOp = std::get<Call>(ins);
+    trace([&](llvm::raw_ostream &os) {
+      os << "call " << callOp.func
+         << (callOp.is_map_lookup ? " map lookup" : "") << "\n";
+    });
+    createCallOp(callOp);
     return;
   } else if (std::holds_alternative<Callx>(ins)) {
-    std::cerr << "Callx" << std::endl;
+    trace([&](llvm::raw_ostream &os) { os << "Callx\n"; });
     createNDOp();
     return;
   } else if (std::holds_alternative<Exit>(ins)) {
-    // std::cerr << "Exit" << std::endl;
     return;
   } else if (std::holds_alternative<Jmp>(ins)) {
-    auto jmpOp = std::get<Jmp>(ins);
-    // std::cerr << "Jmp: ";
+    const auto &jmpOp = std::get<Jmp>(ins);
     createJmpOp(jmpOp, cur_label);
     return;
   } else if (std::holds_alternative<Mem>(ins)) {
-    auto memOp = std::get<Mem>(ins);
-    // std::cerr << "Mem" << std::endl;
+    const auto &memOp = std::get<Mem>(ins);
     createMemOp(memOp);
     return;
   } else if (std::holds_alternative<Packet>(ins)) {
-    std::cerr << "Packet" << std::endl;
+    trace([&](llvm::raw_ostream &os) { os << "Packet\n"; });
     assert(false);
     return;
   } else if (std::holds_alternative<Assume>(ins)) {
-    std::cerr << "Assume" << std::endl;
+    trace([&](llvm::raw_ostream &os) { os << "Assume\n"; });
     assert(false);
     return;
   } else if (std::holds_alternative<Atomic>(ins)) {
-    std::cerr << "Atomic" << std::endl;
+    trace([&](llvm::raw_ostream &os) { os << "Atomic\n"; });
     assert(false);
     return;
   } else if (std::holds_alternative<Assert>(ins)) {
-    std::cerr << "Assert" << std::endl;
-    assert(false);
+    // only the cfg of the verifier holds assertions; the checks that matter
+    // here are built for each access by createAccessCheck
+    trace([&](llvm::raw_ostream &os) { os << "Assert\n"; });
     return;
   } else if (std::holds_alternative<IncrementLoopCounter>(ins)) {
-    std::cerr << "IncrementLoopCounter" << std::endl;
+    trace([&](llvm::raw_ostream &os) { os << "IncrementLoopCounter\n"; });
     assert(false);
     return;
   }
   assert(false && "unknown");
 }
 
-void Deserialize::buildSSAFunctionBody() {
-  // get first section
-  InstructionSeq prog = m_sections.front();
+void SectionBuilder::buildSSAFunctionBody() {
   collectBlocks();
-  std::cerr << prog.size() << " instructions" << std::endl;
-  size_t cur_op = 0;
+  computeLiveness();
+  computeMayBeNull();
+  trace([&](llvm::raw_ostream &os) {
+    os << m_section.size() << " instructions\n";
+  });
+  size_t cur_op = 0, cur_label = 0;
   for (const size_t next : m_startOfNextBlock) {
-    assert(m_jumpBlocks.contains(cur_op));
-    Block *curBlock = m_jumpBlocks.at(cur_op);
+    assert(m_jumpBlocks.contains(cur_label));
+    Block *curBlock = m_jumpBlocks.at(cur_label);
     m_builder.setInsertionPointToEnd(curBlock);
-    std::cerr << "NEW block at: " << cur_op << std::endl;
-    std::cerr << "  next: " << next << std::endl;
+    trace([&](llvm::raw_ostream &os) {
+      os << "block at: " << cur_label << ", next: " << next << "\n";
+    });
     // setup registers to match block arguments
-    for (size_t i = 0; i < m_ebpfRegisters; ++i) {
-      setRegister(i, curBlock->getArgument(i));
-      // m_registers.at(i) = curBlock->getArgument(i);
-    }
-    for (; cur_op < next; ++cur_op) {
-      const LabeledInstruction &labeled_inst = prog.at(cur_op);
-      const auto &[label, ins, _] = labeled_inst;
+    setRegistersFromBlock(curBlock);
+    m_mayBeNull = m_mayBeNullIn.at(cur_label);
+    for (const size_t end = getInsByLabel(next); cur_op < end; ++cur_op) {
+      const auto &[label, ins, _] = m_section[cur_op];
       createMLIR(ins, label);
     }
     if (curBlock->empty() ||
@@ -295,42 +347,43 @@ void Deserialize::buildSSAFunctionBody() {
       assert(m_jumpBlocks.contains(next));
       m_builder.setInsertionPointToEnd(curBlock);
       m_builder.create<BranchOp>(m_unknownLoc, m_jumpBlocks.at(next),
-                                 m_registers);
-      std::cerr << "/**/ cpp block at: " << next << std::endl;
+                                 getBlockOperands(m_jumpBlocks.at(next)));
+      trace([&](llvm::raw_ostream &os) {
+        os << "fallthrough to: " << next << "\n";
+      });
       m_lastBlock = m_jumpBlocks.at(next);
     }
+    cur_label = next;
   }
-  if (cur_op < prog.size()) {
-    m_builder.setInsertionPointToEnd(m_lastBlock);
-    // setup registers to match block arguments
-    for (size_t i = 0; i < m_ebpfRegisters; ++i) {
-      setRegister(i, m_lastBlock->getArgument(i));
-      // m_registers.at(i) = m_lastBlock->getArgument(i);
-    }
-  }
-  for (; cur_op < prog.size(); ++cur_op) {
-    const LabeledInstruction &labeled_inst = prog.at(cur_op);
-    const auto &[label, ins, _] = labeled_inst;
+  // the last block is entered either by the code that follows the last jump
+  // or by the return that follows the whole section
+  m_builder.setInsertionPointToEnd(m_lastBlock);
+  setRegistersFromBlock(m_lastBlock);
+  m_mayBeNull = m_mayBeNullIn.at(cur_label);
+  for (; cur_op < m_section.size(); ++cur_op) {
+    const auto &[label, ins, _] = m_section[cur_op];
     createMLIR(ins, label);
   }
   m_builder.setInsertionPointToEnd(m_lastBlock);
 }
 
-void Deserialize::buildMemFunctionBody() {
-  // get first section
-  InstructionSeq prog = m_sections.front();
+void SectionBuilder::buildMemFunctionBody() {
   collectBlocks();
-  std::cerr << prog.size() << " instructions" << std::endl;
-  size_t cur_op = 0;
+  computeMayBeNull();
+  trace([&](llvm::raw_ostream &os) {
+    os << m_section.size() << " instructions\n";
+  });
+  size_t cur_op = 0, cur_label = 0;
   for (const size_t next : m_startOfNextBlock) {
-    assert(m_jumpBlocks.contains(cur_op));
-    Block *curBlock = m_jumpBlocks.at(cur_op);
+    assert(m_jumpBlocks.contains(cur_label));
+    Block *curBlock = m_jumpBlocks.at(cur_label);
     m_builder.setInsertionPointToEnd(curBlock);
-    std::cerr << "NEW block at: " << cur_op << std::endl;
-    std::cerr << "  next: " << next << std::endl;
-    for (; cur_op < next; ++cur_op) {
-      const LabeledInstruction &labeled_inst = prog.at(cur_op);
-      const auto &[label, ins, _] = labeled_inst;
+    trace([&](llvm::raw_ostream &os) {
+      os << "block at: " << cur_label << ", next: " << next << "\n";
+    });
+    m_mayBeNull = m_mayBeNullIn.at(cur_label);
+    for (const size_t end = getInsByLabel(next); cur_op < end; ++cur_op) {
+      const auto &[label, ins, _] = m_section[cur_op];
       createMLIR(ins, label);
     }
     if (curBlock->empty() ||
@@ -338,48 +391,242 @@ void Deserialize::buildMemFunctionBody() {
       assert(m_jumpBlocks.contains(next));
       m_builder.setInsertionPointToEnd(curBlock);
       m_builder.create<BranchOp>(m_unknownLoc, m_jumpBlocks.at(next));
-      std::cerr << "/**/ cpp block at: " << next << std::endl;
+      trace([&](llvm::raw_ostream &os) {
+        os << "fallthrough to: " << next << "\n";
+      });
       m_lastBlock = m_jumpBlocks.at(next);
     }
+    cur_label = next;
   }
-  if (cur_op < prog.size()) {
+  if (cur_op < m_section.size()) {
     m_builder.setInsertionPointToEnd(m_lastBlock);
+    m_mayBeNull = m_mayBeNullIn.at(cur_label);
   }
-  for (; cur_op < prog.size(); ++cur_op) {
-    const LabeledInstruction &labeled_inst = prog.at(cur_op);
-    const auto &[label, ins, _] = labeled_inst;
+  for (; cur_op < m_section.size(); ++cur_op) {
+    const auto &[label, ins, _] = m_section[cur_op];
     createMLIR(ins, label);
   }
   m_builder.setInsertionPointToEnd(m_lastBlock);
 }
 
-void Deserialize::collectBlocks() {
-  auto prog = m_sections.front();
-  for (const LabeledInstruction &labeled_inst : prog) {
+void SectionBuilder::indexLabels() {
+  // labels count instruction slots, so wide instructions (lddw) leave gaps
+  // between the label and the position in the unmarshalled program
+  size_t numLabels = 0;
+  if (!m_section.empty()) {
+    numLabels = std::get<label_t>(m_section.back()).from + 1;
+  }
+  m_labelToIndex.assign(numLabels + 1, m_section.size());
+  for (size_t i = 0; i < m_section.size(); ++i) {
+    m_labelToIndex[std::get<label_t>(m_section[i]).from] = i;
+  }
+}
+
+void SectionBuilder::collectBlocks() {
+  for (const LabeledInstruction &labeled_inst : m_section) {
     const auto &[label, ins, line_info] = labeled_inst;
     if (std::holds_alternative<Jmp>(ins)) {
-      auto jmp = std::get<Jmp>(ins);
+      const auto &jmp = std::get<Jmp>(ins);
       auto jmpTo = jmp.target.from;
       if (!m_jmpTargets.contains(jmpTo)) {
         incrementBlocks(jmpTo);
       }
-      if (jmp.cond.has_value()) {
-        // assume that the next instruction is defined
-        incrementBlocks(label.from + 1);
-      }
+      // assume that the next instruction is defined; it starts a new block
+      // even after an unconditional jump, which already ends the current one
+      incrementBlocks(label.from + 1);
     }
   }
   assert(m_numBlocks == m_startOfNextBlock.size());
   std::sort(m_startOfNextBlock.begin(), m_startOfNextBlock.end());
-  std::cerr << "we need " << m_numBlocks << " blocks" << std::endl;
+  trace([&](llvm::raw_ostream &os) {
+    os << "we need " << m_numBlocks << " blocks\n";
+  });
 }
 
-OwningOpRef<FuncOp> Deserialize::buildXDPFunction() {
+/// Registers read and written by an instruction, mirroring what createMLIR
+/// emits for it
+void SectionBuilder::getUsesAndDefs(const Instruction &ins, RegisterSet &uses,
+                                    RegisterSet &defs) {
+  if (std::holds_alternative<Bin>(ins)) {
+    const auto &bin = std::get<Bin>(ins);
+    if (std::holds_alternative<Reg>(bin.v))
+      uses.set(std::get<Reg>(bin.v).v);
+    switch (bin.op) {
+    case Bin::Op::MOV:
+    case Bin::Op::MOVSX8:
+    case Bin::Op::MOVSX16:
+    case Bin::Op::MOVSX32:
+      break;
+    default:
+      uses.set(bin.dst.v);
+    }
+    defs.set(bin.dst.v);
+  } else if (std::holds_alternative<Un>(ins)) {
+    const auto &un = std::get<Un>(ins);
+    uses.set(un.dst.v);
+    defs.set(un.dst.v);
+  } else if (std::holds_alternative<LoadMapFd>(ins)) {
+    const auto &loadMap = std::get<LoadMapFd>(ins);
+    uses.set(loadMap.dst.v);
+    defs.set(loadMap.dst.v);
+  } else if (std::holds_alternative<Call>(ins)) {
+    for (uint8_t i = REG::R1_ARG; i <= REG::R5_ARG; ++i) {
+      uses.set(i);
+    }
+    defs.set(REG::R0_RETURN_VALUE);
+  } else if (std::holds_alternative<Callx>(ins)) {
+    defs.set(REG::R0_RETURN_VALUE);
+  } else if (std::holds_alternative<Mem>(ins)) {
+    const auto &mem = std::get<Mem>(ins);
+    uses.set(mem.access.basereg.v);
+    if (mem.is_load) {
+      defs.set(std::get<Reg>(mem.value).v);
+    } else if (std::holds_alternative<Reg>(mem.value)) {
+      uses.set(std::get<Reg>(mem.value).v);
+    }
+  } else if (std::holds_alternative<Jmp>(ins)) {
+    const auto &jmp = std::get<Jmp>(ins);
+    if (jmp.cond.has_value()) {
+      uses.set(jmp.cond->left.v);
+      if (std::holds_alternative<Reg>(jmp.cond->right))
+        uses.set(std::get<Reg>(jmp.cond->right).v);
+    }
+  }
+}
+
+/// Follow the results of map lookups through an instruction. A register
+/// stays tracked when it is moved to another one, and stops being tracked
+/// once it is written otherwise.
+void SectionBuilder::updateMayBeNull(const Instruction &ins,
+                                     RegisterSet &mayBeNull) {
+  if (const auto *call = std::get_if<Call>(&ins)) {
+    mayBeNull.set(REG::R0_RETURN_VALUE, call->is_map_lookup);
+    return;
+  }
+  if (const auto *bin = std::get_if<Bin>(&ins)) {
+    if (bin->op == Bin::Op::MOV && std::holds_alternative<Reg>(bin->v)) {
+      mayBeNull.set(bin->dst.v, mayBeNull.test(std::get<Reg>(bin->v).v));
+      return;
+    }
+  }
+  RegisterSet uses, defs;
+  getUsesAndDefs(ins, uses, defs);
+  mayBeNull &= ~defs;
+}
+
+void SectionBuilder::computeBlockGraph(
+    std::vector<size_t> &starts, std::vector<std::vector<size_t>> &succs) {
+  // blocks start at the entry and at every label found by collectBlocks
+  starts = {0};
+  starts.insert(starts.end(), m_startOfNextBlock.begin(),
+                m_startOfNextBlock.end());
+  const size_t numBlocks = starts.size();
+  succs.assign(numBlocks, {});
+  const auto blockOf = [&](size_t label) {
+    return std::lower_bound(starts.begin(), starts.end(), label) -
+           starts.begin();
+  };
+  for (size_t b = 0; b < numBlocks; ++b) {
+    const size_t begin = getInsByLabel(starts[b]);
+    const size_t end = getBlockEnd(starts, b);
+    // successors follow the branches built by buildJmpOp and the fallthrough
+    // branches built by the function body builders; a conditional jump
+    // lists its target first
+    const Jmp *jmp = nullptr;
+    if (begin < end)
+      jmp = std::get_if<Jmp>(&std::get<Instruction>(m_section[end - 1]));
+    if (jmp) {
+      succs[b].push_back(blockOf(jmp->target.from));
+      if (jmp->cond.has_value())
+        succs[b].push_back(b + 1);
+    } else if (b + 1 < numBlocks) {
+      succs[b].push_back(b + 1);
+    }
+  }
+}
+
+void SectionBuilder::computeLiveness() {
+  std::vector<size_t> starts;
+  std::vector<std::vector<size_t>> succs;
+  computeBlockGraph(starts, succs);
+  const size_t numBlocks = starts.size();
+  std::vector<RegisterSet> uses(numBlocks), defs(numBlocks);
+  for (size_t b = 0; b < numBlocks; ++b) {
+    const size_t end = getBlockEnd(starts, b);
+    for (size_t i = getInsByLabel(starts[b]); i < end; ++i) {
+      RegisterSet insUses, insDefs;
+      getUsesAndDefs(std::get<Instruction>(m_section[i]), insUses, insDefs);
+      uses[b] |= insUses & ~defs[b];
+      defs[b] |= insDefs;
+    }
+  }
+  // jumps only go forward, so a single backward sweep reaches the fixpoint
+  std::vector<RegisterSet> liveIn(numBlocks);
+  for (size_t b = numBlocks; b-- > 0;) {
+    RegisterSet liveOut;
+    if (succs[b].empty())
+      liveOut.set(REG::R0_RETURN_VALUE);
+    for (size_t succ : succs[b])
+      liveOut |= liveIn[succ];
+    liveIn[b] = uses[b] | (liveOut & ~defs[b]);
+    m_liveIn[starts[b]] = liveIn[b];
+  }
+}
+
+/// A block may see a null lookup result in a register if any of its
+/// predecessors may pass one to it. Comparing the register with zero
+/// removes it on the edge where it is known not to be null.
+void SectionBuilder::computeMayBeNull() {
+  std::vector<size_t> starts;
+  std::vector<std::vector<size_t>> succs;
+  computeBlockGraph(starts, succs);
+  const size_t numBlocks = starts.size();
+  std::vector<RegisterSet> in(numBlocks);
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (size_t b = 0; b < numBlocks; ++b) {
+      RegisterSet out = in[b];
+      const size_t begin = getInsByLabel(starts[b]);
+      const size_t end = getBlockEnd(starts, b);
+      for (size_t i = begin; i < end; ++i) {
+        updateMayBeNull(std::get<Instruction>(m_section[i]), out);
+      }
+      // the register is not null where `r == 0` fails or `r != 0` holds
+      RegisterSet notNullWhenTaken, notNullOtherwise;
+      const Jmp *jmp = nullptr;
+      if (begin < end)
+        jmp = std::get_if<Jmp>(&std::get<Instruction>(m_section[end - 1]));
+      if (jmp && jmp->cond.has_value() &&
+          std::holds_alternative<Imm>(jmp->cond->right) &&
+          std::get<Imm>(jmp->cond->right).v == 0) {
+        if (jmp->cond->op == Condition::Op::EQ)
+          notNullOtherwise.set(jmp->cond->left.v);
+        else if (jmp->cond->op == Condition::Op::NE)
+          notNullWhenTaken.set(jmp->cond->left.v);
+      }
+      for (size_t s = 0; s < succs[b].size(); ++s) {
+        const RegisterSet edge =
+            out & ~(s == 0 ? notNullWhenTaken : notNullOtherwise);
+        const size_t succ = succs[b][s];
+        if ((in[succ] | edge) != in[succ]) {
+          in[succ] |= edge;
+          changed = true;
+        }
+      }
+    }
+  }
+  for (size_t b = 0; b < numBlocks; ++b) {
+    m_mayBeNullIn[starts[b]] = in[b];
+  }
+}
+
+OwningOpRef<FuncOp> SectionBuilder::buildXDPFunction() {
   auto regType = m_builder.getI64Type();
   std::vector<Type> argTypes(m_ebpfRegisters, regType);
-  // create xdp_entry function with two pointer parameters
+  // create a function named after the section, which takes the registers
+  // and returns r0
   OperationState state(m_unknownLoc, FuncOp::getOperationName());
-  FuncOp::build(m_builder, state, "xdp_entry",
+  FuncOp::build(m_builder, state, m_name,
                 FunctionType::get(m_context, {argTypes}, {regType}));
   OwningOpRef<FuncOp> funcOp = cast<FuncOp>(Operation::create(state));
   std::vector<Location> argLocs(m_ebpfRegisters, funcOp->getLoc());
@@ -389,6 +636,9 @@ OwningOpRef<FuncOp> Deserialize::buildXDPFunction() {
   m_builder.setInsertionPointToStart(body);
   // book keeping for future blocks
   updateBlocksMap(body, 0);
+  for (uint8_t i = 0; i < m_ebpfRegisters; ++i) {
+    m_blockRegisters[body].push_back(i);
+  }
   m_lastBlock = body;
   // setup registers
   m_registers = std::vector<mlir::Value>(m_ebpfRegisters, nullptr);
@@ -396,11 +646,9 @@ OwningOpRef<FuncOp> Deserialize::buildXDPFunction() {
   for (size_t i = 0; i < m_ebpfRegisters; ++i) {
     if (m_ssa) {
       setRegister(i, body->getArgument(i));
-      // m_registers.at(i) = body->getArgument(i);
     } else {
       Value reg = m_builder.create<ebpf::AllocaOp>(m_unknownLoc,
                                                    m_builder.getI64Type());
-      // setRegister(i, reg);
       m_registers.at(i) = reg;
       m_builder.create<ebpf::StoreOp>(m_unknownLoc, reg, zero_offset,
                                       body->getArgument(i));
@@ -410,9 +658,6 @@ OwningOpRef<FuncOp> Deserialize::buildXDPFunction() {
   // build function body
   if (m_ssa) {
     buildSSAFunctionBody();
-    setRegister(REG::R0_RETURN_VALUE, m_lastBlock->getArguments().front());
-    // m_registers.at(REG::R0_RETURN_VALUE) =
-    // m_lastBlock->getArguments().front();
   } else {
     buildMemFunctionBody();
   }
@@ -434,34 +679,100 @@ bool Deserialize::parseModelIsSuccessful() {
     std::variant<InstructionSeq, std::string> prog_or_error =
         unmarshal(raw_prog);
     if (std::holds_alternative<std::string>(prog_or_error)) {
-      std::cerr << "unmarshaling error at "
-                << std::get<std::string>(prog_or_error) << "\n";
+      llvm::errs() << "unmarshaling error at "
+                   << std::get<std::string>(prog_or_error) << "\n";
       continue;
     }
     auto &prog = std::get<InstructionSeq>(prog_or_error);
-    m_sections.push_back(prog);
-    print(prog, std::cerr, {});
-    // // Convert the instruction sequence to a control-flow graph.
-    // cfg_t cfg = prepare_cfg(prog, raw_prog.info,
-    // !ebpf_verifier_options.no_simplify); print_dot(cfg, std::cerr);
+    if (m_trace) {
+      print(prog, std::cerr, {});
+    }
+    m_sections.push_back(std::move(prog));
+    m_sectionNames.push_back(getFunctionName(raw_prog.section));
+    for (const EbpfMapDescriptor &map : raw_prog.info.map_descriptors) {
+      m_mapDescriptors[map.original_fd] = {
+          map.original_fd, map.type, map.key_size, map.value_size,
+          map.max_entries};
+    }
   }
   return !m_sections.empty();
 }
 
+std::string Deserialize::getFunctionName(const std::string &section) {
+  // section names such as "xdp/prog" are not valid C identifiers
+  std::string name = section.empty() ? "section" : section;
+  std::replace_if(
+      name.begin(), name.end(),
+      [](unsigned char c) { return !std::isalnum(c); }, '_');
+  if (std::isdigit(static_cast<unsigned char>(name.front()))) {
+    name.insert(name.begin(), '_');
+  }
+  // keep symbol names unique when sections share a name
+  auto base = name;
+  for (size_t i = 1; std::find(m_sectionNames.begin(), m_sectionNames.end(),
+                               name) != m_sectionNames.end();
+       ++i) {
+    name = base + "_" + std::to_string(i);
+  }
+  return name;
+}
+
+void Deserialize::buildModule(ModuleOp module) {
+  // build each section into its own function concurrently
+  std::vector<OwningOpRef<FuncOp>> functions(m_sections.size());
+  std::vector<std::pair<size_t, size_t>> sizes(m_sections.size());
+  parallelForEachN(m_context, 0, m_sections.size(), [&](size_t i) {
+    SectionBuilder builder(m_context, m_sections.at(i), m_sectionNames.at(i),
+                           m_ssa, m_trace);
+    functions[i] = builder.buildXDPFunction();
+    sizes[i] = {builder.getNumInstructions(), builder.getNumBlocks()};
+  });
+  // the size is reported unless the import is quiet, and always when traced
+  if (m_summary || m_trace) {
+    size_t instructions = 0, blocks = 0;
+    for (size_t i = 0; i < m_sections.size(); ++i) {
+      llvm::errs() << "ebpf-import: section " << m_sectionNames[i] << ": "
+                   << sizes[i].first << " instructions, " << sizes[i].second
+                   << " blocks\n";
+      instructions += sizes[i].first;
+      blocks += sizes[i].second;
+    }
+    llvm::errs() << "ebpf-import: " << m_sections.size() << " sections, "
+                 << instructions << " instructions, " << blocks
+                 << " blocks, " << m_mapDescriptors.size() << " maps\n";
+  }
+  // merge the functions into the module in section order
+  for (auto &function : functions) {
+    if (!function)
+      continue;
+    module.getBody()->push_back(function.release());
+  }
+  // record the maps so that they can be created when the module runs
+  if (!m_mapDescriptors.empty()) {
+    std::vector<int64_t> maps;
+    for (const auto &[fd, descriptor] : m_mapDescriptors) {
+      maps.insert(maps.end(), descriptor.begin(), descriptor.end());
+    }
+    auto type = RankedTensorType::get(
+        {static_cast<int64_t>(m_mapDescriptors.size()), MapDescriptorFields},
+        IntegerType::get(m_context, 64));
+    module->setAttr(MapsAttrName,
+                    DenseElementsAttr::get(type, llvm::makeArrayRef(maps)));
+  }
+}
+
 static OwningOpRef<ModuleOp> deserializeModule(const llvm::MemoryBuffer *input,
-                                               MLIRContext *context, bool ssa) {
+                                               MLIRContext *context, bool ssa,
+                                               const ImportOptions &options) {
   context->loadDialect<ebpf::ebpfDialect, StandardOpsDialect>();
 
   OwningOpRef<ModuleOp> owningModule(ModuleOp::create(FileLineColLoc::get(
       context, input->getBufferIdentifier(), /*line=*/0, /*column=*/0)));
 
-  Deserialize deserialize(context, input->getBufferIdentifier().str(), ssa);
+  Deserialize deserialize(context, input->getBufferIdentifier().str(), ssa,
+                          options);
   if (deserialize.parseModelIsSuccessful()) {
-    OwningOpRef<FuncOp> XDPFunc = deserialize.buildXDPFunction();
-    if (!XDPFunc)
-      return owningModule;
-
-    owningModule->getBody()->push_back(XDPFunc.release());
+    deserialize.buildModule(owningModule.get());
   }
 
   return owningModule;
@@ -469,25 +780,27 @@ static OwningOpRef<ModuleOp> deserializeModule(const llvm::MemoryBuffer *input,
 
 namespace mlir {
 namespace ebpf {
-void registerebpfTranslation() {
+void registerebpfTranslation(const ImportOptions &options) {
   TranslateToMLIRRegistration fromEBPF(
-      "import-ebpf", [](llvm::SourceMgr &sourceMgr, MLIRContext *context) {
+      "import-ebpf",
+      [&options](llvm::SourceMgr &sourceMgr, MLIRContext *context) {
         // get section name
         assert(sourceMgr.getNumBuffers() == 1 && "expected one buffer");
         return deserializeModule(
             sourceMgr.getMemoryBuffer(sourceMgr.getMainFileID()), context,
-            true);
+            true, options);
       });
 }
 
-void registerebpfMemTranslation() {
+void registerebpfMemTranslation(const ImportOptions &options) {
   TranslateToMLIRRegistration fromEBPF(
-      "import-ebpf-mem", [](llvm::SourceMgr &sourceMgr, MLIRContext *context) {
+      "import-ebpf-mem",
+      [&options](llvm::SourceMgr &sourceMgr, MLIRContext *context) {
         // get section name
         assert(sourceMgr.getNumBuffers() == 1 && "expected one buffer");
         return deserializeModule(
             sourceMgr.getMemoryBuffer(sourceMgr.getMainFileID()), context,
-            false);
+            false, options);
       });
 }
 } // namespace ebpf
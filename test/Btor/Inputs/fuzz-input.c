@@ -0,0 +1,20 @@
+// Runs a libfuzz target on one input file, as libFuzzer runs a crash input
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+int LLVMFuzzerInitialize(int *argc, char ***argv);
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+int main(int argc, char **argv) {
+  static uint8_t data[1 << 16];
+  FILE *file = argc == 2 ? fopen(argv[1], "rb") : NULL;
+  if (!file) {
+    fprintf(stderr, "usage: %s <input>\n", argv[0]);
+    return 1;
+  }
+  const size_t size = fread(data, 1, sizeof(data), file);
+  fclose(file);
+  LLVMFuzzerInitialize(&argc, &argv);
+  return LLVMFuzzerTestOneInput(data, size);
+}
@@ -0,0 +1,7 @@
+// Runs a lowered model once, with the values and the trace of libcex
+extern "C" void _main(void);
+
+int main() {
+  _main();
+  return 0;
+}
@@ -0,0 +1,86 @@
+// RUN: btor2mlir-translate --import-btor %S/explore-unsafe.btor2 > %t.mlir
+// RUN: btor2mlir-opt %t.mlir --convert-btornd-to-llvm --convert-btor-to-vector --convert-arith-to-llvm --convert-std-to-llvm --convert-btor-to-llvm --convert-vector-to-llvm > %t.opt.mlir
+// RUN: btor2mlir-translate --mlir-to-llvmir %t.opt.mlir > %t.ll
+// RUN: llc -relocation-model=pic -filetype=obj %t.ll -o %t.o
+// RUN: %host_cxx %t.o %S/Inputs/run-model.cpp %cex_libs -lcex -lpthread -o %t.run
+// RUN: %host_cxx %t.o %cex_libs -lcexreplay -lcex -lpthread -o %t.replay
+// RUN: %host_cxx %t.o %cex_libs -lcexfork -lcex -lpthread -o %t.fork
+// RUN: %host_cc %t.o %S/Inputs/fuzz-input.c %fuzz_libs -lfuzz -o %t.fuzz
+
+// The unsafe counter of explore-unsafe.btor2 reaches its bad after five
+// steps, whatever its input x on line 9, so every run of the model fails
+
+// RUN: not %t.run --seed=1 > %t.txt
+// RUN: FileCheck %s --check-prefixes=TRACE,ERROR < %t.txt
+// RUN: btor2mlir-witness %t.txt -o %t.wit
+// RUN: FileCheck %s --check-prefix=WITNESS < %t.wit
+// RUN: %t.replay %t.wit 2>&1 | FileCheck %s --check-prefix=REPLAY
+
+// THREAD: thread, 2
+// TRACE-COUNT-6: input, 9, {{[01]}}, 1
+// TRACE-NOT: input
+// TRACE: [sea] __VERIFIER_assert was called for property: 0
+// ERROR-NEXT: [sea] __VERIFIER_error was executed
+
+// WITNESS: sat
+// WITNESS-NEXT: b0
+// WITNESS-NEXT: #0
+// WITNESS-NEXT: @0
+// WITNESS-NEXT: 9 {{[01]}}
+// WITNESS: #5
+// WITNESS-NEXT: @5
+// WITNESS-NEXT: 9 {{[01]}}
+// WITNESS-NEXT: .
+
+// REPLAY: confirmed: b0 fails at frame 5
+// REPLAY: [cex] 1 of 1 witnesses confirmed
+
+// The binary trace of the same seed decodes to the same trace and witness
+// RUN: not %t.run --seed=1 --trace=%t.bin
+// RUN: cex-trace %t.bin | FileCheck %s --check-prefix=TRACE
+// RUN: btor2mlir-witness %t.bin -o %t.bin.wit
+// RUN: diff %t.wit %t.bin.wit
+
+// A thread draws the values of its index, which the trace names when it is
+// not the first index
+// RUN: not %t.run --seed=1 --thread=0 > %t.first.txt
+// RUN: diff %t.txt %t.first.txt
+// RUN: not %t.run --seed=1 --thread=2 --trace=%t.thread.bin
+// RUN: cex-trace %t.thread.bin | FileCheck %s --check-prefixes=THREAD,TRACE
+
+// A recording of the values replays the same run
+// RUN: not %t.run --record=%t.nd > %t.recorded.txt
+// RUN: not %t.run --replay=%t.nd > %t.replayed.txt
+// RUN: diff %t.recorded.txt %t.replayed.txt
+
+// A witness that claims too few frames is rejected
+// RUN: not %t.replay %S/Inputs/explore-unsafe-short.wit 2>&1 | FileCheck %s --check-prefix=REJECT
+// REJECT: rejected: no bad property after 2 frames
+// REJECT: [cex] 0 of 1 witnesses confirmed
+
+// The minimized witness keeps the five steps, but none of the set inputs
+// RUN: %t.replay --minimize %S/Inputs/explore-unsafe.wit %t.min.wit 2>&1 | FileCheck %s --check-prefix=MINIMIZE
+// RUN: FileCheck %s --check-prefix=MINIMAL < %t.min.wit
+// RUN: btor2mlir-witness %t.txt --minimize --simulator=%t.replay -o %t.min.trace.wit
+// RUN: diff %t.min.wit %t.min.trace.wit
+
+// MINIMIZE: 6 frames and 6 nonzero values, minimized to 6 frames and 0 nonzero values
+
+// MINIMAL: sat
+// MINIMAL-NEXT: b0
+// MINIMAL-COUNT-6: 9 0
+// MINIMAL-NOT: 9 1
+// MINIMAL: .
+
+// Without an AFL parent, the fork server runs the test in its input file: 24
+// bytes of zeros are the inputs of six steps, 8 bytes run out before the bad
+// RUN: %python -c "import sys; sys.stdout.buffer.write(bytes(24))" > %t.fail
+// RUN: %python -c "import sys; sys.stdout.buffer.write(bytes(8))" > %t.pass
+// RUN: not --crash %t.fork %t.fail
+// RUN: %t.fork %t.pass
+
+// The fuzz target aborts on the same input, and its trace is a witness
+// RUN: env FUZZ_TRACE=1 not --crash %t.fuzz %t.fail > %t.fuzz.txt
+// RUN: FileCheck %s --check-prefixes=TRACE,ERROR < %t.fuzz.txt
+// RUN: btor2mlir-witness %t.fuzz.txt -o - | FileCheck %s --check-prefix=MINIMAL
+// RUN: %t.fuzz %t.pass
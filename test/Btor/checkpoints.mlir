@@ -0,0 +1,13 @@
+// RUN: btor2mlir-translate --import-btor %S/checkpoints.btor2 | btor2mlir-opt --convert-btornd-to-llvm="checkpoints=1" | FileCheck %s
+
+// The state on line 3 of checkpoints.btor2 is recorded and resumed by its id
+
+// CHECK-LABEL: @_main
+// CHECK: %[[RESUMABLE:.*]] = llvm.mlir.constant(true) : i1
+// CHECK: llvm.call @btor2mlir_resume(%[[RESUMABLE]])
+// CHECK: %[[RESUME_ID:.*]] = llvm.mlir.constant(3 : i64) : i64
+// CHECK: llvm.call @btor2mlir_resume_state(%[[RESUME_ID]])
+// CHECK: llvm.call @btor2mlir_checkpoint_due()
+// CHECK: %[[ID:.*]] = llvm.mlir.constant(3 : i64) : i64
+// CHECK: %[[WIDTH:.*]] = llvm.mlir.constant(4 : i64) : i64
+// CHECK: llvm.call @btor2mlir_print_checkpoint_num(%[[ID]], %{{.*}}, %[[WIDTH]])
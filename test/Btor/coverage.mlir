@@ -0,0 +1,13 @@
+// RUN: btor2mlir-translate --import-btor %S/coverage.btor2 > %t.mlir
+// RUN: btor2mlir-opt %t.mlir --convert-btornd-to-llvm --convert-btor-to-vector --convert-arith-to-llvm --convert-std-to-llvm --convert-btor-to-llvm="coverage=1" --convert-vector-to-llvm > %t.opt.mlir
+// RUN: btor2mlir-translate --mlir-to-llvmir %t.opt.mlir | FileCheck %s
+
+// 4 counters for the bits of the state, and 2 for each of the ite, the bad
+// and the constraint
+
+// CHECK: @btor2mlir_coverage = global [10 x i8] zeroinitializer
+// CHECK: @btor2mlir_coverage_size = constant i64 10
+// CHECK-LABEL: define void @_main()
+// CHECK: load i8, i8*
+// CHECK: add i8
+// CHECK: store i8
@@ -0,0 +1,45 @@
+// RUN: btor2mlir-explore %S/explore-safe.btor2 | FileCheck %s --check-prefix=SAFE
+// RUN: btor2mlir-explore --jobs=4 %S/explore-safe.btor2 | FileCheck %s --check-prefix=SAFE
+// RUN: btor2mlir-explore --storage=collapse %S/explore-safe.btor2 | FileCheck %s --check-prefix=SAFE
+// RUN: btor2mlir-explore --jobs=4 --storage=bitstate --bitstate-bits=16 %S/explore-safe.btor2 | FileCheck %s --check-prefix=APPROX
+
+// RUN: btor2mlir-explore %S/explore-unsafe.btor2 -o %t.wit | FileCheck %s --check-prefix=UNSAFE
+// RUN: FileCheck %s --check-prefix=WITNESS < %t.wit
+// RUN: btor2mlir-explore --jobs=4 %S/explore-unsafe.btor2 | FileCheck %s --check-prefix=UNSAFE
+// RUN: btor2mlir-explore --jobs=4 --storage=bitstate --bitstate-bits=16 %S/explore-unsafe.btor2 | FileCheck %s --check-prefix=UNSAFE
+// RUN: btor2mlir-explore --storage=hash-compact %S/explore-unsafe.btor2 | FileCheck %s --check-prefix=UNSAFE
+// RUN: btor2mlir-explore --walks=8 --jobs=4 %S/explore-unsafe.btor2 -o %t.walk.wit | FileCheck %s --check-prefix=WALKS
+// RUN: FileCheck %s --check-prefix=WITNESS < %t.walk.wit
+
+// The safe counter wraps at 9 when enabled, so the search visits its ten
+// states and proves that it never reaches 12
+// SAFE: bad 0: unreachable
+// SAFE-NEXT: states: 10
+// SAFE: depth: 9 (exhausted)
+// SAFE-NOT: search incomplete
+
+// A lossy store of the visited states finds the same states, but cannot
+// prove the bad unreachable
+// APPROX: bad 0: not reached
+// APPROX-NEXT: states: 10
+// APPROX: depth: 9 (exhausted)
+// APPROX-NEXT: search incomplete: visited states approximated;
+
+// The unsafe counter counts every step, so every search and every walk
+// reaches 5 after five steps, whatever its input
+// UNSAFE: bad 0: reachable at depth 5
+// UNSAFE: depth: 5
+// UNSAFE-NOT: search incomplete
+
+// WALKS: bad 0: reachable at depth 5 (walk {{[0-9]+}}, bias {{-?[0-9]+}}, depth limit {{[0-9]+}})
+// WALKS-NEXT: walks: {{[1-8]}} ({{[1-8]}} reached a bad)
+
+// WITNESS: sat
+// WITNESS-NEXT: b0
+// WITNESS-NEXT: #0
+// WITNESS-NEXT: @0
+// WITNESS-NEXT: 0 {{[01]}}
+// WITNESS: #5
+// WITNESS-NEXT: @5
+// WITNESS-NEXT: 0 {{[01]}}
+// WITNESS-NEXT: .
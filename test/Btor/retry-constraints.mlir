@@ -0,0 +1,12 @@
+// RUN: btor2mlir-translate --import-btor %S/coverage.btor2 > %t.mlir
+// RUN: btor2mlir-opt %t.mlir --convert-btornd-to-llvm --convert-btor-to-vector --convert-arith-to-llvm --convert-std-to-llvm --convert-btor-to-llvm="retry-constraints=1" --convert-vector-to-llvm > %t.opt.mlir
+// RUN: btor2mlir-translate --mlir-to-llvmir %t.opt.mlir | FileCheck %s
+
+// The constraint of the step draws the input again, from the same state,
+// until btor2mlir_retry_step gives up
+
+// CHECK-LABEL: define void @_main()
+// CHECK: call void @btor2mlir_step_begin()
+// CHECK: %[[RETRY:.*]] = call i1 @btor2mlir_retry_step()
+// CHECK-NEXT: br i1 %[[RETRY]]
+// CHECK: call void @__SEA_assume(
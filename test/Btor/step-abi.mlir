@@ -0,0 +1,25 @@
+// RUN: btor2mlir-translate --import-btor --abi=step %S/coverage.btor2 | FileCheck %s
+// RUN: btor2mlir-translate --import-btor %S/coverage.btor2 | FileCheck %s --check-prefix=MAIN
+
+// The step abi outlines the model into functions over its states and inputs
+
+// CHECK-NOT: func @_main
+// CHECK-LABEL: func @btor_init_values
+// CHECK-SAME: (%{{.*}}: !btor.bv<4>) -> !btor.bv<4>
+// CHECK: btor.constant 0
+// CHECK: return
+
+// CHECK-LABEL: func @btor_step_values
+// CHECK-SAME: (%[[COUNT:.*]]: !btor.bv<4>, %[[ENABLE:.*]]: !btor.bv<1>) -> !btor.bv<4>
+// CHECK: %[[NEXT:.*]] = btor.add %[[COUNT]]
+// CHECK: btor.ite %[[ENABLE]], %[[NEXT]], %[[COUNT]]
+
+// CHECK-LABEL: func @btor_bad_values
+// CHECK-SAME: (%{{.*}}: !btor.bv<4>, %{{.*}}: !btor.bv<1>) -> !btor.bv<64>
+
+// CHECK-LABEL: func @btor_constraint_values
+// CHECK-SAME: (%{{.*}}: !btor.bv<4>, %[[ENABLE:.*]]: !btor.bv<1>) -> !btor.bv<1>
+// CHECK: btor.and %{{.*}}, %[[ENABLE]]
+
+// MAIN: func @_main
+// MAIN-NOT: func @btor_step_values
@@ -0,0 +1,28 @@
+// RUN: btor2mlir-translate --import-btor %S/wide-values.btor2 | btor2mlir-opt --convert-btornd-to-llvm | FileCheck %s
+// RUN: btor2mlir-witness %S/Inputs/wide-values.trace -o - | FileCheck %s --check-prefix=WITNESS
+// RUN: not btor2mlir-witness %S/Inputs/wide-values-truncated.trace -o - 2>&1 | FileCheck %s --check-prefix=TRUNCATED
+
+// Values wider than 64 bits are printed one 64 bit word at a time, and the
+// witness joins the words again
+
+// CHECK-DAG: llvm.func @btor2mlir_print_state_word(i64, i64, i64, i64)
+// CHECK-DAG: llvm.func @btor2mlir_print_input_word(i64, i64, i64, i64)
+// CHECK-NOT: @btor2mlir_print_state_num
+// CHECK-NOT: @btor2mlir_print_input_num
+// CHECK-LABEL: func @_main
+// CHECK-COUNT-2: llvm.call @btor2mlir_print_state_word
+// CHECK: llvm.lshr
+// CHECK-COUNT-2: llvm.call @btor2mlir_print_input_word
+
+// WITNESS: sat
+// WITNESS-NEXT: b0
+// WITNESS-NEXT: #0
+// WITNESS-NEXT: 3 00000000000000000000000000000000000000000000000000000000000000010000000000000000000000000000000000000000000000000000000000000000
+// WITNESS-NEXT: @0
+// WITNESS-NEXT: 2 11111111111111111111111111111111111111111111111111111111111111111111111111111111111111111111111111111111111111111111111111111111
+// WITNESS-NEXT: #1
+// WITNESS-NEXT: 3 11111111111111111111111111111111111111111111111111111111111111111111111111111111111111111111111111111111111111111111111111111111
+// WITNESS-NEXT: @1
+// WITNESS-NEXT: .
+
+// TRUNCATED: error: the trace ends within a value wider than 64 bits
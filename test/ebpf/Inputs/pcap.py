@@ -0,0 +1,12 @@
+# Writes a pcap file of zeroed ethernet frames for ebpf2mlir-run.
+#   pcap.py <output> <packets> [<bytes per packet>]
+import struct
+import sys
+
+path, count = sys.argv[1], int(sys.argv[2])
+size = int(sys.argv[3]) if len(sys.argv) > 3 else 64
+with open(path, 'wb') as pcap:
+    pcap.write(struct.pack('<IHHiIII', 0xa1b2c3d4, 2, 4, 0, 0, 65535, 1))
+    for i in range(count):
+        pcap.write(struct.pack('<IIII', i, 0, size, size))
+        pcap.write(bytes(size))
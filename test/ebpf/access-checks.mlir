@@ -0,0 +1,44 @@
+// RUN: llvm-mc -triple=bpf -filetype=obj %S/access-checks.s -o %t.o
+// RUN: ebpf2mlir-translate --import-ebpf %t.o | FileCheck %s
+// RUN: ebpf2mlir-translate --import-ebpf %t.o | ebpf2mlir-opt --convert-ebpf-to-btor | FileCheck %s --check-prefix=BTOR
+// RUN: ebpf2mlir-translate --import-ebpf %t.o | ebpf2mlir-opt --convert-ebpf-to-llvm | FileCheck %s --check-prefix=LLVM
+// RUN: ebpf2mlir-translate --import-ebpf %t.o -o /dev/null 2>&1 | FileCheck %s --check-prefix=SUMMARY
+
+// The load through the result of the map lookup is checked for null, and the
+// store below the stack frame always fails
+
+// CHECK-LABEL: func @xdp(
+// CHECK: %[[RESULT:.*]] = ebpf.call
+// CHECK: %[[NOT_NULL:.*]] = ebpf.cmp ne, %[[RESULT]], %{{.*}} : i64
+// CHECK-NEXT: ebpf.assertt(%[[NOT_NULL]]), i1
+// CHECK: ebpf.load %[[RESULT]],
+// CHECK: %[[IN_BOUNDS:.*]] = ebpf.constant false
+// CHECK-NEXT: ebpf.assertt(%[[IN_BOUNDS]]), i1
+// CHECK: ebpf.store
+
+// A null check clears the result only on the branch where it is not null,
+// so the load after the join is still checked
+// CHECK-LABEL: func @xdp_check(
+// CHECK: ebpf.call
+// CHECK: ebpf.cmp ne
+// CHECK-NEXT: ebpf.assertt
+// CHECK-NOT: ebpf.assertt
+
+// The result of the lookup reaches the join along one of its predecessors
+// CHECK-LABEL: func @xdp_merge(
+// CHECK: ebpf.call
+// CHECK: ebpf.cmp ne
+// CHECK-NEXT: ebpf.assertt
+// CHECK-NOT: ebpf.assertt
+
+// BTOR-COUNT-4: btor.assert_not
+// BTOR-NOT: btor.assert_not
+
+// LLVM: llvm.func @__VERIFIER_error()
+// LLVM-COUNT-4: llvm.call @__VERIFIER_error()
+// LLVM-NOT: llvm.call @__VERIFIER_error()
+
+// SUMMARY: ebpf-import: section xdp: {{[0-9]+}} instructions, {{[0-9]+}} blocks
+// SUMMARY: ebpf-import: section xdp_check: {{[0-9]+}} instructions, {{[0-9]+}} blocks
+// SUMMARY: ebpf-import: section xdp_merge: {{[0-9]+}} instructions, {{[0-9]+}} blocks
+// SUMMARY-NEXT: ebpf-import: 3 sections, {{[0-9]+}} instructions, {{[0-9]+}} blocks, 0 maps
@@ -0,0 +1,56 @@
+# reads through the unchecked result of a map lookup, then writes below
+# the 512 byte stack frame
+	.section	xdp,"ax",@progbits
+	.globl	prog
+	.type	prog,@function
+prog:
+	r1 = 0
+	*(u64 *)(r10 - 8) = r1
+	r2 = r10
+	r2 += -8
+	call 1
+	r1 = *(u64 *)(r0 + 0)
+	*(u64 *)(r10 - 520) = r1
+	r0 = 2
+	exit
+
+# the lookup result is only dereferenced unchecked where the branch that
+# tests it for null joins the code again
+	.section	xdp/check,"ax",@progbits
+	.globl	check
+	.type	check,@function
+check:
+	r1 = 0
+	*(u64 *)(r10 - 8) = r1
+	r2 = r10
+	r2 += -8
+	call 1
+	r7 = r0
+	if r7 == 0 goto LBB1_2
+	r1 = *(u64 *)(r7 + 0)
+LBB1_2:
+	r1 = *(u64 *)(r7 + 8)
+	r0 = 2
+	exit
+
+# the lookup result reaches the join only through the block laid out first
+	.section	xdp/merge,"ax",@progbits
+	.globl	merge
+	.type	merge,@function
+merge:
+	r6 = r1
+	r1 = 0
+	*(u64 *)(r10 - 8) = r1
+	if r6 == 0 goto LBB2_2
+	r2 = r10
+	r2 += -8
+	call 1
+	goto LBB2_3
+LBB2_2:
+	r0 = r10
+	r0 += -16
+	*(u64 *)(r0 + 0) = r6
+LBB2_3:
+	r1 = *(u64 *)(r0 + 0)
+	r0 = 2
+	exit
@@ -0,0 +1,92 @@
+// RUN: ebpf2mlir-opt %s --canonicalize | FileCheck %s
+
+// CHECK-LABEL: func @identities
+// CHECK-SAME: (%[[X:.*]]: i64)
+// CHECK-NEXT: return %[[X]] : i64
+func @identities(%x: i64) -> i64 {
+  %zero = ebpf.constant 0 : i64 i64
+  %one = ebpf.constant 1 : i64 i64
+  %a = ebpf.add %x, %zero : i64
+  %b = ebpf.mul %a, %one : i64
+  %c = ebpf.udiv %b, %one : i64
+  return %c : i64
+}
+
+// CHECK-LABEL: func @constants
+// CHECK-DAG: %[[ZERO:.*]] = ebpf.constant 0 : i64 i64
+// CHECK-DAG: %[[TWELVE:.*]] = ebpf.constant 12 : i64 i64
+// CHECK: return %[[TWELVE]], %[[ZERO]], %[[ZERO]] : i64, i64, i64
+func @constants(%x: i64) -> (i64, i64, i64) {
+  %zero = ebpf.constant 0 : i64 i64
+  %three = ebpf.constant 3 : i64 i64
+  %four = ebpf.constant 4 : i64 i64
+  %a = ebpf.mul %three, %four : i64
+  // division by zero is zero in ebpf
+  %b = ebpf.udiv %three, %zero : i64
+  %c = ebpf.xor %x, %x : i64
+  return %a, %b, %c : i64, i64, i64
+}
+
+// CHECK-LABEL: func @byte_order
+// CHECK: %[[SWAPPED:.*]] = ebpf.constant 13330 : i64 i64
+// CHECK-NEXT: return %[[SWAPPED]] : i64
+func @byte_order() -> i64 {
+  %value = ebpf.constant 4660 : i64 i64
+  %a = ebpf.swap16 %value : i64
+  return %a : i64
+}
+
+// CHECK-LABEL: func @masks
+// CHECK-SAME: (%[[X:.*]]: i64, %[[Y:.*]]: i64)
+// CHECK: %[[MASK:.*]] = ebpf.constant 15 : i64 i64
+// CHECK: %[[AND:.*]] = ebpf.and %[[X]], %[[MASK]] : i64
+// CHECK: %[[BYTE:.*]] = ebpf.load8 %[[Y]]
+// CHECK-NOT: ebpf.and
+// CHECK: return %[[AND]], %[[BYTE]] : i64, i64
+func @masks(%x: i64, %y: i64) -> (i64, i64) {
+  %zero = ebpf.constant 0 : i64 i64
+  %low = ebpf.constant 255 : i64 i64
+  %nibble = ebpf.constant 15 : i64 i64
+  %a = ebpf.and %x, %low : i64
+  %b = ebpf.and %a, %nibble : i64
+  %byte = ebpf.load8 %y, %zero : i64
+  %c = ebpf.and %byte, %low : i64
+  return %b, %c : i64, i64
+}
+
+// The load of a register slot folds to the value last stored to it
+// CHECK-LABEL: func @register_slots
+// CHECK-SAME: (%[[X:.*]]: i64)
+// CHECK: %[[SEVEN:.*]] = ebpf.constant 7 : i64 i64
+// CHECK: ebpf.store %{{.*}}, %{{.*}}, %[[X]] : i64
+// CHECK: ebpf.store %{{.*}}, %{{.*}}, %[[SEVEN]] : i64
+// CHECK-NOT: ebpf.load
+// CHECK: return %[[SEVEN]] : i64
+func @register_slots(%x: i64) -> i64 {
+  %zero = ebpf.constant 0 : i64 i64
+  %seven = ebpf.constant 7 : i64 i64
+  %slot = ebpf.alloca : i64
+  ebpf.store %slot, %zero, %x : i64
+  ebpf.store %slot, %zero, %seven : i64
+  %a = ebpf.load %slot, %zero : i64
+  return %a : i64
+}
+
+// Slots whose address escapes, or that are stored to at another offset, are
+// loaded from memory
+// CHECK-LABEL: func @escaping_slots
+// CHECK: ebpf.load
+// CHECK: ebpf.load
+// CHECK: return
+func @escaping_slots(%x: i64) -> (i64, i64, i64) {
+  %zero = ebpf.constant 0 : i64 i64
+  %eight = ebpf.constant 8 : i64 i64
+  %slot = ebpf.alloca : i64
+  ebpf.store %slot, %zero, %x : i64
+  %other = ebpf.add %slot, %eight : i64
+  %a = ebpf.load %slot, %zero : i64
+  %wide = ebpf.alloca : i64
+  ebpf.store %wide, %eight, %x : i64
+  %b = ebpf.load %wide, %zero : i64
+  return %a, %b, %other : i64, i64, i64
+}
@@ -0,0 +1,59 @@
+// RUN: ebpf2mlir-opt %s --ebpf-promote-registers | FileCheck %s
+// RUN: llvm-mc -triple=bpf -filetype=obj %S/access-checks.s -o %t.o
+// RUN: ebpf2mlir-translate --import-ebpf-mem %t.o | ebpf2mlir-opt --ebpf-promote-registers | FileCheck %s --check-prefix=IMPORT
+
+// The register slots become values carried by block arguments, while the
+// stack behind the pointer argument is still accessed through memory
+
+// CHECK-LABEL: func @branches
+// CHECK-SAME: (%[[X:.*]]: i64, %[[STACK:.*]]: i64)
+// CHECK-NOT: ebpf.alloca
+// CHECK: %[[COND:.*]] = ebpf.cmp eq, %[[X]], %{{.*}} : i64
+// CHECK: cond_br %[[COND]], ^[[THEN:.*]], ^[[JOIN:.*]](%[[X]] : i64)
+// CHECK: ^[[THEN]]:
+// CHECK: %[[SUM:.*]] = ebpf.add %[[X]], %{{.*}} : i64
+// CHECK: br ^[[JOIN]](%[[SUM]] : i64)
+// CHECK: ^[[JOIN]](%[[R0:.*]]: i64):
+// CHECK: ebpf.store %[[STACK]], %{{.*}}, %[[R0]] : i64
+// CHECK: return %[[R0]] : i64
+func @branches(%x: i64, %stack: i64) -> i64 {
+  %zero = ebpf.constant 0 : i64 i64
+  %one = ebpf.constant 1 : i64 i64
+  %minus8 = ebpf.constant -8 : i64 i64
+  %r0 = ebpf.alloca : i64
+  %r10 = ebpf.alloca : i64
+  ebpf.store %r0, %zero, %x : i64
+  ebpf.store %r10, %zero, %stack : i64
+  %a = ebpf.load %r0, %zero : i64
+  %cond = ebpf.cmp eq, %a, %zero : i64
+  cond_br %cond, ^then, ^join
+^then:
+  %b = ebpf.load %r0, %zero : i64
+  %c = ebpf.add %b, %one : i64
+  ebpf.store %r0, %zero, %c : i64
+  br ^join
+^join:
+  %fp = ebpf.load %r10, %zero : i64
+  %d = ebpf.load %r0, %zero : i64
+  ebpf.store %fp, %minus8, %d : i64
+  %e = ebpf.load %r0, %zero : i64
+  return %e : i64
+}
+
+// A slot accessed at another offset is memory, and is left alone
+// CHECK-LABEL: func @not_a_register
+// CHECK: ebpf.alloca
+// CHECK: ebpf.store
+// CHECK: ebpf.load
+func @not_a_register(%x: i64) -> i64 {
+  %eight = ebpf.constant 8 : i64 i64
+  %slot = ebpf.alloca : i64
+  ebpf.store %slot, %eight, %x : i64
+  %a = ebpf.load %slot, %eight : i64
+  return %a : i64
+}
+
+// IMPORT-LABEL: func @xdp
+// IMPORT-NOT: ebpf.alloca
+// IMPORT: ebpf.call
+// IMPORT: return
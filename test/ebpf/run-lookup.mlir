@@ -0,0 +1,12 @@
+// RUN: llvm-mc -triple=bpf -filetype=obj %S/run-lookup.s -o %t.o
+// RUN: %python %S/Inputs/pcap.py %t.pcap 3
+// RUN: ebpf2mlir-translate --import-ebpf %t.o -o %t.mlir
+// RUN: ebpf2mlir-run %t.mlir --pcap=%t.pcap | FileCheck %s
+
+// The loads through the lookup result are checked for null, so the program
+// links against the assertion handler of the native runtime. The counter
+// persists between packets.
+
+// CHECK: packets: 3
+// CHECK: XDP_DROP: 1
+// CHECK: XDP_PASS: 2
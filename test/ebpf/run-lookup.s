@@ -0,0 +1,37 @@
+# counts the packets in an array map through the unchecked result of a
+# lookup, and drops every packet after the second
+	.section	xdp,"ax",@progbits
+	.globl	count
+	.type	count,@function
+count:
+	r1 = 0
+	*(u32 *)(r10 - 4) = r1
+	r1 = counters ll
+	r2 = r10
+	r2 += -4
+	call 1
+	r1 = *(u64 *)(r0 + 0)
+	r1 += 1
+	*(u64 *)(r0 + 0) = r1
+	if r1 > 2 goto LBB0_2
+	r0 = 2
+	goto LBB0_3
+LBB0_2:
+	r0 = 1
+LBB0_3:
+	exit
+
+# struct bpf_load_map_def: type, key size, value size, max entries, flags,
+# inner map index and numa node
+	.section	maps,"aw",@progbits
+	.globl	counters
+	.type	counters,@object
+counters:
+	.long	2
+	.long	4
+	.long	8
+	.long	1
+	.long	0
+	.long	0
+	.long	0
+	.size	counters, 28
@@ -0,0 +1,12 @@
+// RUN: llvm-mc -triple=bpf -filetype=obj %S/run-maps.s -o %t.o
+// RUN: %python %S/Inputs/pcap.py %t.pcap 2
+// RUN: ebpf2mlir-translate --import-ebpf %t.o -o %t.mlir
+// RUN: ebpf2mlir-run %t.mlir --pcap=%t.pcap | FileCheck %s
+
+// Lookup, update and delete on a hash map of two entries and an array of
+// four, including a missing key, a full map and an index past the end. A
+// failed check drops the packet, so every packet passes.
+
+// CHECK: packets: 2
+// CHECK-NOT: XDP_DROP
+// CHECK: XDP_PASS: 2
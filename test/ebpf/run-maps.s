@@ -0,0 +1,150 @@
+# exercises the native hash and array maps, and passes the packet only when
+# every helper behaves as in the kernel
+	.section	xdp,"ax",@progbits
+	.globl	exercise
+	.type	exercise,@function
+exercise:
+	# the maps persist between packets, so start from an empty hash map
+	r6 = 1
+	*(u32 *)(r10 - 4) = r6
+	r1 = table ll
+	r2 = r10
+	r2 += -4
+	call 3
+	r6 = 2
+	*(u32 *)(r10 - 4) = r6
+	r1 = table ll
+	r2 = r10
+	r2 += -4
+	call 3
+	# a missing key is not found
+	r1 = table ll
+	r2 = r10
+	r2 += -4
+	call 1
+	if r0 != 0 goto fail
+	# fill the map with keys 2 and 1
+	r6 = 20
+	*(u64 *)(r10 - 16) = r6
+	r1 = table ll
+	r2 = r10
+	r2 += -4
+	r3 = r10
+	r3 += -16
+	r4 = 0
+	call 2
+	if r0 != 0 goto fail
+	r6 = 1
+	*(u32 *)(r10 - 4) = r6
+	r6 = 10
+	*(u64 *)(r10 - 16) = r6
+	r1 = table ll
+	r2 = r10
+	r2 += -4
+	r3 = r10
+	r3 += -16
+	r4 = 0
+	call 2
+	if r0 != 0 goto fail
+	# a new key does not fit in the full map
+	r6 = 3
+	*(u32 *)(r10 - 4) = r6
+	r1 = table ll
+	r2 = r10
+	r2 += -4
+	r3 = r10
+	r3 += -16
+	r4 = 1
+	call 2
+	if r0 == 0 goto fail
+	# key 1 holds its value
+	r6 = 1
+	*(u32 *)(r10 - 4) = r6
+	r1 = table ll
+	r2 = r10
+	r2 += -4
+	call 1
+	if r0 == 0 goto fail
+	r1 = *(u64 *)(r0 + 0)
+	if r1 != 10 goto fail
+	# key 1 is deleted once, and is then missing
+	r1 = table ll
+	r2 = r10
+	r2 += -4
+	call 3
+	if r0 != 0 goto fail
+	r1 = table ll
+	r2 = r10
+	r2 += -4
+	call 3
+	if r0 == 0 goto fail
+	r1 = table ll
+	r2 = r10
+	r2 += -4
+	call 1
+	if r0 != 0 goto fail
+	# index 1 of the array holds what was stored to it
+	r6 = 7
+	*(u64 *)(r10 - 16) = r6
+	r1 = array ll
+	r2 = r10
+	r2 += -4
+	r3 = r10
+	r3 += -16
+	r4 = 0
+	call 2
+	if r0 != 0 goto fail
+	r1 = array ll
+	r2 = r10
+	r2 += -4
+	call 1
+	if r0 == 0 goto fail
+	r1 = *(u64 *)(r0 + 0)
+	if r1 != 7 goto fail
+	# the elements of an array cannot be deleted
+	r1 = array ll
+	r2 = r10
+	r2 += -4
+	call 3
+	if r0 == 0 goto fail
+	# an index past the end is missing
+	r6 = 4
+	*(u32 *)(r10 - 4) = r6
+	r1 = array ll
+	r2 = r10
+	r2 += -4
+	call 1
+	if r0 != 0 goto fail
+	r0 = 2
+	goto done
+fail:
+	r0 = 1
+done:
+	exit
+
+# struct bpf_load_map_def: type, key size, value size, max entries, flags,
+# inner map index and numa node
+	.section	maps,"aw",@progbits
+	.globl	table
+	.type	table,@object
+table:
+	.long	1
+	.long	4
+	.long	8
+	.long	2
+	.long	0
+	.long	0
+	.long	0
+	.size	table, 28
+
+	.globl	array
+	.type	array,@object
+array:
+	.long	2
+	.long	4
+	.long	8
+	.long	4
+	.long	0
+	.long	0
+	.long	0
+	.size	array, 28
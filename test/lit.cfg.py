@@ -52,10 +52,25 @@ config.btor2mlir_tools_dir = os.path.join(config.btor2mlir_obj_root, 'bin')
 # Tweak the PATH to include the tools dir.
 llvm_config.with_environment('PATH', config.llvm_tools_dir, append_path=True)
 
-tool_dirs = [config.btor2mlir_tools_dir, config.llvm_tools_dir]
+# The runtime libraries that a lowered model is linked with
+cex_dir = os.path.join(config.btor2mlir_obj_root, 'utils', 'cex')
+fuzz_dir = os.path.join(config.btor2mlir_obj_root, 'utils', 'fuzz')
+config.substitutions.append(('%host_cxx', config.host_cxx))
+config.substitutions.append(('%host_cc', config.host_cc))
+config.substitutions.append(('%cex_libs', '-L' + cex_dir))
+config.substitutions.append(('%fuzz_libs', '-L' + fuzz_dir))
+
+tool_dirs = [config.btor2mlir_tools_dir, cex_dir, config.llvm_tools_dir]
 tools = [
+    'cex-trace',
+    'llc',
+    'btor2mlir-explore',
     'btor2mlir-opt',
-    'btor2mlir-translate'
+    'btor2mlir-translate',
+    'btor2mlir-witness',
+    'ebpf2mlir-opt',
+    'ebpf2mlir-run',
+    'ebpf2mlir-translate'
 ]
 
 llvm_config.add_tool_substitutions(tools, tool_dirs)
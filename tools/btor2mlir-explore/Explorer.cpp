@@ -0,0 +1,361 @@
+//===- Explorer.cpp - Explicit-state search over compiled models ----------===//
+//
+// This file is licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "Explorer.h"
+
+#include "llvm/Support/Format.h"
+
+#include <cstring>
+
+using namespace llvm;
+using namespace explore;
+
+Explorer::Explorer(const Model &model, const Options &options)
+    : m_model(model), m_options(options) {
+  model.getChoices(m_initChoices, m_inputChoices, m_stepChoices);
+  m_initChoices.finalize(options.enumerateBits, options.samples);
+  m_inputChoices.finalize(options.enumerateBits, options.samples);
+  m_stepChoices.finalize(options.enumerateBits, options.samples);
+  m_numBads = std::min(model.getNumBads(), 64u);
+  m_counterexamples.resize(m_numBads);
+}
+
+Explorer::~Explorer() = default;
+
+void Explorer::setCounterexample(unsigned bad, uint64_t state,
+                                 const uint64_t *inputs, unsigned depth) {
+  Counterexample &cex = m_counterexamples[bad];
+  cex.state = state;
+  cex.inputs.assign(inputs, inputs + m_model.getInputWords());
+  cex.depth = depth;
+  m_reached.push_back(bad);
+}
+
+bool Explorer::isComplete() const {
+  return m_exhausted && !m_truncated && !m_approximate &&
+         m_initChoices.isExhaustive() && m_inputChoices.isExhaustive() &&
+         m_stepChoices.isExhaustive();
+}
+
+void Explorer::report(raw_ostream &os) const {
+  for (unsigned bad = 0; bad < m_numBads; ++bad) {
+    os << "bad " << bad;
+    if (bad == 63 && m_model.getNumBads() > 64) {
+      os << " to " << m_model.getNumBads() - 1;
+    }
+    const Counterexample &cex = m_counterexamples[bad];
+    if (cex.state != noParent) {
+      os << ": reachable at depth " << cex.depth << '\n';
+    } else if (isComplete()) {
+      os << ": unreachable\n";
+    } else {
+      os << ": not reached\n";
+    }
+  }
+  os << "states: " << getNumStates() << '\n';
+  os << "memory: " << format("%.1f", getMemoryUsage() / 1048576.0)
+     << " MiB\n";
+  os << "depth: " << m_depth << (m_exhausted ? " (exhausted)" : "") << '\n';
+  if (allReached() || isComplete()) {
+    return;
+  }
+  os << "search incomplete:";
+  if (m_truncated) {
+    os << " state bound reached;";
+  } else if (!m_exhausted) {
+    os << " depth bound reached;";
+  }
+  if (!m_initChoices.isExhaustive() || !m_inputChoices.isExhaustive() ||
+      !m_stepChoices.isExhaustive()) {
+    os << " values sampled;";
+  }
+  if (m_approximate) {
+    os << " visited states approximated;";
+  }
+  os << '\n';
+}
+
+namespace {
+void writeBinary(raw_ostream &os, const uint64_t *words, unsigned offset,
+                 unsigned width) {
+  for (unsigned bit = width; bit-- > 0;) {
+    os << (readBits(words, offset + bit, 1) ? '1' : '0');
+  }
+}
+
+void writeBinary(raw_ostream &os, uint64_t value, unsigned width) {
+  writeBinary(os, &value, 0, width);
+}
+
+/// Writes the states that the witness has to give at a frame: at the first
+/// frame those without an init, later those without an init or a next
+void writeFrameStates(raw_ostream &os, const Model &model,
+                      const uint64_t *state, bool initial) {
+  for (unsigned i = 0; i < model.getStates().size(); ++i) {
+    const Field &field = model.getStates()[i];
+    if (model.hasInit(i) || (!initial && model.hasNext(i))) {
+      continue;
+    }
+    if (!field.isArray()) {
+      os << i << ' ';
+      writeBinary(os, state, field.offset, field.width);
+      os << '\n';
+      continue;
+    }
+    for (uint64_t element = 0; element < field.numElements(); ++element) {
+      os << i << " [";
+      writeBinary(os, element, field.indexWidth);
+      os << "] ";
+      writeBinary(os, state, field.offset + element * field.stride,
+                  field.width);
+      os << '\n';
+    }
+  }
+}
+} // namespace
+
+void explore::writeWitness(raw_ostream &os, const Model &model, unsigned bad,
+                           size_t frames, const uint64_t *states,
+                           const uint64_t *inputs) {
+  const unsigned stateWords = model.getStateWords();
+  const unsigned inputWords = model.getInputWords();
+  os << "sat\nb" << bad << '\n';
+  for (size_t frame = 0; frame < frames; ++frame) {
+    os << '#' << frame << '\n';
+    writeFrameStates(os, model, states + frame * stateWords, frame == 0);
+    os << '@' << frame << '\n';
+    for (unsigned i = 0; i < model.getInputs().size(); ++i) {
+      const Field &field = model.getInputs()[i];
+      os << i << ' ';
+      writeBinary(os, inputs + frame * inputWords, field.offset, field.width);
+      os << '\n';
+    }
+  }
+  os << ".\n";
+}
+
+bool Explorer::writeWitness(raw_ostream &os) const {
+  if (m_reached.empty()) {
+    return false;
+  }
+  const unsigned bad = m_reached.front();
+  const Counterexample &cex = m_counterexamples[bad];
+  std::vector<uint64_t> path;
+  for (uint64_t number = cex.state; number != noParent;
+       number = getParent(number)) {
+    path.push_back(number);
+  }
+  std::reverse(path.begin(), path.end());
+
+  const unsigned stateWords = m_model.getStateWords();
+  const unsigned inputWords = m_model.getInputWords();
+  std::vector<uint64_t> states(path.size() * stateWords);
+  std::vector<uint64_t> inputs(path.size() * inputWords);
+  for (size_t frame = 0; frame < path.size(); ++frame) {
+    getState(path[frame], states.data() + frame * stateWords);
+    if (frame + 1 < path.size()) {
+      getParentInputs(path[frame + 1], inputs.data() + frame * inputWords);
+    }
+  }
+  std::copy(cex.inputs.begin(), cex.inputs.end(),
+            inputs.end() - inputWords);
+  explore::writeWitness(os, m_model, bad, path.size(), states.data(),
+                        inputs.data());
+  return true;
+}
+
+namespace {
+
+/// Packed states, numbered in order of insertion, with an open addressing
+/// table over their numbers
+class StateSet {
+public:
+  explicit StateSet(unsigned words) : m_words(words), m_slots(1024, 0) {}
+
+  uint64_t size() const { return m_hashes.size(); }
+
+  uint64_t getMemoryUsage() const {
+    return (m_arena.capacity() + m_hashes.capacity() + m_slots.capacity()) *
+           sizeof(uint64_t);
+  }
+
+  const uint64_t *get(uint64_t number) const {
+    return m_arena.data() + number * m_words;
+  }
+
+  /// @return the number of state, and true if it was not in the set
+  std::pair<uint64_t, bool> insert(const uint64_t *state) {
+    if (2 * (size() + 1) > m_slots.size()) {
+      grow();
+    }
+    const uint64_t hash = hashState(state, m_words);
+    const size_t mask = m_slots.size() - 1;
+    for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+      // slots hold the number of a state plus one
+      const uint64_t entry = m_slots[slot];
+      if (entry == 0) {
+        m_slots[slot] = size() + 1;
+        m_hashes.push_back(hash);
+        m_arena.insert(m_arena.end(), state, state + m_words);
+        return {size() - 1, true};
+      }
+      if (m_hashes[entry - 1] == hash &&
+          std::memcmp(get(entry - 1), state, m_words * sizeof(uint64_t)) ==
+              0) {
+        return {entry - 1, false};
+      }
+    }
+  }
+
+private:
+  void grow() {
+    std::vector<uint64_t> slots(2 * m_slots.size(), 0);
+    const size_t mask = slots.size() - 1;
+    for (uint64_t number = 0; number < size(); ++number) {
+      size_t slot = m_hashes[number] & mask;
+      while (slots[slot] != 0) {
+        slot = (slot + 1) & mask;
+      }
+      slots[slot] = number + 1;
+    }
+    m_slots = std::move(slots);
+  }
+
+  unsigned m_words;
+  std::vector<uint64_t> m_arena;
+  std::vector<uint64_t> m_hashes;
+  std::vector<uint64_t> m_slots;
+};
+
+/// Breadth first search on one thread, numbering the states in the order
+/// they are reached
+class SequentialExplorer : public Explorer {
+public:
+  SequentialExplorer(const Model &model, const Options &options)
+      : Explorer(model, options), m_visited(model.getStateWords()),
+        m_random(options.seed) {}
+
+  bool run() override;
+
+protected:
+  uint64_t getNumStates() const override { return m_visited.size(); }
+  uint64_t getMemoryUsage() const override {
+    return m_visited.getMemoryUsage() +
+           (m_parents.capacity() + m_parentInputs.capacity()) *
+               sizeof(uint64_t);
+  }
+  void getState(uint64_t state, uint64_t *words) const override {
+    const uint64_t *visited = m_visited.get(state);
+    std::copy(visited, visited + m_model.getStateWords(), words);
+  }
+  uint64_t getParent(uint64_t state) const override {
+    return m_parents[state];
+  }
+  void getParentInputs(uint64_t state, uint64_t *inputs) const override {
+    const unsigned inputWords = m_model.getInputWords();
+    const uint64_t *parentInputs = m_parentInputs.data() + state * inputWords;
+    std::copy(parentInputs, parentInputs + inputWords, inputs);
+  }
+
+private:
+  bool addState(const uint64_t *state, uint64_t parent,
+                const uint64_t *inputs);
+  void checkBads(uint64_t number, const uint64_t *state,
+                 const uint64_t *inputs, unsigned depth);
+
+  StateSet m_visited;
+  // the state each state was first reached from, and with which inputs
+  std::vector<uint64_t> m_parents;
+  std::vector<uint64_t> m_parentInputs;
+  std::mt19937_64 m_random;
+};
+
+bool SequentialExplorer::addState(const uint64_t *state, uint64_t parent,
+                                  const uint64_t *inputs) {
+  if (m_options.maxStates && m_visited.size() >= m_options.maxStates) {
+    m_truncated = true;
+    return false;
+  }
+  if (m_visited.insert(state).second) {
+    m_parents.push_back(parent);
+    m_parentInputs.insert(m_parentInputs.end(), inputs,
+                          inputs + m_model.getInputWords());
+  }
+  return true;
+}
+
+void SequentialExplorer::checkBads(uint64_t number, const uint64_t *state,
+                                   const uint64_t *inputs, unsigned depth) {
+  const uint64_t bads = m_model.bad(state, inputs);
+  for (unsigned bad = 0; bad < m_numBads; ++bad) {
+    if ((bads >> bad & 1) && !isReached(bad)) {
+      setCounterexample(bad, number, inputs, depth);
+    }
+  }
+}
+
+bool SequentialExplorer::run() {
+  const unsigned stateWords = m_model.getStateWords();
+  const unsigned inputWords = m_model.getInputWords();
+  const unsigned maxDepth = m_options.maxDepth;
+  std::vector<uint64_t> state(stateWords), next(stateWords),
+      successor(stateWords), inputs(inputWords, 0);
+
+  for (uint64_t i = 0; i < m_initChoices.count(); ++i) {
+    std::fill(state.begin(), state.end(), 0);
+    m_initChoices.assign(i, state.data(), m_random);
+    m_model.init(state.data());
+    if (!addState(state.data(), noParent, inputs.data())) {
+      break;
+    }
+  }
+
+  // the states of each depth follow those of the previous one
+  uint64_t begin = 0, end = m_visited.size();
+  for (m_depth = 0; begin < end; ++m_depth) {
+    for (uint64_t number = begin; number < end && !m_truncated; ++number) {
+      // inserting may move the states
+      getState(number, state.data());
+      for (uint64_t i = 0; i < m_inputChoices.count(); ++i) {
+        std::fill(inputs.begin(), inputs.end(), 0);
+        m_inputChoices.assign(i, inputs.data(), m_random);
+        if (!m_model.constraint(state.data(), inputs.data())) {
+          continue;
+        }
+        checkBads(number, state.data(), inputs.data(), m_depth);
+        if (maxDepth && m_depth == maxDepth) {
+          continue;
+        }
+        next = state;
+        m_model.step(next.data(), inputs.data());
+        for (uint64_t j = 0; j < m_stepChoices.count(); ++j) {
+          successor = next;
+          m_stepChoices.assign(j, successor.data(), m_random);
+          if (!addState(successor.data(), number, inputs.data())) {
+            break;
+          }
+        }
+      }
+    }
+    if (allReached() || m_truncated || (maxDepth && m_depth == maxDepth)) {
+      return true;
+    }
+    begin = end;
+    end = m_visited.size();
+  }
+  // the last depth had no new states
+  --m_depth;
+  m_exhausted = true;
+  return true;
+}
+} // namespace
+
+std::unique_ptr<Explorer>
+explore::createSequentialExplorer(const Model &model, const Options &options) {
+  return std::make_unique<SequentialExplorer>(model, options);
+}
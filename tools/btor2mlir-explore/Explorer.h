@@ -0,0 +1,170 @@
+//===- Explorer.h - Explicit-state search over compiled models --*- C++ -*-===//
+//
+// This file is licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// An Explorer searches the states of a Model breadth first, and remembers
+// for every bad the first state and inputs in which it holds. The search
+// itself is left to its subclasses; the Explorer reports the result and
+// writes counterexamples as BTOR2 witnesses by walking back the parents of
+// states.
+//
+//===----------------------------------------------------------------------===//
+#ifndef BTOR2MLIR_EXPLORE_EXPLORER_H
+#define BTOR2MLIR_EXPLORE_EXPLORER_H
+
+#include "Model.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace explore {
+
+/// How the visited states are stored
+enum class Storage {
+  // the packed words of each state
+  Full,
+  // tuples of the ids of chunks of words, interned in a shared table
+  Collapse,
+  // only a fingerprint of each state, so states with equal fingerprints are
+  // taken for the same
+  HashCompact,
+  // only a few bits of a fixed table per state, set by hashing it
+  Bitstate,
+};
+
+struct Options {
+  // steps to search at most, or 0
+  unsigned maxDepth = 0;
+  // states to visit at most, or 0
+  uint64_t maxStates = 0;
+  unsigned enumerateBits = 12;
+  unsigned samples = 1024;
+  uint64_t seed = 1;
+  unsigned threads = 1;
+  // report the same counterexample on every parallel run
+  bool deterministic = false;
+  Storage storage = Storage::Full;
+  // words per chunk of a collapsed state
+  unsigned chunkWords = 2;
+  // log2 of the bits of the bitstate table
+  unsigned bitstateBits = 30;
+  // random walks to run instead of a search, or 0
+  unsigned walks = 0;
+  // steps of the longest walk
+  unsigned walkDepth = 10000;
+};
+
+constexpr uint64_t noParent = UINT64_MAX;
+
+inline uint64_t hashState(const uint64_t *state, unsigned words) {
+  uint64_t hash = 0x9e3779b97f4a7c15ULL ^ words;
+  for (unsigned i = 0; i < words; ++i) {
+    hash = (hash ^ state[i]) * 0xbf58476d1ce4e5b9ULL;
+    hash ^= hash >> 31;
+  }
+  hash *= 0x94d049bb133111ebULL;
+  return hash ^ (hash >> 29);
+}
+
+/// The SplitMix64 generator, which is cheap enough to seed for every value
+/// that is drawn
+class SplitMix64 {
+public:
+  explicit SplitMix64(uint64_t seed) : m_state(seed) {}
+
+  uint64_t operator()() {
+    uint64_t z = (m_state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+
+private:
+  uint64_t m_state;
+};
+
+/// Writes a BTOR2 witness for bad from the packed states and inputs of each
+/// frame, which follow each other in states and inputs
+void writeWitness(llvm::raw_ostream &os, const Model &model, unsigned bad,
+                  size_t frames, const uint64_t *states,
+                  const uint64_t *inputs);
+
+struct Counterexample {
+  // the state in which the bad holds
+  uint64_t state = noParent;
+  std::vector<uint64_t> inputs;
+  unsigned depth = 0;
+};
+
+class Explorer {
+public:
+  Explorer(const Model &model, const Options &options);
+  virtual ~Explorer();
+
+  /// @return false if the search could not be run
+  virtual bool run() = 0;
+
+  void report(llvm::raw_ostream &os) const;
+
+  /// Writes the counterexample of the bad reached first, which is a
+  /// shortest one
+  /// @return false if no bad was reached
+  bool writeWitness(llvm::raw_ostream &os) const;
+
+protected:
+  virtual uint64_t getNumStates() const = 0;
+  /// @return the bytes taken by the visited states and their parents
+  virtual uint64_t getMemoryUsage() const = 0;
+  virtual void getState(uint64_t state, uint64_t *words) const = 0;
+  /// @return the state that state was reached from, or noParent
+  virtual uint64_t getParent(uint64_t state) const = 0;
+  /// Writes the inputs with which the parent of state stepped to it
+  virtual void getParentInputs(uint64_t state, uint64_t *inputs) const = 0;
+
+  void setCounterexample(unsigned bad, uint64_t state, const uint64_t *inputs,
+                         unsigned depth);
+  bool isReached(unsigned bad) const {
+    return m_counterexamples[bad].state != noParent;
+  }
+  bool allReached() const { return m_reached.size() == m_numBads; }
+  bool isComplete() const;
+
+  const Model &m_model;
+  const Options &m_options;
+  Choices m_initChoices, m_inputChoices, m_stepChoices;
+  unsigned m_numBads = 0;
+  // the depth searched last
+  unsigned m_depth = 0;
+  // no state is left to search
+  bool m_exhausted = false;
+  // the state bound was reached
+  bool m_truncated = false;
+  // the visited states are stored lossily, and some may have been missed
+  bool m_approximate = false;
+
+private:
+  std::vector<Counterexample> m_counterexamples;
+  // the bads in the order they were reached
+  std::vector<unsigned> m_reached;
+};
+
+std::unique_ptr<Explorer> createSequentialExplorer(const Model &model,
+                                                   const Options &options);
+
+/// Searches with options.threads threads, level by level, and stores the
+/// states as options.storage says
+std::unique_ptr<Explorer> createParallelExplorer(const Model &model,
+                                                 const Options &options);
+
+} // namespace explore
+
+#endif
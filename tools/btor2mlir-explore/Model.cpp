@@ -0,0 +1,187 @@
+//===- Model.cpp - BTOR2 models compiled for explicit-state search --------===//
+//
+// This file is licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "Model.h"
+
+#include "mlir/Conversion/ArithmeticToLLVM/ArithmeticToLLVM.h"
+#include "mlir/Conversion/ReconcileUnrealizedCasts/ReconcileUnrealizedCasts.h"
+#include "mlir/Conversion/StandardToLLVM/ConvertStandardToLLVMPass.h"
+#include "mlir/Conversion/VectorToLLVM/ConvertVectorToLLVMPass.h"
+#include "mlir/Dialect/Arithmetic/IR/Arithmetic.h"
+#include "mlir/Dialect/LLVMIR/LLVMDialect.h"
+#include "mlir/Dialect/StandardOps/IR/Ops.h"
+#include "mlir/Dialect/Vector/IR/VectorOps.h"
+#include "mlir/ExecutionEngine/ExecutionEngine.h"
+#include "mlir/ExecutionEngine/OptUtils.h"
+#include "mlir/IR/BuiltinOps.h"
+#include "mlir/IR/MLIRContext.h"
+#include "mlir/Pass/PassManager.h"
+#include "mlir/Target/LLVMIR/Dialect/LLVMIR/LLVMToLLVMIRTranslation.h"
+#include "llvm/Support/WithColor.h"
+
+#include "Conversion/BtorToLLVM/ConvertBtorToLLVMPass.h"
+#include "Conversion/BtorToVector/ConvertBtorToVectorPass.h"
+#include "Dialect/Btor/IR/Btor.h"
+#include "Target/Btor/BtorToBtorIRTranslation.h"
+
+#include <algorithm>
+
+using namespace mlir;
+using namespace explore;
+
+namespace {
+
+/// @brief Reads the globals that the btor to llvm lowering adds to describe
+/// the packed words of the step abi
+/// @param prefix, btor_state or btor_input
+/// @return false if the module has no such globals
+bool readLayout(ModuleOp module, const std::string &prefix, unsigned &words,
+                std::vector<Field> &fields) {
+  auto wordsGlobal = module.lookupSymbol<LLVM::GlobalOp>(prefix + "_words");
+  if (!wordsGlobal) {
+    return false;
+  }
+  words = wordsGlobal.getValueOrNull().cast<IntegerAttr>().getInt();
+  // a model without states or inputs has no layout
+  auto layoutGlobal = module.lookupSymbol<LLVM::GlobalOp>(prefix + "_layout");
+  if (!layoutGlobal) {
+    return true;
+  }
+  auto values = layoutGlobal.getValueOrNull()
+                    .cast<DenseElementsAttr>()
+                    .getValues<int64_t>();
+  std::vector<int64_t> layout(values.begin(), values.end());
+  for (size_t i = 0; i + 3 < layout.size(); i += 4) {
+    Field field;
+    field.offset = layout[i];
+    field.width = layout[i + 1];
+    field.indexWidth = layout[i + 2];
+    field.stride = layout[i + 3];
+    fields.push_back(field);
+  }
+  return true;
+}
+} // namespace
+
+Model::Model() = default;
+
+Model::~Model() = default;
+
+std::unique_ptr<Model> Model::load(const std::string &path,
+                                   unsigned optLevel) {
+  DialectRegistry registry;
+  registry.insert<btor::BtorDialect, arith::ArithmeticDialect,
+                  StandardOpsDialect, vector::VectorDialect,
+                  LLVM::LLVMDialect>();
+  registerLLVMDialectTranslation(registry);
+  MLIRContext context(registry);
+  context.loadDialect<btor::BtorDialect, StandardOpsDialect>();
+
+  std::unique_ptr<Model> model(new Model());
+  OwningOpRef<ModuleOp> module(
+      ModuleOp::create(FileLineColLoc::get(&context, path, 0, 0)));
+  {
+    btor::Deserialize deserialize(&context, path);
+    if (!deserialize.parseModelIsSuccessful() ||
+        !deserialize.buildStepFunctions(*module)) {
+      llvm::WithColor::error() << "failed to import " << path << '\n';
+      return nullptr;
+    }
+    for (auto state : deserialize.getStates()) {
+      model->m_hasInit.push_back(state->init != 0);
+      model->m_hasNext.push_back(state->next != 0);
+    }
+    model->m_numBads = deserialize.getBads().size();
+  }
+
+  PassManager pm(&context);
+  pm.addPass(btor::createLowerToVectorPass());
+  pm.addPass(arith::createConvertArithmeticToLLVMPass());
+  pm.addPass(mlir::createLowerToLLVMPass());
+  pm.addPass(btor::createLowerToLLVMPass());
+  pm.addPass(createConvertVectorToLLVMPass());
+  pm.addPass(createReconcileUnrealizedCastsPass());
+  if (failed(pm.run(*module))) {
+    llvm::WithColor::error() << "failed to lower " << path << '\n';
+    return nullptr;
+  }
+  if (!readLayout(*module, "btor_state", model->m_stateWords,
+                  model->m_states) ||
+      !readLayout(*module, "btor_input", model->m_inputWords,
+                  model->m_inputs) ||
+      model->m_states.size() != model->m_hasInit.size()) {
+    llvm::WithColor::error() << "the lowered model has no step abi layout\n";
+    return nullptr;
+  }
+
+  auto transformer = makeOptimizingTransformer(optLevel, 0, nullptr);
+  auto maybeEngine = ExecutionEngine::create(
+      *module, nullptr, transformer,
+      static_cast<llvm::CodeGenOpt::Level>(std::min(optLevel, 3u)));
+  if (!maybeEngine) {
+    llvm::WithColor::error() << "failed to create the execution engine: "
+                             << llvm::toString(maybeEngine.takeError())
+                             << '\n';
+    return nullptr;
+  }
+  model->m_engine = std::move(maybeEngine.get());
+  const std::pair<const char *, PackedFunc *> entries[] = {
+      {"btor_init", &model->m_init},
+      {"btor_step", &model->m_step},
+      {"btor_bad", &model->m_bad},
+      {"btor_constraint", &model->m_constraint}};
+  for (const auto &entry : entries) {
+    auto maybeFunc = model->m_engine->lookup(entry.first);
+    if (!maybeFunc) {
+      llvm::WithColor::error() << "failed to find " << entry.first << ": "
+                               << llvm::toString(maybeFunc.takeError())
+                               << '\n';
+      return nullptr;
+    }
+    *entry.second = maybeFunc.get();
+  }
+  return model;
+}
+
+void Model::getChoices(Choices &init, Choices &inputs, Choices &step) const {
+  for (unsigned i = 0; i < m_states.size(); ++i) {
+    if (!m_hasInit[i]) {
+      init.add(m_states[i]);
+      if (!m_hasNext[i]) {
+        step.add(m_states[i]);
+      }
+    }
+  }
+  for (const Field &input : m_inputs) {
+    inputs.add(input);
+  }
+}
+
+void Model::init(uint64_t *state) const {
+  void *args[] = {&state};
+  m_init(args);
+}
+
+void Model::step(uint64_t *state, const uint64_t *inputs) const {
+  void *args[] = {&state, &inputs};
+  m_step(args);
+}
+
+uint64_t Model::bad(const uint64_t *state, const uint64_t *inputs) const {
+  uint64_t bads = 0;
+  void *args[] = {&state, &inputs, &bads};
+  m_bad(args);
+  return bads;
+}
+
+bool Model::constraint(const uint64_t *state, const uint64_t *inputs) const {
+  int32_t holds = 0;
+  void *args[] = {&state, &inputs, &holds};
+  m_constraint(args);
+  return holds != 0;
+}
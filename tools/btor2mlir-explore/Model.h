@@ -0,0 +1,187 @@
+//===- Model.h - BTOR2 models compiled for explicit-state search -*- C++ -*-===//
+//
+// This file is licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// A Model imports a BTOR2 file with the step abi, lowers it to the LLVM
+// dialect and JIT compiles it. Its states and inputs are packed into 64-bit
+// words as described by the btor_state_layout and btor_input_layout globals.
+//
+//===----------------------------------------------------------------------===//
+#ifndef BTOR2MLIR_EXPLORE_MODEL_H
+#define BTOR2MLIR_EXPLORE_MODEL_H
+
+#include "llvm/ADT/ArrayRef.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mlir {
+class ExecutionEngine;
+} // namespace mlir
+
+namespace explore {
+
+/// Where a state or an input lives in its packed words
+struct Field {
+  // bit offset of the value, or of the first element of an array
+  unsigned offset = 0;
+  unsigned width = 0;
+  // zero for bit-vectors
+  unsigned indexWidth = 0;
+  // bits per element of an array
+  unsigned stride = 0;
+
+  bool isArray() const { return indexWidth != 0; }
+  uint64_t numElements() const { return uint64_t(1) << indexWidth; }
+};
+
+/// @return the width bits at offset, which lie in one word
+inline uint64_t readBits(const uint64_t *words, unsigned offset,
+                         unsigned width) {
+  const uint64_t value = words[offset / 64] >> (offset % 64);
+  return width < 64 ? value & ((uint64_t(1) << width) - 1) : value;
+}
+
+/// Sets the width bits at offset, which lie in one word, to value
+inline void writeBits(uint64_t *words, unsigned offset, unsigned width,
+                      uint64_t value) {
+  uint64_t &word = words[offset / 64];
+  if (width == 64) {
+    word = value;
+    return;
+  }
+  const uint64_t mask = ((uint64_t(1) << width) - 1) << (offset % 64);
+  word = (word & ~mask) | ((value << (offset % 64)) & mask);
+}
+
+/// Values that the search picks: an input, or a state that the model leaves
+/// to its environment, split into parts of at most 64 bits
+class Choices {
+public:
+  /// Adds the bits of field, element by element for arrays
+  void add(const Field &field) {
+    if (field.isArray()) {
+      for (uint64_t i = 0; i < field.numElements(); ++i) {
+        addPart(field.offset + i * field.stride, field.width);
+      }
+      return;
+    }
+    // values wider than a word start at a word
+    for (unsigned bit = 0; bit < field.width; bit += 64) {
+      addPart(field.offset + bit, std::min(64u, field.width - bit));
+    }
+  }
+
+  /// Decides whether to enumerate all values or sample some
+  void finalize(unsigned enumerateBits, unsigned samples) {
+    m_exhaustive = m_bits <= std::min(enumerateBits, 63u);
+    m_count = m_exhaustive ? uint64_t(1) << m_bits : samples;
+  }
+
+  bool isExhaustive() const { return m_exhaustive; }
+
+  /// @return the number of values to try
+  uint64_t count() const { return m_count; }
+
+  /// Writes the value with the given number into words, or the next random
+  /// value if the values are sampled
+  template <typename Random>
+  void assign(uint64_t number, uint64_t *words, Random &random) const {
+    for (const Part &part : m_parts) {
+      uint64_t value;
+      if (m_exhaustive) {
+        value = number;
+        number = part.width < 64 ? number >> part.width : 0;
+      } else {
+        value = random();
+      }
+      writeBits(words, part.offset, part.width, value);
+    }
+  }
+
+  /// Writes values drawn from random into words, even if the values are
+  /// enumerated
+  template <typename Random>
+  void draw(uint64_t *words, Random &random) const {
+    for (const Part &part : m_parts) {
+      writeBits(words, part.offset, part.width, random());
+    }
+  }
+
+private:
+  struct Part {
+    unsigned offset;
+    unsigned width;
+  };
+
+  void addPart(unsigned offset, unsigned width) {
+    m_parts.push_back({offset, width});
+    m_bits += width;
+  }
+
+  std::vector<Part> m_parts;
+  uint64_t m_bits = 0;
+  bool m_exhaustive = true;
+  uint64_t m_count = 1;
+};
+
+class Model {
+public:
+  ~Model();
+
+  /// @return the compiled model, or null after reporting why it failed
+  static std::unique_ptr<Model> load(const std::string &path,
+                                     unsigned optLevel);
+
+  unsigned getStateWords() const { return m_stateWords; }
+  unsigned getInputWords() const { return m_inputWords; }
+  llvm::ArrayRef<Field> getStates() const { return m_states; }
+  llvm::ArrayRef<Field> getInputs() const { return m_inputs; }
+  unsigned getNumBads() const { return m_numBads; }
+  bool hasInit(unsigned state) const { return m_hasInit[state]; }
+  bool hasNext(unsigned state) const { return m_hasNext[state]; }
+
+  /// Adds the values that a search picks: the states without an init to
+  /// init, those of them without a next to step as well, and the inputs to
+  /// inputs
+  void getChoices(Choices &init, Choices &inputs, Choices &step) const;
+
+  /// Initializes the states with an init, keeping the others
+  void init(uint64_t *state) const;
+  /// Replaces the states with a next by their next values
+  void step(uint64_t *state, const uint64_t *inputs) const;
+  /// @return a mask with bit i set if bad i holds, bit 63 for any later bad
+  uint64_t bad(const uint64_t *state, const uint64_t *inputs) const;
+  /// @return true if all constraints hold
+  bool constraint(const uint64_t *state, const uint64_t *inputs) const;
+
+private:
+  Model();
+
+  using PackedFunc = void (*)(void **);
+
+  std::unique_ptr<mlir::ExecutionEngine> m_engine;
+  PackedFunc m_init = nullptr;
+  PackedFunc m_step = nullptr;
+  PackedFunc m_bad = nullptr;
+  PackedFunc m_constraint = nullptr;
+
+  unsigned m_stateWords = 0;
+  unsigned m_inputWords = 0;
+  std::vector<Field> m_states;
+  std::vector<Field> m_inputs;
+  std::vector<bool> m_hasInit;
+  std::vector<bool> m_hasNext;
+  unsigned m_numBads = 0;
+};
+
+} // namespace explore
+
+#endif
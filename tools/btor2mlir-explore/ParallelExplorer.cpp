@@ -0,0 +1,996 @@
+//===- ParallelExplorer.cpp - Explicit-state search on many threads -------===//
+//
+// This file is licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// The parallel search goes level by level. The states of a level are split
+// into one slice per worker: a worker expands its own slice a chunk at a time,
+// and then steals chunks from the slices of the others. New states go into a
+// lock-free open addressing table. A worker claims an empty slot with a
+// compare-and-swap on the fingerprint of its state, stores the state in an
+// arena of its own and then publishes the number of the state in the slot.
+// A worker that meets the fingerprint of its state compares the states once
+// the slot is published, so colliding fingerprints do not lose states. The
+// table grows between levels; states that find it too full during a level are
+// kept aside and inserted after it grows.
+//
+// A state records the position of its parent in the previous level and the
+// number of the transition that reached it. Sampled values are drawn from
+// generators seeded with the state and the number of the value, so that the
+// values of any step can be drawn again. Without --deterministic, the first
+// worker to reach a state decides its parent. With it, a state keeps the
+// least (position, transition) that reaches it within its level and the
+// levels are sorted by it, so that the counterexamples and witnesses do not
+// depend on the schedule of the workers.
+//
+// What the arenas keep of a state depends on the storage. With collapse
+// compression a state is split into chunks of words, the chunks are interned
+// in a table shared by all workers, and the arena keeps the 32-bit ids of the
+// chunks. With hash compaction the table keeps only fingerprints, and with
+// bitstate hashing only a few bits of a fixed table per state; both then
+// drop the words of the levels that were expanded. A dropped state is
+// rebuilt for the witness by replaying the steps from its initial state.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Explorer.h"
+
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/WithColor.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+using namespace llvm;
+using namespace explore;
+
+namespace {
+
+// states per block of an arena
+constexpr unsigned blockBits = 16;
+constexpr uint64_t blockSize = uint64_t(1) << blockBits;
+constexpr unsigned maxBlockBits = 14;
+// a state is numbered by its worker and its index in the arena of the worker
+constexpr unsigned workerShift = blockBits + maxBlockBits;
+constexpr uint64_t indexMask = (uint64_t(1) << workerShift) - 1;
+// the key of a state holds the position of its parent above its transition
+constexpr uint64_t transitionMask = UINT32_MAX;
+// states of a slice that a worker claims at once
+constexpr uint64_t chunkSize = 32;
+constexpr unsigned initialTableBits = 16;
+// bits that bitstate hashing sets per state
+constexpr unsigned bitstateProbes = 3;
+
+uint64_t mixSeed(uint64_t seed, uint64_t number) {
+  return seed ^ (number * 0xd1b54a32d192ed03ULL);
+}
+
+/// @return the fingerprint of words, which is never zero
+uint64_t getFingerprint(const uint64_t *words, unsigned size) {
+  const uint64_t fingerprint = hashState(words, size);
+  return fingerprint + (fingerprint == 0);
+}
+
+/// The states added by one worker, each as a record of words. The records
+/// are kept in blocks that never move, so that the other workers can read
+/// them while more are added.
+class StateArena {
+public:
+  explicit StateArena(unsigned words)
+      : m_words(words),
+        m_blocks(new std::unique_ptr<Block>[uint64_t(1) << maxBlockBits]) {}
+
+  uint64_t size() const { return m_size; }
+  bool isFull() const { return m_size >> blockBits >> maxBlockBits != 0; }
+
+  /// @return the index of the added state
+  uint64_t add(const uint64_t *record, uint64_t key, unsigned level) {
+    if (m_size % blockSize == 0) {
+      m_blocks[m_size >> blockBits] = std::make_unique<Block>(m_words);
+    }
+    Block &block = *m_blocks[m_size >> blockBits];
+    const uint64_t index = m_size % blockSize;
+    std::copy(record, record + m_words, block.records.get() + index * m_words);
+    block.keys[index].store(key, std::memory_order_relaxed);
+    block.levels[index] = level;
+    return m_size++;
+  }
+
+  /// @return the record of a state, or null if it was released
+  const uint64_t *get(uint64_t index) const {
+    const uint64_t *records = m_blocks[index >> blockBits]->records.get();
+    return records ? records + (index % blockSize) * m_words : nullptr;
+  }
+  std::atomic<uint64_t> &getKey(uint64_t index) const {
+    return m_blocks[index >> blockBits]->keys[index % blockSize];
+  }
+  unsigned getLevel(uint64_t index) const {
+    return m_blocks[index >> blockBits]->levels[index % blockSize];
+  }
+
+  /// Frees the records of the blocks that hold only states before end
+  void releaseRecords(uint64_t end) {
+    for (; m_released < end >> blockBits; ++m_released) {
+      m_blocks[m_released]->records.reset();
+    }
+  }
+
+  uint64_t getMemoryUsage() const {
+    const uint64_t blocks = (m_size + blockSize - 1) >> blockBits;
+    const uint64_t stored = blocks - std::min(blocks, m_released);
+    return stored * blockSize * m_words * sizeof(uint64_t) +
+           blocks * blockSize * (sizeof(uint64_t) + sizeof(uint32_t)) +
+           (uint64_t(1) << maxBlockBits) * sizeof(void *);
+  }
+
+private:
+  struct Block {
+    explicit Block(unsigned words)
+        : records(new uint64_t[blockSize * words]),
+          keys(new std::atomic<uint64_t>[blockSize]),
+          levels(new uint32_t[blockSize]) {}
+
+    std::unique_ptr<uint64_t[]> records;
+    std::unique_ptr<std::atomic<uint64_t>[]> keys;
+    std::unique_ptr<uint32_t[]> levels;
+  };
+
+  unsigned m_words;
+  std::unique_ptr<std::unique_ptr<Block>[]> m_blocks;
+  uint64_t m_size = 0;
+  // the blocks whose records were released
+  uint64_t m_released = 0;
+};
+
+/// Interns the chunks of collapsed states. A chunk is claimed like a state,
+/// with a compare-and-swap on its fingerprint, and numbered densely so that
+/// a state refers to each of its chunks with 32 bits.
+class ChunkTable {
+public:
+  explicit ChunkTable(unsigned words)
+      : m_words(words),
+        m_blocks(new std::atomic<uint64_t *>[uint64_t(1) << chunkBlockBits]) {
+    for (uint64_t block = 0; block < uint64_t(1) << chunkBlockBits; ++block) {
+      m_blocks[block].store(nullptr, std::memory_order_relaxed);
+    }
+    grow(uint64_t(1) << initialTableBits);
+  }
+
+  ~ChunkTable() {
+    for (uint64_t block = 0; block < uint64_t(1) << chunkBlockBits; ++block) {
+      delete[] m_blocks[block].load(std::memory_order_relaxed);
+    }
+  }
+
+  uint64_t size() const { return m_size.load(std::memory_order_relaxed); }
+  bool isCrowded() const { return size() >= m_capacity / 2; }
+  /// @return true if new chunks may run out of ids
+  bool isExhausted() const { return size() >= UINT32_MAX - (1u << 24); }
+
+  /// @return the id of chunk, or noParent if it is new and intern is false
+  uint64_t intern(const uint64_t *chunk, bool intern) {
+    const uint64_t fingerprint = getFingerprint(chunk, m_words);
+    const uint64_t mask = m_capacity - 1;
+    for (uint64_t slot = fingerprint & mask;; slot = (slot + 1) & mask) {
+      uint64_t found = m_fingerprints[slot].load(std::memory_order_acquire);
+      if (found == 0 && !intern) {
+        return noParent;
+      }
+      if (found == 0 && m_fingerprints[slot].compare_exchange_strong(
+                            found, fingerprint, std::memory_order_acq_rel)) {
+        const uint64_t id = m_size.fetch_add(1, std::memory_order_relaxed);
+        std::copy(chunk, chunk + m_words, getSlot(id));
+        m_ids[slot].store(id + 1, std::memory_order_release);
+        return id;
+      }
+      if (found != fingerprint) {
+        continue;
+      }
+      uint64_t entry;
+      while ((entry = m_ids[slot].load(std::memory_order_acquire)) == 0) {
+        std::this_thread::yield();
+      }
+      if (std::memcmp(get(entry - 1), chunk, m_words * sizeof(uint64_t)) ==
+          0) {
+        return entry - 1;
+      }
+    }
+  }
+
+  const uint64_t *get(uint32_t id) const {
+    return m_blocks[id >> blockBits].load(std::memory_order_acquire) +
+           (id % blockSize) * m_words;
+  }
+
+  /// Grows the table to a quarter full, when no worker runs
+  void reserve() {
+    uint64_t capacity = m_capacity;
+    while (4 * size() > capacity) {
+      capacity *= 2;
+    }
+    if (capacity != m_capacity) {
+      grow(capacity);
+    }
+  }
+
+  uint64_t getMemoryUsage() const {
+    const uint64_t blocks = (size() + blockSize - 1) >> blockBits;
+    return m_capacity * 2 * sizeof(uint64_t) +
+           blocks * blockSize * m_words * sizeof(uint64_t) +
+           (uint64_t(1) << chunkBlockBits) * sizeof(void *);
+  }
+
+private:
+  static constexpr unsigned chunkBlockBits = 32 - blockBits;
+
+  uint64_t *getSlot(uint64_t id) {
+    std::atomic<uint64_t *> &block = m_blocks[id >> blockBits];
+    uint64_t *words = block.load(std::memory_order_acquire);
+    if (!words) {
+      auto *fresh = new uint64_t[blockSize * m_words];
+      if (block.compare_exchange_strong(words, fresh,
+                                        std::memory_order_acq_rel)) {
+        words = fresh;
+      } else {
+        delete[] fresh;
+      }
+    }
+    return words + (id % blockSize) * m_words;
+  }
+
+  void grow(uint64_t capacity) {
+    std::unique_ptr<std::atomic<uint64_t>[]> fingerprints(
+        new std::atomic<uint64_t>[capacity]);
+    std::unique_ptr<std::atomic<uint64_t>[]> ids(
+        new std::atomic<uint64_t>[capacity]);
+    for (uint64_t slot = 0; slot < capacity; ++slot) {
+      fingerprints[slot].store(0, std::memory_order_relaxed);
+      ids[slot].store(0, std::memory_order_relaxed);
+    }
+    const uint64_t mask = capacity - 1;
+    for (uint64_t old = 0; old < m_capacity; ++old) {
+      const uint64_t fingerprint =
+          m_fingerprints[old].load(std::memory_order_relaxed);
+      if (fingerprint == 0) {
+        continue;
+      }
+      uint64_t slot = fingerprint & mask;
+      while (fingerprints[slot].load(std::memory_order_relaxed) != 0) {
+        slot = (slot + 1) & mask;
+      }
+      fingerprints[slot].store(fingerprint, std::memory_order_relaxed);
+      ids[slot].store(m_ids[old].load(std::memory_order_relaxed),
+                      std::memory_order_relaxed);
+    }
+    m_fingerprints = std::move(fingerprints);
+    m_ids = std::move(ids);
+    m_capacity = capacity;
+  }
+
+  unsigned m_words;
+  std::unique_ptr<std::atomic<uint64_t>[]> m_fingerprints;
+  // the id of the chunk plus one once it is stored
+  std::unique_ptr<std::atomic<uint64_t>[]> m_ids;
+  uint64_t m_capacity = 0;
+  std::atomic<uint64_t> m_size{0};
+  // the chunks by id, in blocks allocated by the first worker to need them
+  std::unique_ptr<std::atomic<uint64_t *>[]> m_blocks;
+};
+
+/// The least frontier position and input in which a bad holds
+struct Found {
+  uint64_t position = noParent;
+  uint64_t input = 0;
+
+  bool isBefore(uint64_t otherPosition, uint64_t otherInput) const {
+    return position < otherPosition ||
+           (position == otherPosition && input < otherInput);
+  }
+};
+
+struct alignas(64) Worker {
+  Worker(unsigned stateWords, unsigned recordWords, unsigned chunkWords,
+         unsigned inputWords, unsigned numBads)
+      : arena(recordWords), found(numBads), state(stateWords),
+        next(stateWords), successor(stateWords), inputs(inputWords),
+        record(recordWords), chunk(chunkWords) {}
+
+  StateArena arena;
+  // the slice of the frontier that this worker expands first
+  std::atomic<uint64_t> cursor{0};
+  uint64_t end = 0;
+  // the arena index of the first state of the next level
+  uint64_t levelEnd = 0;
+  // the states this worker added in the current level
+  std::vector<uint64_t> added;
+  // states and keys that found the tables too full
+  std::vector<uint64_t> deferredStates;
+  std::vector<uint64_t> deferredKeys;
+  std::vector<Found> found;
+  std::vector<uint64_t> state, next, successor, inputs;
+  std::vector<uint64_t> record, chunk;
+};
+
+class ParallelExplorer : public Explorer {
+public:
+  ParallelExplorer(const Model &model, const Options &options);
+  ~ParallelExplorer() override;
+
+  bool run() override;
+
+protected:
+  uint64_t getNumStates() const override;
+  uint64_t getMemoryUsage() const override;
+  void getState(uint64_t state, uint64_t *words) const override;
+  uint64_t getParent(uint64_t state) const override;
+  void getParentInputs(uint64_t state, uint64_t *inputs) const override;
+
+private:
+  const StateArena &getArena(uint64_t state) const {
+    return m_workers[state >> workerShift]->arena;
+  }
+  const uint64_t *getRecord(uint64_t state) const {
+    return getArena(state).get(state & indexMask);
+  }
+  std::atomic<uint64_t> &getKey(uint64_t state) const {
+    return getArena(state).getKey(state & indexMask);
+  }
+  unsigned getLevel(uint64_t state) const {
+    return getArena(state).getLevel(state & indexMask);
+  }
+  bool isExact() const {
+    return m_options.storage == Storage::Full ||
+           m_options.storage == Storage::Collapse;
+  }
+
+  uint64_t getSeed(const uint64_t *state) const {
+    return hashState(state, m_model.getStateWords()) ^ m_options.seed;
+  }
+  void drawInitial(uint64_t number, uint64_t *state) const;
+  void drawInputs(uint64_t seed, uint64_t input, uint64_t *inputs) const;
+  void drawStep(uint64_t seed, uint64_t transition, uint64_t *state) const;
+  void rebuildState(uint64_t state, uint64_t *words) const;
+
+  bool collapse(Worker &worker, const uint64_t *state);
+  bool canAdd(Worker &worker);
+  bool testAndSetBits(uint64_t fingerprint);
+  uint64_t add(Worker &worker, unsigned id, const uint64_t *record,
+               uint64_t key, unsigned level);
+  void insert(Worker &worker, unsigned id, const uint64_t *state,
+              uint64_t key, unsigned level);
+  void insertDeferred(unsigned level);
+  void growTable(uint64_t capacity);
+  std::vector<uint64_t> takeAdded();
+
+  void expand(Worker &worker, unsigned id, uint64_t position);
+  void expandLevel(unsigned id);
+  void work(unsigned id);
+  void runLevel();
+  void collectCounterexamples();
+
+  std::vector<std::unique_ptr<Worker>> m_workers;
+  // words per record of a state in the arenas
+  unsigned m_recordWords = 0;
+  unsigned m_numChunks = 0;
+  std::unique_ptr<ChunkTable> m_chunks;
+
+  // slots hold the fingerprint of a state, or zero
+  std::unique_ptr<std::atomic<uint64_t>[]> m_fingerprints;
+  // and, for exact storage, the number of the state plus one once it is
+  // stored
+  std::unique_ptr<std::atomic<uint64_t>[]> m_numbers;
+  uint64_t m_capacity = 0;
+  std::unique_ptr<std::atomic<uint64_t>[]> m_bitstate;
+  std::atomic<uint64_t> m_size{0};
+  // states beyond this are deferred until the table grows
+  uint64_t m_sizeLimit = UINT64_MAX;
+  // the state bound was reached during the current level
+  std::atomic<bool> m_full{false};
+
+  // the states of each level, in the order positions refer to
+  std::vector<std::vector<uint64_t>> m_levels;
+  // the bads that none of the previous levels reached
+  uint64_t m_unreached = 0;
+
+  // the state rebuilt last, which the witness likely steps from next
+  mutable uint64_t m_rebuilt = noParent;
+  mutable std::vector<uint64_t> m_rebuiltWords;
+
+  std::vector<std::thread> m_threads;
+  std::mutex m_mutex;
+  std::condition_variable m_start, m_done;
+  uint64_t m_generation = 0;
+  unsigned m_running = 0;
+  bool m_stop = false;
+};
+
+ParallelExplorer::ParallelExplorer(const Model &model, const Options &options)
+    : Explorer(model, options) {
+  const unsigned stateWords = model.getStateWords();
+  const unsigned chunkWords = std::max(1u, options.chunkWords);
+  m_recordWords = stateWords;
+  if (options.storage == Storage::Collapse) {
+    // two chunk ids per word
+    m_numChunks = (stateWords + chunkWords - 1) / chunkWords;
+    m_recordWords = (m_numChunks + 1) / 2;
+    m_chunks = std::make_unique<ChunkTable>(chunkWords);
+  }
+  m_approximate = !isExact();
+  const unsigned threads = std::max(1u, options.threads);
+  for (unsigned id = 0; id < threads; ++id) {
+    m_workers.push_back(std::make_unique<Worker>(
+        stateWords, m_recordWords, chunkWords, model.getInputWords(),
+        m_numBads));
+  }
+}
+
+ParallelExplorer::~ParallelExplorer() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_start.notify_all();
+  for (std::thread &thread : m_threads) {
+    thread.join();
+  }
+}
+
+uint64_t ParallelExplorer::getNumStates() const {
+  uint64_t states = 0;
+  for (const auto &worker : m_workers) {
+    states += worker->arena.size();
+  }
+  return states;
+}
+
+uint64_t ParallelExplorer::getMemoryUsage() const {
+  uint64_t bytes = m_capacity * (m_numbers ? 2 : 1) * sizeof(uint64_t);
+  if (m_bitstate) {
+    bytes += (uint64_t(1) << m_options.bitstateBits) / 8;
+  }
+  if (m_chunks) {
+    bytes += m_chunks->getMemoryUsage();
+  }
+  for (const auto &worker : m_workers) {
+    bytes += worker->arena.getMemoryUsage();
+  }
+  for (const auto &level : m_levels) {
+    bytes += level.capacity() * sizeof(uint64_t);
+  }
+  return bytes;
+}
+
+void ParallelExplorer::getState(uint64_t state, uint64_t *words) const {
+  const uint64_t *record = getRecord(state);
+  if (!record) {
+    rebuildState(state, words);
+    return;
+  }
+  if (!m_chunks) {
+    std::copy(record, record + m_recordWords, words);
+    return;
+  }
+  const unsigned stateWords = m_model.getStateWords();
+  const unsigned chunkWords = std::max(1u, m_options.chunkWords);
+  for (unsigned i = 0; i < m_numChunks; ++i) {
+    const uint32_t id = record[i / 2] >> (i % 2 * 32);
+    const uint64_t *chunk = m_chunks->get(id);
+    const unsigned offset = i * chunkWords;
+    std::copy(chunk, chunk + std::min(chunkWords, stateWords - offset),
+              words + offset);
+  }
+}
+
+uint64_t ParallelExplorer::getParent(uint64_t state) const {
+  const unsigned level = getLevel(state);
+  if (level == 0) {
+    return noParent;
+  }
+  const uint64_t key = getKey(state).load(std::memory_order_relaxed);
+  return m_levels[level - 1][key >> 32];
+}
+
+void ParallelExplorer::getParentInputs(uint64_t state,
+                                       uint64_t *inputs) const {
+  const uint64_t transition =
+      getKey(state).load(std::memory_order_relaxed) & transitionMask;
+  std::vector<uint64_t> parent(m_model.getStateWords());
+  getState(getParent(state), parent.data());
+  drawInputs(getSeed(parent.data()), transition / m_stepChoices.count(),
+             inputs);
+}
+
+void ParallelExplorer::drawInitial(uint64_t number, uint64_t *state) const {
+  std::fill(state, state + m_model.getStateWords(), 0);
+  SplitMix64 random(mixSeed(m_options.seed, number));
+  m_initChoices.assign(number, state, random);
+  m_model.init(state);
+}
+
+void ParallelExplorer::drawInputs(uint64_t seed, uint64_t input,
+                                  uint64_t *inputs) const {
+  std::fill(inputs, inputs + m_model.getInputWords(), 0);
+  SplitMix64 random(mixSeed(seed, input));
+  m_inputChoices.assign(input, inputs, random);
+}
+
+/// Picks the states that the model leaves free after a step
+void ParallelExplorer::drawStep(uint64_t seed, uint64_t transition,
+                                uint64_t *state) const {
+  SplitMix64 random(mixSeed(~seed, transition));
+  m_stepChoices.assign(transition % m_stepChoices.count(), state, random);
+}
+
+/// Replays the steps to a state whose record was released, from the last
+/// state rebuilt or from the nearest ancestor that is still stored. This is
+/// only done between levels.
+void ParallelExplorer::rebuildState(uint64_t state, uint64_t *words) const {
+  const unsigned stateWords = m_model.getStateWords();
+  std::vector<uint64_t> path;
+  uint64_t ancestor = state;
+  while (ancestor != noParent && ancestor != m_rebuilt &&
+         !getRecord(ancestor)) {
+    path.push_back(ancestor);
+    ancestor = getParent(ancestor);
+  }
+  if (ancestor == noParent) {
+    drawInitial(getKey(path.back()).load(std::memory_order_relaxed), words);
+    path.pop_back();
+  } else if (ancestor == m_rebuilt) {
+    std::copy(m_rebuiltWords.begin(), m_rebuiltWords.end(), words);
+  } else {
+    getState(ancestor, words);
+  }
+  std::vector<uint64_t> inputs(m_model.getInputWords());
+  for (auto it = path.rbegin(); it != path.rend(); ++it) {
+    const uint64_t transition =
+        getKey(*it).load(std::memory_order_relaxed) & transitionMask;
+    const uint64_t seed = getSeed(words);
+    drawInputs(seed, transition / m_stepChoices.count(), inputs.data());
+    m_model.step(words, inputs.data());
+    drawStep(seed, transition, words);
+  }
+  m_rebuilt = state;
+  m_rebuiltWords.assign(words, words + stateWords);
+}
+
+/// Interns the chunks of state into the record of the worker
+/// @return false if the chunk table is too full for a new chunk of state
+bool ParallelExplorer::collapse(Worker &worker, const uint64_t *state) {
+  const unsigned stateWords = m_model.getStateWords();
+  const unsigned chunkWords = worker.chunk.size();
+  const bool crowded = m_chunks->isCrowded();
+  std::fill(worker.record.begin(), worker.record.end(), 0);
+  for (unsigned i = 0; i < m_numChunks; ++i) {
+    const unsigned offset = i * chunkWords;
+    // the last chunk is padded with zeros
+    std::fill(worker.chunk.begin(), worker.chunk.end(), 0);
+    std::copy(state + offset,
+              state + std::min(offset + chunkWords, stateWords),
+              worker.chunk.begin());
+    const uint64_t id = m_chunks->intern(worker.chunk.data(), !crowded);
+    if (id == noParent) {
+      return false;
+    }
+    worker.record[i / 2] |= id << (i % 2 * 32);
+  }
+  return true;
+}
+
+/// @return false, and stops the level, if the state bound is reached
+bool ParallelExplorer::canAdd(Worker &worker) {
+  if ((m_options.maxStates &&
+       m_size.load(std::memory_order_relaxed) >= m_options.maxStates) ||
+      worker.arena.isFull() || (m_chunks && m_chunks->isExhausted())) {
+    m_full.store(true, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+/// @return true if all the bits of fingerprint were set already
+bool ParallelExplorer::testAndSetBits(uint64_t fingerprint) {
+  const uint64_t mask = (uint64_t(1) << m_options.bitstateBits) - 1;
+  const uint64_t stride = (fingerprint >> 32 | fingerprint << 32) | 1;
+  bool seen = true;
+  for (unsigned probe = 0; probe < bitstateProbes; ++probe) {
+    const uint64_t bit = (fingerprint + probe * stride) & mask;
+    const uint64_t word = uint64_t(1) << (bit % 64);
+    if (!(m_bitstate[bit / 64].fetch_or(word, std::memory_order_relaxed) &
+          word)) {
+      seen = false;
+    }
+  }
+  return seen;
+}
+
+uint64_t ParallelExplorer::add(Worker &worker, unsigned id,
+                               const uint64_t *record, uint64_t key,
+                               unsigned level) {
+  const uint64_t number =
+      uint64_t(id) << workerShift | worker.arena.add(record, key, level);
+  worker.added.push_back(number);
+  m_size.fetch_add(1, std::memory_order_relaxed);
+  return number;
+}
+
+/// Inserts a state unless it was visited. A new state that finds the
+/// tables too full is deferred until they grow.
+void ParallelExplorer::insert(Worker &worker, unsigned id,
+                              const uint64_t *state, uint64_t key,
+                              unsigned level) {
+  const auto defer = [&] {
+    worker.deferredStates.insert(worker.deferredStates.end(), state,
+                                 state + m_model.getStateWords());
+    worker.deferredKeys.push_back(key);
+  };
+  const uint64_t *record = state;
+  if (m_chunks) {
+    if (!collapse(worker, state)) {
+      defer();
+      return;
+    }
+    record = worker.record.data();
+  }
+  const uint64_t fingerprint = getFingerprint(record, m_recordWords);
+  if (m_bitstate) {
+    if (canAdd(worker) && !testAndSetBits(fingerprint)) {
+      add(worker, id, record, key, level);
+    }
+    return;
+  }
+  const uint64_t mask = m_capacity - 1;
+  for (uint64_t slot = fingerprint & mask;; slot = (slot + 1) & mask) {
+    uint64_t found = m_fingerprints[slot].load(std::memory_order_acquire);
+    if (found == 0) {
+      if (m_size.load(std::memory_order_relaxed) >= m_sizeLimit) {
+        defer();
+        return;
+      }
+      if (!canAdd(worker)) {
+        return;
+      }
+      if (m_fingerprints[slot].compare_exchange_strong(
+              found, fingerprint, std::memory_order_acq_rel)) {
+        const uint64_t number = add(worker, id, record, key, level);
+        if (m_numbers) {
+          m_numbers[slot].store(number + 1, std::memory_order_release);
+        }
+        return;
+      }
+      // found now holds the fingerprint of the worker that won the slot
+    }
+    if (found != fingerprint) {
+      continue;
+    }
+    // hash compaction takes equal fingerprints for equal states
+    if (!m_numbers) {
+      return;
+    }
+    uint64_t entry;
+    while ((entry = m_numbers[slot].load(std::memory_order_acquire)) == 0) {
+      std::this_thread::yield();
+    }
+    if (std::memcmp(getRecord(entry - 1), record,
+                    m_recordWords * sizeof(uint64_t)) != 0) {
+      continue;
+    }
+    if (m_options.deterministic && getLevel(entry - 1) == level) {
+      std::atomic<uint64_t> &least = getKey(entry - 1);
+      uint64_t current = least.load(std::memory_order_relaxed);
+      while (key < current &&
+             !least.compare_exchange_weak(current, key,
+                                          std::memory_order_relaxed)) {
+      }
+    }
+    return;
+  }
+}
+
+/// Rehashes the table between levels, when no worker runs
+void ParallelExplorer::growTable(uint64_t capacity) {
+  std::unique_ptr<std::atomic<uint64_t>[]> fingerprints(
+      new std::atomic<uint64_t>[capacity]);
+  std::unique_ptr<std::atomic<uint64_t>[]> numbers;
+  if (isExact()) {
+    numbers.reset(new std::atomic<uint64_t>[capacity]);
+  }
+  for (uint64_t slot = 0; slot < capacity; ++slot) {
+    fingerprints[slot].store(0, std::memory_order_relaxed);
+    if (numbers) {
+      numbers[slot].store(0, std::memory_order_relaxed);
+    }
+  }
+  const uint64_t mask = capacity - 1;
+  for (uint64_t old = 0; old < m_capacity; ++old) {
+    const uint64_t fingerprint =
+        m_fingerprints[old].load(std::memory_order_relaxed);
+    if (fingerprint == 0) {
+      continue;
+    }
+    uint64_t slot = fingerprint & mask;
+    while (fingerprints[slot].load(std::memory_order_relaxed) != 0) {
+      slot = (slot + 1) & mask;
+    }
+    fingerprints[slot].store(fingerprint, std::memory_order_relaxed);
+    if (numbers) {
+      numbers[slot].store(m_numbers[old].load(std::memory_order_relaxed),
+                          std::memory_order_relaxed);
+    }
+  }
+  m_fingerprints = std::move(fingerprints);
+  m_numbers = std::move(numbers);
+  m_capacity = capacity;
+  m_sizeLimit = capacity / 2;
+}
+
+/// Grows the tables to a quarter full and inserts the deferred states,
+/// until none is deferred again. A state reached from many others may have
+/// been deferred many times, so the tables grow by what they hold rather than
+/// by the number of deferred states.
+void ParallelExplorer::insertDeferred(unsigned level) {
+  const unsigned words = m_model.getStateWords();
+  std::vector<uint64_t> states, keys;
+  for (;;) {
+    bool deferred = false;
+    for (const auto &worker : m_workers) {
+      deferred = deferred || !worker->deferredKeys.empty();
+    }
+    if (!deferred) {
+      return;
+    }
+    if (!m_bitstate) {
+      uint64_t capacity = m_capacity;
+      while (4 * m_size.load(std::memory_order_relaxed) > capacity) {
+        capacity *= 2;
+      }
+      if (capacity != m_capacity) {
+        growTable(capacity);
+      }
+    }
+    if (m_chunks) {
+      m_chunks->reserve();
+    }
+    for (unsigned id = 0; id < m_workers.size(); ++id) {
+      Worker &worker = *m_workers[id];
+      states.swap(worker.deferredStates);
+      keys.swap(worker.deferredKeys);
+      for (size_t i = 0; i < keys.size(); ++i) {
+        insert(worker, id, states.data() + i * words, keys[i], level);
+      }
+      states.clear();
+      keys.clear();
+    }
+  }
+}
+
+/// @return the states added since the last call, which form the next level
+std::vector<uint64_t> ParallelExplorer::takeAdded() {
+  std::vector<uint64_t> level;
+  for (const auto &worker : m_workers) {
+    level.insert(level.end(), worker->added.begin(), worker->added.end());
+    worker->added.clear();
+  }
+  if (m_options.deterministic) {
+    std::vector<std::pair<uint64_t, uint64_t>> keyed;
+    keyed.reserve(level.size());
+    for (uint64_t state : level) {
+      keyed.emplace_back(getKey(state).load(std::memory_order_relaxed),
+                         state);
+    }
+    std::sort(keyed.begin(), keyed.end());
+    for (size_t i = 0; i < keyed.size(); ++i) {
+      level[i] = keyed[i].second;
+    }
+  }
+  return level;
+}
+
+void ParallelExplorer::expand(Worker &worker, unsigned id,
+                              uint64_t position) {
+  const std::vector<uint64_t> &frontier = m_levels.back();
+  const bool last = m_options.maxDepth && m_depth == m_options.maxDepth;
+  getState(frontier[position], worker.state.data());
+  const uint64_t seed = getSeed(worker.state.data());
+  for (uint64_t i = 0; i < m_inputChoices.count(); ++i) {
+    drawInputs(seed, i, worker.inputs.data());
+    if (!m_model.constraint(worker.state.data(), worker.inputs.data())) {
+      continue;
+    }
+    uint64_t bads =
+        m_model.bad(worker.state.data(), worker.inputs.data()) & m_unreached;
+    for (; bads; bads &= bads - 1) {
+      Found &found = worker.found[countTrailingZeros(bads)];
+      if (!found.isBefore(position, i)) {
+        found.position = position;
+        found.input = i;
+      }
+    }
+    if (last) {
+      continue;
+    }
+    worker.next = worker.state;
+    m_model.step(worker.next.data(), worker.inputs.data());
+    for (uint64_t j = 0; j < m_stepChoices.count(); ++j) {
+      const uint64_t transition = i * m_stepChoices.count() + j;
+      worker.successor = worker.next;
+      drawStep(seed, transition, worker.successor.data());
+      insert(worker, id, worker.successor.data(), position << 32 | transition,
+             m_depth + 1);
+      if (m_full.load(std::memory_order_relaxed)) {
+        return;
+      }
+    }
+  }
+}
+
+void ParallelExplorer::expandLevel(unsigned id) {
+  Worker &worker = *m_workers[id];
+  const unsigned count = m_workers.size();
+  // the own slice first, then those of the others
+  for (unsigned k = 0; k < count; ++k) {
+    Worker &victim = *m_workers[(id + k) % count];
+    for (;;) {
+      if (m_full.load(std::memory_order_relaxed)) {
+        return;
+      }
+      const uint64_t begin =
+          victim.cursor.fetch_add(chunkSize, std::memory_order_relaxed);
+      if (begin >= victim.end) {
+        break;
+      }
+      const uint64_t end = std::min(begin + chunkSize, victim.end);
+      for (uint64_t position = begin; position < end; ++position) {
+        expand(worker, id, position);
+      }
+    }
+  }
+}
+
+void ParallelExplorer::work(unsigned id) {
+  uint64_t generation = 0;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_start.wait(lock,
+                   [&] { return m_stop || m_generation != generation; });
+      if (m_stop) {
+        return;
+      }
+      generation = m_generation;
+    }
+    expandLevel(id);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (--m_running == 0) {
+      m_done.notify_one();
+    }
+  }
+}
+
+/// Splits the last level into slices and waits until the workers expanded it
+void ParallelExplorer::runLevel() {
+  const uint64_t size = m_levels.back().size();
+  const unsigned count = m_workers.size();
+  for (unsigned id = 0; id < count; ++id) {
+    Worker &worker = *m_workers[id];
+    worker.cursor.store(size * id / count, std::memory_order_relaxed);
+    worker.end = size * (id + 1) / count;
+    worker.levelEnd = worker.arena.size();
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_running = count;
+    ++m_generation;
+  }
+  m_start.notify_all();
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_done.wait(lock, [&] { return m_running == 0; });
+}
+
+/// Takes the least state and inputs of the level in which each bad holds
+void ParallelExplorer::collectCounterexamples() {
+  std::vector<uint64_t> state(m_model.getStateWords());
+  std::vector<uint64_t> inputs(m_model.getInputWords());
+  for (unsigned bad = 0; bad < m_numBads; ++bad) {
+    Found least;
+    for (const auto &worker : m_workers) {
+      const Found &found = worker->found[bad];
+      if (found.isBefore(least.position, least.input)) {
+        least = found;
+      }
+      worker->found[bad] = Found();
+    }
+    if (least.position == noParent) {
+      continue;
+    }
+    const uint64_t number = m_levels.back()[least.position];
+    getState(number, state.data());
+    drawInputs(getSeed(state.data()), least.input, inputs.data());
+    setCounterexample(bad, number, inputs.data(), m_depth);
+    m_unreached &= ~(uint64_t(1) << bad);
+  }
+}
+
+bool ParallelExplorer::run() {
+  if (m_stepChoices.count() > (transitionMask + 1) / m_inputChoices.count()) {
+    WithColor::error() << "a state has more than 2^32 successors to number, "
+                          "use fewer --samples or --enumerate-bits\n";
+    return false;
+  }
+  if (m_options.deterministic && !isExact()) {
+    WithColor::error() << "--deterministic needs the full or collapse "
+                          "storage\n";
+    return false;
+  }
+  if (m_options.storage == Storage::Bitstate) {
+    if (m_options.bitstateBits < 6 || m_options.bitstateBits > 40) {
+      WithColor::error() << "--bitstate-bits must be between 6 and 40\n";
+      return false;
+    }
+    const uint64_t words = uint64_t(1) << (m_options.bitstateBits - 6);
+    m_bitstate.reset(new std::atomic<uint64_t>[words]);
+    for (uint64_t word = 0; word < words; ++word) {
+      m_bitstate[word].store(0, std::memory_order_relaxed);
+    }
+  } else {
+    growTable(uint64_t(1) << initialTableBits);
+  }
+  const unsigned maxDepth = m_options.maxDepth;
+  m_unreached = m_numBads == 64 ? ~uint64_t(0)
+                                : (uint64_t(1) << m_numBads) - 1;
+
+  // the initial states are added by the first worker, and keyed by their
+  // number
+  Worker &first = *m_workers.front();
+  for (uint64_t i = 0; i < m_initChoices.count(); ++i) {
+    drawInitial(i, first.state.data());
+    insert(first, 0, first.state.data(), i, 0);
+    if (m_full.load(std::memory_order_relaxed)) {
+      break;
+    }
+  }
+  insertDeferred(0);
+  m_levels.push_back(takeAdded());
+  m_truncated = m_full.load(std::memory_order_relaxed);
+
+  for (unsigned id = 0; id < m_workers.size(); ++id) {
+    m_threads.emplace_back([this, id] { work(id); });
+  }
+  for (m_depth = 0; !m_levels.back().empty(); ++m_depth) {
+    // positions are kept in 32 bits
+    if (m_levels.back().size() > transitionMask) {
+      m_truncated = true;
+      return true;
+    }
+    runLevel();
+    collectCounterexamples();
+    if (!isExact()) {
+      // the expanded states are rebuilt from the keys when needed
+      for (const auto &worker : m_workers) {
+        worker->arena.releaseRecords(worker->levelEnd);
+      }
+    }
+    insertDeferred(m_depth + 1);
+    m_levels.push_back(takeAdded());
+    m_truncated = m_truncated || m_full.load(std::memory_order_relaxed);
+    if (allReached() || m_truncated || (maxDepth && m_depth == maxDepth)) {
+      return true;
+    }
+  }
+  // the last depth had no new states
+  --m_depth;
+  m_exhausted = true;
+  return true;
+}
+} // namespace
+
+std::unique_ptr<Explorer>
+explore::createParallelExplorer(const Model &model, const Options &options) {
+  return std::make_unique<ParallelExplorer>(model, options);
+}
@@ -0,0 +1,235 @@
+//===- Swarm.cpp - Random walks over compiled models ----------------------===//
+//
+// This file is licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "Swarm.h"
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/WithColor.h"
+
+#include <thread>
+
+using namespace llvm;
+using namespace explore;
+
+namespace {
+
+// times a walk draws the inputs of a step again when they violate a
+// constraint, as libcex does
+constexpr unsigned constraintRetries = 100;
+
+// the biases that walks take in turn, unbiased first
+constexpr int biases[] = {0, 1, -1, 2, -2, 3, -3};
+constexpr unsigned numBiases = sizeof(biases) / sizeof(biases[0]);
+// the depth limits halve this many times before they start over
+constexpr unsigned depthHalvings = 4;
+
+/// Draws values whose bits are set with a probability of 1/2 shifted by the
+/// bias of a walk
+class BiasedRandom {
+public:
+  BiasedRandom(uint64_t seed, int bias) : m_random(seed), m_bias(bias) {}
+
+  uint64_t operator()() {
+    uint64_t value = m_random();
+    for (int i = 0; i < m_bias; ++i) {
+      value &= m_random();
+    }
+    for (int i = 0; i > m_bias; --i) {
+      value |= m_random();
+    }
+    return value;
+  }
+
+private:
+  SplitMix64 m_random;
+  int m_bias;
+};
+} // namespace
+
+Swarm::Swarm(const Model &model, const Options &options,
+             const std::string &witnessDir)
+    : m_model(model), m_options(options), m_witnessDir(witnessDir) {
+  model.getChoices(m_initChoices, m_inputChoices, m_stepChoices);
+  m_numBads = std::min(model.getNumBads(), 64u);
+  m_shortest.resize(m_numBads);
+}
+
+/// The walks take the biases in turn, and halve their depth limit every
+/// round of biases
+Swarm::Walk Swarm::getWalk(unsigned number) const {
+  Walk walk;
+  walk.number = number;
+  walk.seed = m_options.seed ^ ((number + 1) * 0xd1b54a32d192ed03ULL);
+  walk.bias = biases[number % numBiases];
+  walk.depthLimit = std::max(
+      1u, m_options.walkDepth >> (number / numBiases % depthHalvings));
+  return walk;
+}
+
+/// Steps from a random initial state until a bad holds, the depth limit is
+/// reached or no inputs satisfy the constraints
+/// @return true if a bad holds at the last frame of trace
+bool Swarm::runWalk(const Walk &walk, Trace &trace) {
+  const unsigned stateWords = m_model.getStateWords();
+  const unsigned inputWords = m_model.getInputWords();
+  BiasedRandom random(walk.seed, walk.bias);
+  std::vector<uint64_t> state(stateWords, 0), inputs(inputWords);
+  m_initChoices.draw(state.data(), random);
+  m_model.init(state.data());
+
+  trace.walk = walk;
+  trace.states.clear();
+  trace.inputs.clear();
+  uint64_t steps = 0;
+  bool reached = false;
+  for (unsigned depth = 0;; ++depth) {
+    trace.states.insert(trace.states.end(), state.begin(), state.end());
+    bool holds = false;
+    for (unsigned attempt = 0; attempt <= constraintRetries && !holds;
+         ++attempt) {
+      std::fill(inputs.begin(), inputs.end(), 0);
+      m_inputChoices.draw(inputs.data(), random);
+      holds = m_model.constraint(state.data(), inputs.data());
+    }
+    if (!holds) {
+      break;
+    }
+    trace.inputs.insert(trace.inputs.end(), inputs.begin(), inputs.end());
+    const uint64_t bads = m_model.bad(state.data(), inputs.data()) &
+                          (m_numBads == 64 ? ~uint64_t(0)
+                                           : (uint64_t(1) << m_numBads) - 1);
+    if (bads) {
+      trace.bad = countTrailingZeros(bads);
+      trace.depth = depth;
+      reached = true;
+      break;
+    }
+    if (depth == walk.depthLimit) {
+      break;
+    }
+    m_model.step(state.data(), inputs.data());
+    m_stepChoices.draw(state.data(), random);
+    ++steps;
+  }
+  m_steps.fetch_add(steps, std::memory_order_relaxed);
+  return reached;
+}
+
+/// Writes the witness of a walk that reached a bad, and keeps its trace if
+/// it is the shortest of its bad
+/// @return false if the witness could not be written
+bool Swarm::addTrace(Trace &trace) {
+  // ToolOutputFile registers its file with a signal handler, so the
+  // witnesses are written one at a time; few walks reach a bad
+  std::lock_guard<std::mutex> lock(m_mutex);
+  bool written = true;
+  if (!m_witnessDir.empty()) {
+    SmallString<128> path(m_witnessDir);
+    sys::path::append(path, "walk" + std::to_string(trace.walk.number) +
+                                ".wit");
+    std::error_code error;
+    ToolOutputFile output(path, error, sys::fs::OF_None);
+    if (error) {
+      WithColor::error() << path << ": " << error.message() << '\n';
+      written = false;
+    } else {
+      explore::writeWitness(output.os(), m_model, trace.bad, trace.depth + 1,
+                            trace.states.data(), trace.inputs.data());
+      output.keep();
+    }
+  }
+  ++m_walksReached;
+  const unsigned bad = trace.bad;
+  Trace &shortest = m_shortest[bad];
+  if (!(m_reached >> bad & 1) || trace.depth < shortest.depth ||
+      (trace.depth == shortest.depth &&
+       trace.walk.number < shortest.walk.number)) {
+    std::swap(shortest, trace);
+  }
+  m_reached |= uint64_t(1) << bad;
+  return written;
+}
+
+void Swarm::work() {
+  Trace trace;
+  for (;;) {
+    const unsigned number = m_nextWalk.fetch_add(1, std::memory_order_relaxed);
+    if (number >= m_options.walks) {
+      return;
+    }
+    {
+      // stop once every bad was reached
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (m_numBads && m_reached == (m_numBads == 64
+                                         ? ~uint64_t(0)
+                                         : (uint64_t(1) << m_numBads) - 1)) {
+        return;
+      }
+      ++m_walksRun;
+    }
+    if (runWalk(getWalk(number), trace) && !addTrace(trace)) {
+      m_failed.store(true, std::memory_order_relaxed);
+    }
+  }
+}
+
+bool Swarm::run() {
+  if (!m_witnessDir.empty()) {
+    if (std::error_code error = sys::fs::create_directories(m_witnessDir)) {
+      WithColor::error() << m_witnessDir << ": " << error.message() << '\n';
+      return false;
+    }
+  }
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < std::max(1u, m_options.threads); ++i) {
+    threads.emplace_back([this] { work(); });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  return !m_failed.load(std::memory_order_relaxed);
+}
+
+void Swarm::report(raw_ostream &os) const {
+  for (unsigned bad = 0; bad < m_numBads; ++bad) {
+    os << "bad " << bad;
+    if (bad == 63 && m_model.getNumBads() > 64) {
+      os << " to " << m_model.getNumBads() - 1;
+    }
+    const Trace &trace = m_shortest[bad];
+    if (!(m_reached >> bad & 1)) {
+      os << ": not reached\n";
+      continue;
+    }
+    os << ": reachable at depth " << trace.depth << " (walk "
+       << trace.walk.number << ", bias " << trace.walk.bias
+       << ", depth limit " << trace.walk.depthLimit << ")\n";
+  }
+  os << "walks: " << m_walksRun << " (" << m_walksReached
+     << " reached a bad)\n";
+  os << "steps: " << m_steps.load(std::memory_order_relaxed) << '\n';
+}
+
+bool Swarm::writeWitness(raw_ostream &os) const {
+  const Trace *shortest = nullptr;
+  for (unsigned bad = 0; bad < m_numBads; ++bad) {
+    if (m_reached >> bad & 1 &&
+        (!shortest || m_shortest[bad].depth < shortest->depth)) {
+      shortest = &m_shortest[bad];
+    }
+  }
+  if (!shortest) {
+    return false;
+  }
+  explore::writeWitness(os, m_model, shortest->bad, shortest->depth + 1,
+                        shortest->states.data(), shortest->inputs.data());
+  return true;
+}
@@ -0,0 +1,89 @@
+//===- Swarm.h - Random walks over compiled models --------------*- C++ -*-===//
+//
+// This file is licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// A Swarm runs many independent random walks over a Model, for models whose
+// states are too many to search. The walks differ in their seed, in the bias
+// of the values they draw and in their depth limit, so that they cover
+// different parts of the model. A walk stops at the first bad that holds,
+// and the Swarm keeps the shortest counterexample of each bad.
+//
+//===----------------------------------------------------------------------===//
+#ifndef BTOR2MLIR_EXPLORE_SWARM_H
+#define BTOR2MLIR_EXPLORE_SWARM_H
+
+#include "Explorer.h"
+
+#include <atomic>
+#include <mutex>
+#include <string>
+
+namespace explore {
+
+class Swarm {
+public:
+  /// @param witnessDir, where each walk that reaches a bad writes its
+  /// witness, or empty
+  Swarm(const Model &model, const Options &options,
+        const std::string &witnessDir);
+
+  /// @return false if a witness could not be written
+  bool run();
+
+  void report(llvm::raw_ostream &os) const;
+
+  /// Writes the shortest counterexample that a walk found
+  /// @return false if no walk reached a bad
+  bool writeWitness(llvm::raw_ostream &os) const;
+
+private:
+  /// How a walk draws its values and how far it goes
+  struct Walk {
+    unsigned number = 0;
+    uint64_t seed = 0;
+    // values are the and of 1 + bias random words if bias is positive, or
+    // the or of 1 - bias words if it is negative
+    int bias = 0;
+    unsigned depthLimit = 0;
+  };
+
+  /// The frames of a walk that reached a bad
+  struct Trace {
+    Walk walk;
+    unsigned bad = 0;
+    unsigned depth = 0;
+    std::vector<uint64_t> states;
+    std::vector<uint64_t> inputs;
+  };
+
+  Walk getWalk(unsigned number) const;
+  bool runWalk(const Walk &walk, Trace &trace);
+  bool addTrace(Trace &trace);
+  void work();
+
+  const Model &m_model;
+  const Options &m_options;
+  std::string m_witnessDir;
+  Choices m_initChoices, m_inputChoices, m_stepChoices;
+  unsigned m_numBads = 0;
+
+  std::atomic<unsigned> m_nextWalk{0};
+  std::atomic<uint64_t> m_steps{0};
+  std::atomic<bool> m_failed{false};
+
+  std::mutex m_mutex;
+  unsigned m_walksRun = 0;
+  unsigned m_walksReached = 0;
+  // the bads that some walk reached
+  uint64_t m_reached = 0;
+  // the shortest trace of each bad, if any
+  std::vector<Trace> m_shortest;
+};
+
+} // namespace explore
+
+#endif
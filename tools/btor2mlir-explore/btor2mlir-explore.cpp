@@ -0,0 +1,179 @@
+//===- btor2mlir-explore.cpp ------------------------------------*- C++ -*-===//
+//
+// This file is licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This is a command line utility that JIT compiles a BTOR2 model with the step
+// abi and searches its states breadth first, on one thread or several, or
+// runs a swarm of random walks over them. It reports which bad properties are
+// reachable, and writes the shortest counterexample as a BTOR2 witness.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/WithColor.h"
+
+#include "Explorer.h"
+#include "Swarm.h"
+
+#include <chrono>
+#include <thread>
+
+using namespace llvm;
+using namespace explore;
+
+static cl::opt<std::string> inputFilename(cl::Positional,
+                                          cl::desc("<btor2 file>"),
+                                          cl::Required);
+
+static cl::opt<std::string>
+    outputFilename("o", cl::desc("Write the shortest counterexample here"),
+                   cl::value_desc("filename"), cl::init(""));
+
+static cl::opt<unsigned>
+    maxDepth("max-depth", cl::desc("Steps to search at most (0: no bound)"),
+             cl::init(0));
+
+static cl::opt<uint64_t>
+    maxStates("max-states",
+              cl::desc("States to visit at most (0: no bound)"), cl::init(0));
+
+static cl::opt<unsigned> enumerateBits(
+    "enumerate-bits",
+    cl::desc("Enumerate the values of the inputs of a step when they have "
+             "at most this many bits, and sample them otherwise"),
+    cl::init(12));
+
+static cl::opt<unsigned>
+    samples("samples", cl::desc("Values of the inputs to sample per state"),
+            cl::init(1024));
+
+static cl::opt<uint64_t> seed("seed", cl::desc("Seed of the sampled values"),
+                              cl::init(1));
+
+static cl::opt<unsigned>
+    jobs("jobs", cl::desc("Threads to search with (0: one per hardware thread)"),
+         cl::init(1));
+
+static cl::opt<bool> deterministic(
+    "deterministic",
+    cl::desc("Report the same counterexample on every parallel search"),
+    cl::init(false));
+
+static cl::opt<Storage> storage(
+    "storage", cl::desc("How to store the visited states"),
+    cl::values(clEnumValN(Storage::Full, "full", "The packed words"),
+               clEnumValN(Storage::Collapse, "collapse",
+                          "Tuples of ids of interned chunks of words"),
+               clEnumValN(Storage::HashCompact, "hash-compact",
+                          "A 64-bit fingerprint per state (approximate)"),
+               clEnumValN(Storage::Bitstate, "bitstate",
+                          "A few bits of a fixed table per state "
+                          "(approximate)")),
+    cl::init(Storage::Full));
+
+static cl::opt<unsigned>
+    chunkWords("chunk-words",
+               cl::desc("Words per chunk with --storage=collapse"),
+               cl::init(2));
+
+static cl::opt<unsigned>
+    bitstateBits("bitstate-bits",
+                 cl::desc("Log2 of the bits of the --storage=bitstate table"),
+                 cl::init(30));
+
+static cl::opt<unsigned>
+    walks("walks",
+          cl::desc("Run this many random walks instead of a breadth first "
+                   "search (0: search)"),
+          cl::init(0));
+
+static cl::opt<unsigned>
+    walkDepth("walk-depth", cl::desc("Steps of the longest random walks"),
+              cl::init(10000));
+
+static cl::opt<std::string>
+    witnessDir("witness-dir",
+               cl::desc("Write the witness of every random walk that "
+                        "reaches a bad into this directory"),
+               cl::value_desc("directory"), cl::init(""));
+
+static cl::opt<unsigned>
+    optLevel("opt-level", cl::desc("Optimization level (0-3)"), cl::init(3));
+
+/// Runs an Explorer or a Swarm, reports its results and writes its witness
+template <typename Search> static int runSearch(Search &search) {
+  auto start = std::chrono::steady_clock::now();
+  if (!search.run()) {
+    return 1;
+  }
+  const double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+  search.report(outs());
+  outs() << "seconds: " << format("%.3f", seconds) << '\n';
+
+  if (!outputFilename.empty()) {
+    std::error_code error;
+    ToolOutputFile output(outputFilename, error, sys::fs::OF_None);
+    if (error) {
+      WithColor::error() << outputFilename << ": " << error.message() << '\n';
+      return 1;
+    }
+    if (search.writeWitness(output.os())) {
+      output.keep();
+    }
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  InitLLVM y(argc, argv);
+  cl::ParseCommandLineOptions(argc, argv,
+                              "btor2mlir explicit-state reachability\n");
+  InitializeNativeTarget();
+  InitializeNativeTargetAsmPrinter();
+
+  auto model = Model::load(inputFilename, optLevel);
+  if (!model) {
+    return 1;
+  }
+
+  Options options;
+  options.maxDepth = maxDepth;
+  options.maxStates = maxStates;
+  options.enumerateBits = enumerateBits;
+  options.samples = samples;
+  options.seed = seed;
+  // walks are independent, so they take every core unless told otherwise
+  const bool allThreads =
+      jobs.getValue() == 0 || (walks && jobs.getNumOccurrences() == 0);
+  options.threads = allThreads
+                        ? std::max(1u, std::thread::hardware_concurrency())
+                        : jobs.getValue();
+  options.deterministic = deterministic;
+  options.storage = storage;
+  options.chunkWords = chunkWords;
+  options.bitstateBits = bitstateBits;
+  options.walks = walks;
+  options.walkDepth = walkDepth;
+  if (options.walks) {
+    Swarm swarm(*model, options, witnessDir);
+    return runSearch(swarm);
+  }
+
+  // the other storages are only implemented by the parallel search, which
+  // also runs on one thread
+  auto explorer = options.threads > 1 || options.storage != Storage::Full
+                      ? createParallelExplorer(*model, options)
+                      : createSequentialExplorer(*model, options);
+  return runSearch(*explorer);
+}
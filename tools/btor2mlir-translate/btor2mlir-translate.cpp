@@ -14,14 +14,29 @@
 #include "mlir/InitAllTranslations.h"
 #include "mlir/Support/LogicalResult.h"
 #include "mlir/Translation.h"
+#include "llvm/Support/CommandLine.h"
 
 #include "Dialect/Btor/IR/Btor.h"
 #include "Target/Btor/BtorToBtorIRTranslation.h"
 #include "Target/Btor/BtorIRToBtorTranslation.h"
 
+using mlir::btor::BtorABI;
+
+static mlir::btor::ImportOptions importOptions;
+
+static llvm::cl::opt<BtorABI, true> abi(
+    "abi", llvm::cl::desc("Layout of the model built by --import-btor"),
+    llvm::cl::values(
+        clEnumValN(BtorABI::Main, "main",
+                   "a _main function that runs the model forever"),
+        clEnumValN(BtorABI::Step, "step",
+                   "init, step, bad and constraint functions over the "
+                   "states of the model")),
+    llvm::cl::location(importOptions.abi));
+
 int main(int argc, char **argv) {
   mlir::registerAllTranslations();
-  mlir::btor::registerFromBtorTranslation();
+  mlir::btor::registerFromBtorTranslation(importOptions);
   mlir::btor::registerToBtorTranslation();
   
   return failed(
@@ -0,0 +1,427 @@
+//===- btor2mlir-witness.cpp ------------------------------------*- C++ -*-===//
+//
+// This file is licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This is a command line utility that reads the trace of a counterexample run
+// linked against libcex, either as text or as a binary trace written with
+// CEX_TRACE, and writes the corresponding BTOR2 witness.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ADT/APInt.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/WithColor.h"
+
+#include "trace.h"
+
+#include <cstring>
+#include <vector>
+
+using namespace llvm;
+
+static cl::opt<std::string> inputFilename(cl::Positional,
+                                          cl::desc("<trace file>"),
+                                          cl::init("-"));
+
+static cl::opt<std::string> outputFilename("o", cl::desc("Output filename"),
+                                           cl::value_desc("filename"),
+                                           cl::init("cex.txt"));
+
+static cl::opt<bool> minimize(
+    "minimize",
+    cl::desc("Shrink the witness by replaying it on the compiled model"));
+
+static cl::opt<std::string> simulator(
+    "simulator",
+    cl::desc("The model linked with libcexreplay and libcex, for --minimize"),
+    cl::value_desc("filename"));
+
+namespace {
+// A trace without any values comes from a model without inputs or states
+// that libcex draws, so every run of it is the same. The trace does not
+// record the depth of its bad, since __TRACKER runs once per assertion rather
+// than once per step. Such witnesses get this many empty frames, as
+// witness_generator.py wrote, and btorsim finds the bad among them if it is
+// no deeper.
+constexpr unsigned emptyWitnessFrames = 21;
+
+struct Assignment {
+  uint32_t id;
+  APInt value;
+};
+
+struct ArrayAssignment {
+  uint32_t id;
+  uint64_t index;
+  APInt value;
+};
+
+struct Frame {
+  std::vector<Assignment> states;
+  std::vector<ArrayAssignment> arrays;
+  std::vector<Assignment> inputs;
+};
+
+/// Splits the values of a trace into frames: a frame ends when a state or an
+/// input that it already assigns is printed again
+class WitnessBuilder {
+public:
+  void addState(uint32_t id, APInt value) {
+    if (!seenStates.insert(id).second) {
+      nextFrame();
+      seenStates.insert(id);
+    }
+    current.states.push_back({id, std::move(value)});
+  }
+
+  void addInput(uint32_t id, APInt value) {
+    if (!seenInputs.insert(id).second) {
+      nextFrame();
+      seenInputs.insert(id);
+    }
+    current.inputs.push_back({id, std::move(value)});
+  }
+
+  void addArray(uint32_t id, uint64_t index, APInt value) {
+    current.arrays.push_back({id, index, std::move(value)});
+  }
+
+  /// Adds one 64 bit word of a value. The words of a value wider than 64
+  /// bits come one after the other, lowest first, and the value is added
+  /// with its last word.
+  /// @return false if word does not continue the value before it
+  bool addWord(cex::TraceKind kind, uint32_t id, uint64_t index, uint32_t word,
+               uint64_t bits, uint32_t width) {
+    if (word == 0) {
+      if (hasPartial) {
+        return false;
+      }
+      partial = {kind, id, index, APInt(width, 0), 0};
+      hasPartial = true;
+    } else if (!hasPartial || partial.kind != kind || partial.id != id ||
+               partial.index != index ||
+               partial.value.getBitWidth() != width ||
+               partial.nextWord != word) {
+      return false;
+    }
+    const unsigned position = word * 64;
+    if (position >= width) {
+      return false;
+    }
+    partial.value.insertBits(bits, position, std::min(64u, width - position));
+    if (++partial.nextWord * 64 < width) {
+      return true;
+    }
+    hasPartial = false;
+    if (kind == cex::TRACE_ARRAY) {
+      addArray(id, index, std::move(partial.value));
+    } else if (kind == cex::TRACE_STATE) {
+      addState(id, std::move(partial.value));
+    } else {
+      addInput(id, std::move(partial.value));
+    }
+    return true;
+  }
+
+  /// @return whether every value of the trace has all its words
+  bool isComplete() const { return !hasPartial; }
+
+  void setBad(uint32_t property) { bad = property; }
+
+  void write(raw_ostream &os) {
+    if (!current.states.empty() || !current.arrays.empty() ||
+        !current.inputs.empty()) {
+      nextFrame();
+    }
+    os << "sat\n";
+    os << 'b' << bad << '\n';
+    if (frames.empty()) {
+      for (unsigned i = 0; i < emptyWitnessFrames; ++i) {
+        os << '#' << i << "\n@" << i << '\n';
+      }
+    }
+    for (size_t i = 0; i < frames.size(); ++i) {
+      const Frame &frame = frames[i];
+      os << '#' << i << '\n';
+      for (const auto &state : frame.states) {
+        os << state.id << ' ';
+        writeBits(os, state.value);
+        os << '\n';
+      }
+      writeArrays(os, frame.arrays);
+      os << '@' << i << '\n';
+      for (const auto &input : frame.inputs) {
+        os << input.id << ' ';
+        writeBits(os, input.value);
+        os << '\n';
+      }
+    }
+    os << ".\n";
+  }
+
+private:
+  void nextFrame() {
+    frames.push_back(std::move(current));
+    // frames of one run assign the same values
+    const Frame &last = frames.back();
+    current = Frame();
+    current.states.reserve(last.states.size());
+    current.arrays.reserve(last.arrays.size());
+    current.inputs.reserve(last.inputs.size());
+    seenStates.clear();
+    seenInputs.clear();
+  }
+
+  static void writeBits(raw_ostream &os, const APInt &value) {
+    const unsigned width = value.getBitWidth();
+    SmallString<64> bits;
+    bits.resize(width);
+    if (width <= 64) {
+      uint64_t word = value.getZExtValue();
+      for (unsigned bit = 0; bit < width; ++bit, word >>= 1) {
+        bits[width - 1 - bit] = '0' + (word & 1);
+      }
+    } else {
+      for (unsigned bit = 0; bit < width; ++bit) {
+        bits[width - 1 - bit] = value[bit] ? '1' : '0';
+      }
+    }
+    os << bits;
+  }
+
+  /// The trace holds every element of an array once, so the width of the
+  /// index follows from the number of elements
+  static void writeArrays(raw_ostream &os,
+                          const std::vector<ArrayAssignment> &arrays) {
+    DenseMap<uint32_t, uint64_t> elements;
+    for (const auto &element : arrays) {
+      ++elements[element.id];
+    }
+    for (const auto &element : arrays) {
+      const unsigned indexWidth =
+          std::max(1u, Log2_64_Ceil(elements.lookup(element.id)));
+      os << element.id << " [";
+      writeBits(os, APInt(indexWidth, element.index));
+      os << "] ";
+      writeBits(os, element.value);
+      os << '\n';
+    }
+  }
+
+  struct PartialValue {
+    cex::TraceKind kind;
+    uint32_t id;
+    uint64_t index;
+    APInt value;
+    uint32_t nextWord;
+  };
+
+  std::vector<Frame> frames;
+  Frame current;
+  DenseSet<uint32_t> seenStates, seenInputs;
+  PartialValue partial;
+  bool hasPartial = false;
+  uint32_t bad = 0;
+};
+
+/// Splits the comma separated numbers of a trace line
+class FieldScanner {
+public:
+  explicit FieldScanner(StringRef line) : rest(line) {}
+
+  /// Returns the digits of the next field, or an empty string
+  StringRef next() {
+    rest = rest.ltrim(" ,");
+    const size_t length =
+        std::min(rest.find_first_not_of("0123456789"), rest.size());
+    StringRef digits = rest.take_front(length);
+    rest = rest.drop_front(length);
+    if (!rest.empty() && rest.front() != ',' && rest.front() != ' ') {
+      return StringRef();
+    }
+    return digits;
+  }
+
+  bool next(uint64_t &value) {
+    StringRef digits = next();
+    // fails if the number does not fit
+    return !digits.empty() && !digits.getAsInteger(10, value);
+  }
+
+  bool next(uint32_t &value) {
+    uint64_t wide;
+    if (!next(wide) || wide > UINT32_MAX) {
+      return false;
+    }
+    value = wide;
+    return true;
+  }
+
+  bool atEnd() const { return rest.trim().empty(); }
+
+private:
+  StringRef rest;
+};
+
+/// Reads the text that libcex prints to stdout, skipping unrelated lines
+bool readTextTrace(StringRef trace, WitnessBuilder &builder) {
+  const StringRef assertPrefix = "[sea] __VERIFIER_assert";
+  unsigned lineNumber = 0;
+  while (!trace.empty()) {
+    StringRef line;
+    std::tie(line, trace) = trace.split('\n');
+    ++lineNumber;
+    if (line.startswith(assertPrefix)) {
+      uint32_t property;
+      FieldScanner scanner(line.rsplit(':').second);
+      if (!scanner.next(property)) {
+        WithColor::error() << "line " << lineNumber
+                           << ": expected a property number\n";
+        return false;
+      }
+      builder.setBad(property);
+      continue;
+    }
+
+    StringRef kind, fields;
+    std::tie(kind, fields) = line.split(',');
+    kind = kind.trim();
+    const bool isArray = kind == "array";
+    if (!isArray && kind != "state" && kind != "input") {
+      continue;
+    }
+    FieldScanner scanner(fields);
+    uint32_t id, width, word = 0;
+    uint64_t index = 0, bits;
+    // the words of a value wider than 64 bits end with their number
+    if (!scanner.next(id) || (isArray && !scanner.next(index)) ||
+        !scanner.next(bits) || !scanner.next(width) || width == 0 ||
+        (!scanner.atEnd() && !scanner.next(word)) || !scanner.atEnd()) {
+      WithColor::error() << "line " << lineNumber << ": malformed " << kind
+                         << " value\n";
+      return false;
+    }
+    const cex::TraceKind traceKind = isArray           ? cex::TRACE_ARRAY
+                                     : kind == "state" ? cex::TRACE_STATE
+                                                       : cex::TRACE_INPUT;
+    if (!builder.addWord(traceKind, id, index, word, bits, width)) {
+      WithColor::error() << "line " << lineNumber << ": unexpected word "
+                         << word << " of " << kind << ' ' << id << '\n';
+      return false;
+    }
+  }
+  return true;
+}
+
+/// Reads the records that follow the magic of a binary trace
+bool readBinaryTrace(StringRef trace, WitnessBuilder &builder) {
+  if (trace.size() % sizeof(cex::TraceRecord) != 0) {
+    WithColor::error() << "truncated trace\n";
+    return false;
+  }
+  const size_t numRecords = trace.size() / sizeof(cex::TraceRecord);
+  for (size_t i = 0; i < numRecords; ++i) {
+    cex::TraceRecord record;
+    std::memcpy(&record, trace.data() + i * sizeof(record), sizeof(record));
+    switch (record.kind) {
+    case cex::TRACE_INPUT:
+    case cex::TRACE_STATE:
+    case cex::TRACE_ARRAY:
+      if (record.width == 0) {
+        WithColor::error() << "record " << i << ": zero width value\n";
+        return false;
+      }
+      break;
+    case cex::TRACE_LOOP:
+    case cex::TRACE_CHECKPOINT:
+    case cex::TRACE_THREAD:
+      continue;
+    case cex::TRACE_ASSERT:
+      builder.setBad(record.num);
+      continue;
+    default:
+      WithColor::error() << "record " << i << ": unknown kind "
+                         << unsigned(record.kind) << '\n';
+      return false;
+    }
+    const uint64_t index = record.kind == cex::TRACE_ARRAY ? record.index : 0;
+    if (!builder.addWord(static_cast<cex::TraceKind>(record.kind), record.num,
+                         index, record.word, record.value, record.width)) {
+      WithColor::error() << "record " << i << ": unexpected word "
+                         << record.word << " of value " << record.num << '\n';
+      return false;
+    }
+  }
+  return true;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  InitLLVM y(argc, argv);
+  cl::ParseCommandLineOptions(argc, argv,
+                              "btor2mlir counterexample witness generator\n");
+
+  if (minimize && (simulator.empty() || outputFilename == "-")) {
+    WithColor::error() << "--minimize needs a --simulator and an output file\n";
+    return 1;
+  }
+
+  auto file = MemoryBuffer::getFileOrSTDIN(inputFilename, /*IsText=*/false,
+                                           /*RequiresNullTerminator=*/false);
+  if (std::error_code error = file.getError()) {
+    WithColor::error() << inputFilename << ": " << error.message() << '\n';
+    return 1;
+  }
+  StringRef trace = (*file)->getBuffer();
+
+  WitnessBuilder builder;
+  const StringRef magic(cex::traceMagic, sizeof(cex::traceMagic));
+  const bool ok = trace.startswith(magic)
+                      ? readBinaryTrace(trace.drop_front(magic.size()), builder)
+                      : readTextTrace(trace, builder);
+  if (!ok) {
+    return 1;
+  }
+  if (!builder.isComplete()) {
+    WithColor::error() << "the trace ends within a value wider than 64 bits\n";
+    return 1;
+  }
+
+  std::error_code error;
+  ToolOutputFile output(outputFilename, error, sys::fs::OF_None);
+  if (error) {
+    WithColor::error() << outputFilename << ": " << error.message() << '\n';
+    return 1;
+  }
+  builder.write(output.os());
+  output.keep();
+  output.os().close();
+
+  if (minimize) {
+    // the simulator reads the whole witness before it writes the result
+    const StringRef args[] = {simulator, "--minimize", outputFilename,
+                              outputFilename};
+    std::string message;
+    if (sys::ExecuteAndWait(simulator, args, llvm::None, {}, 0, 0,
+                            &message) != 0) {
+      WithColor::error() << "minimization failed"
+                         << (message.empty() ? "" : ": ") << message << '\n';
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,324 @@
+//===- ebpf2mlir-run.cpp ----------------------------------------*- C++ -*-===//
+//
+// This file is licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This is a command line utility that JIT compiles an imported XDP program and
+// runs it on the packets of a pcap file, reporting the throughput and the
+// distribution of the returned verdicts.
+//
+//===----------------------------------------------------------------------===//
+
+#include "mlir/Conversion/ReconcileUnrealizedCasts/ReconcileUnrealizedCasts.h"
+#include "mlir/Dialect/Arithmetic/IR/Arithmetic.h"
+#include "mlir/Dialect/LLVMIR/LLVMDialect.h"
+#include "mlir/Dialect/StandardOps/IR/Ops.h"
+#include "mlir/ExecutionEngine/ExecutionEngine.h"
+#include "mlir/ExecutionEngine/OptUtils.h"
+#include "mlir/IR/BuiltinOps.h"
+#include "mlir/IR/MLIRContext.h"
+#include "mlir/Parser.h"
+#include "mlir/Pass/PassManager.h"
+#include "mlir/Support/FileUtilities.h"
+#include "mlir/Target/LLVMIR/Dialect/LLVMIR/LLVMToLLVMIRTranslation.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/SwapByteOrder.h"
+#include "llvm/Support/TargetSelect.h"
+
+#include "Conversion/ebpfToLLVM/ConvertebpfToLLVMPass.h"
+#include "Dialect/ebpf/IR/ebpf.h"
+#include "ebpf_runtime.h"
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace mlir;
+
+static llvm::cl::opt<std::string> inputFilename(llvm::cl::Positional,
+                                                llvm::cl::desc("<input file>"),
+                                                llvm::cl::init("-"));
+
+static llvm::cl::opt<std::string>
+    pcapFilename("pcap", llvm::cl::desc("Packets to run the program on"),
+                 llvm::cl::value_desc("filename"), llvm::cl::Required);
+
+static llvm::cl::opt<std::string> entryName(
+    "entry",
+    llvm::cl::desc("Function to run, named after its section (default: the "
+                   "first one)"),
+    llvm::cl::init(""));
+
+static llvm::cl::opt<unsigned>
+    repeat("repeat", llvm::cl::desc("Number of passes over the packets"),
+           llvm::cl::init(1));
+
+static llvm::cl::opt<unsigned>
+    optLevel("opt-level", llvm::cl::desc("Optimization level (0-3)"),
+             llvm::cl::init(3));
+
+namespace {
+constexpr size_t ebpfRegisters = 11;
+constexpr size_t ebpfStackSize = 512;
+constexpr size_t xdpHeadroom = 256;
+const std::array<const char *, 5> xdpVerdicts = {
+    "XDP_ABORTED", "XDP_DROP", "XDP_PASS", "XDP_TX", "XDP_REDIRECT"};
+
+/// The context of an XDP program; packet pointers are only 32 bits wide
+struct XdpMd {
+  uint32_t data;
+  uint32_t data_end;
+  uint32_t data_meta;
+  uint32_t ingress_ifindex;
+  uint32_t rx_queue_index;
+  uint32_t egress_ifindex;
+};
+
+/// @brief Read the packets of a pcap file
+/// @param path, packets
+/// @return false if the file is not a readable pcap file
+bool readPcap(const std::string &path, std::vector<std::string> &packets) {
+  std::ifstream file(path, std::ios::binary);
+  uint32_t header[6];
+  if (!file.read(reinterpret_cast<char *>(header), sizeof(header))) {
+    return false;
+  }
+  // microsecond and nanosecond captures, in either byte order
+  bool swap;
+  switch (header[0]) {
+  case 0xa1b2c3d4:
+  case 0xa1b23c4d:
+    swap = false;
+    break;
+  case 0xd4c3b2a1:
+  case 0x4d3cb2a1:
+    swap = true;
+    break;
+  default:
+    return false;
+  }
+  uint32_t record[4];
+  while (file.read(reinterpret_cast<char *>(record), sizeof(record))) {
+    uint32_t length = swap ? llvm::sys::getSwappedBytes(record[2]) : record[2];
+    std::string packet(length, '\0');
+    if (!file.read(packet.data(), length)) {
+      return false;
+    }
+    packets.push_back(std::move(packet));
+  }
+  return true;
+}
+
+/// Allocate memory below 4GB, so that packet addresses fit in xdp_md
+uint8_t *allocateLowMemory(size_t size) {
+#ifdef MAP_32BIT
+  void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+#else
+  void *memory = mmap(reinterpret_cast<void *>(0x10000000), size,
+                      PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1,
+                      0);
+#endif
+  if (memory == MAP_FAILED) {
+    return nullptr;
+  }
+  if (reinterpret_cast<uintptr_t>(memory) + size > (uint64_t(1) << 32)) {
+    munmap(memory, size);
+    return nullptr;
+  }
+  return static_cast<uint8_t *>(memory);
+}
+
+/// @brief Find the function to run, which takes the eleven registers. The
+/// importer names each function after its section.
+/// @param module
+/// @return the function, or a null op
+FuncOp findEntry(ModuleOp module) {
+  FuncOp entry;
+  if (!entryName.empty()) {
+    entry = module.lookupSymbol<FuncOp>(entryName);
+  } else {
+    auto funcs = module.getOps<FuncOp>();
+    if (!funcs.empty()) {
+      entry = *funcs.begin();
+    }
+  }
+  if (!entry || entry.getNumArguments() != ebpfRegisters ||
+      entry.getNumResults() != 1) {
+    return nullptr;
+  }
+  return entry;
+}
+
+llvm::orc::SymbolMap runtimeSymbols(llvm::orc::MangleAndInterner interner) {
+  llvm::orc::SymbolMap symbols;
+  auto add = [&](llvm::StringRef name, auto *function) {
+    symbols[interner(name)] = llvm::JITEvaluatedSymbol::fromPointer(function);
+  };
+  add("ebpf_map_get", &ebpf_map_get);
+  add("ebpf_helper_map_lookup_elem", &ebpf_helper_map_lookup_elem);
+  add("ebpf_helper_map_update_elem", &ebpf_helper_map_update_elem);
+  add("ebpf_helper_map_delete_elem", &ebpf_helper_map_delete_elem);
+  add("ebpf_helper_ktime_get_ns", &ebpf_helper_ktime_get_ns);
+  add("ebpf_helper_trace_printk", &ebpf_helper_trace_printk);
+  add("ebpf_helper_get_prandom_u32", &ebpf_helper_get_prandom_u32);
+  add("ebpf_helper_get_smp_processor_id", &ebpf_helper_get_smp_processor_id);
+  add("ebpf_helper_unsupported", &ebpf_helper_unsupported);
+  add("ebpf_assertion_failed", &ebpf_assertion_failed);
+  return symbols;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  llvm::InitLLVM y(argc, argv);
+  llvm::cl::ParseCommandLineOptions(argc, argv, "ebpf XDP benchmark runner\n");
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+
+  DialectRegistry registry;
+  registry.insert<ebpf::ebpfDialect, arith::ArithmeticDialect,
+                  StandardOpsDialect, LLVM::LLVMDialect>();
+  registerLLVMDialectTranslation(registry);
+  MLIRContext context(registry);
+
+  // parse the imported program
+  std::string errorMessage;
+  auto file = openInputFile(inputFilename, &errorMessage);
+  if (!file) {
+    llvm::errs() << errorMessage << "\n";
+    return 1;
+  }
+  llvm::SourceMgr sourceMgr;
+  sourceMgr.AddNewSourceBuffer(std::move(file), llvm::SMLoc());
+  OwningOpRef<ModuleOp> module(parseSourceFile(sourceMgr, &context));
+  if (!module) {
+    return 1;
+  }
+  FuncOp entry = findEntry(*module);
+  if (!entry) {
+    llvm::errs() << "no entry function taking the " << ebpfRegisters
+                 << " ebpf registers\n";
+    return 1;
+  }
+  const std::string entryFunc = entry.getName().str();
+
+  // lower against the native map runtime
+  PassManager pm(&context);
+  auto lowering = ebpf::createLowerToLLVMPass();
+  if (failed(lowering->initializeOptions("ebpf-runtime=native"))) {
+    return 1;
+  }
+  pm.addPass(std::move(lowering));
+  pm.addPass(createReconcileUnrealizedCastsPass());
+  if (failed(pm.run(*module))) {
+    return 1;
+  }
+
+  auto transformer = makeOptimizingTransformer(optLevel, 0, nullptr);
+  auto maybeEngine = ExecutionEngine::create(
+      *module, nullptr, transformer,
+      static_cast<llvm::CodeGenOpt::Level>(std::min(optLevel.getValue(), 3u)));
+  if (!maybeEngine) {
+    llvm::errs() << "failed to create the execution engine: "
+                 << llvm::toString(maybeEngine.takeError()) << "\n";
+    return 1;
+  }
+  auto &engine = maybeEngine.get();
+  engine->registerSymbols(runtimeSymbols);
+  auto maybeFunc = engine->lookup(entryFunc);
+  if (!maybeFunc) {
+    llvm::errs() << "failed to find " << entryFunc << ": "
+                 << llvm::toString(maybeFunc.takeError()) << "\n";
+    return 1;
+  }
+  auto func = maybeFunc.get();
+
+  // place every packet after the usual XDP headroom
+  std::vector<std::string> packets;
+  if (!readPcap(pcapFilename, packets)) {
+    llvm::errs() << "failed to read packets from " << pcapFilename << "\n";
+    return 1;
+  }
+  if (packets.empty()) {
+    llvm::errs() << pcapFilename << " has no packets\n";
+    return 1;
+  }
+  size_t slotSize = 0;
+  for (const auto &packet : packets) {
+    slotSize = std::max(slotSize, packet.size());
+  }
+  slotSize = (xdpHeadroom + slotSize + 63) & ~size_t(63);
+  uint8_t *arena = allocateLowMemory(slotSize * packets.size());
+  if (!arena) {
+    llvm::errs() << "failed to allocate packet memory below 4GB\n";
+    return 1;
+  }
+  std::vector<XdpMd> contexts(packets.size());
+  for (size_t i = 0; i < packets.size(); ++i) {
+    uint32_t data = static_cast<uint32_t>(
+        reinterpret_cast<uintptr_t>(arena + i * slotSize + xdpHeadroom));
+    contexts[i] = {data, data + static_cast<uint32_t>(packets[i].size()),
+                   data, 1, 0, 0};
+  }
+
+  alignas(16) static uint8_t stack[ebpfStackSize];
+  std::array<int64_t, ebpfRegisters> registers = {};
+  registers[10] = reinterpret_cast<int64_t>(stack + ebpfStackSize);
+  int64_t verdict = 0;
+  std::array<void *, ebpfRegisters + 1> args;
+  for (size_t i = 0; i < ebpfRegisters; ++i) {
+    args[i] = &registers[i];
+  }
+  args[ebpfRegisters] = &verdict;
+
+  std::array<uint64_t, xdpVerdicts.size() + 1> verdicts = {};
+  std::chrono::steady_clock::duration elapsed{};
+  for (unsigned pass = 0; pass < repeat; ++pass) {
+    // programs may rewrite packets, so every pass starts from the capture
+    for (size_t i = 0; i < packets.size(); ++i) {
+      std::memcpy(arena + i * slotSize + xdpHeadroom, packets[i].data(),
+                  packets[i].size());
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < packets.size(); ++i) {
+      registers[1] = reinterpret_cast<int64_t>(&contexts[i]);
+      func(args.data());
+      ebpf_runtime_quiesce();
+      uint64_t index = static_cast<uint64_t>(verdict);
+      verdicts[std::min<uint64_t>(index, xdpVerdicts.size())]++;
+    }
+    elapsed += std::chrono::steady_clock::now() - start;
+  }
+
+  const uint64_t total = uint64_t(packets.size()) * repeat;
+  const double seconds = std::chrono::duration<double>(elapsed).count();
+  llvm::outs() << "packets: " << total << "\n";
+  llvm::outs() << "seconds: " << llvm::format("%.6f", seconds) << "\n";
+  llvm::outs() << "packets/s: "
+               << llvm::format("%.0f", seconds > 0 ? total / seconds : 0.0)
+               << "\n";
+  for (size_t i = 0; i < verdicts.size(); ++i) {
+    if (verdicts[i] == 0) {
+      continue;
+    }
+    llvm::outs() << (i < xdpVerdicts.size() ? xdpVerdicts[i] : "other") << ": "
+                 << verdicts[i]
+                 << llvm::format(" (%.2f%%)", 100.0 * verdicts[i] / total)
+                 << "\n";
+  }
+  munmap(arena, slotSize * packets.size());
+  ebpf_runtime_reset();
+  return 0;
+}
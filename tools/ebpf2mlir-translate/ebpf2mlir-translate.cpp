@@ -15,13 +15,29 @@
 #include "mlir/Support/LogicalResult.h"
 #include "mlir/Translation.h"
 
+#include "llvm/Support/CommandLine.h"
+
 #include "Dialect/ebpf/IR/ebpf.h"
 #include "Target/ebpf/ebpfToebpfIRTranslation.h"
 
+static mlir::ebpf::ImportOptions importOptions;
+
+static llvm::cl::opt<bool, true>
+    trace("ebpf-trace",
+          llvm::cl::desc("Trace every instruction and block the ebpf "
+                         "importer builds"),
+          llvm::cl::location(importOptions.trace));
+
+static llvm::cl::opt<bool, true>
+    quiet("ebpf-quiet",
+          llvm::cl::desc("Do not print the number of instructions, blocks "
+                         "and maps that the ebpf importer builds"),
+          llvm::cl::location(importOptions.quiet));
+
 int main(int argc, char **argv) {
   mlir::registerAllTranslations();
-  mlir::ebpf::registerebpfTranslation();
-  mlir::ebpf::registerebpfMemTranslation();
+  mlir::ebpf::registerebpfTranslation(importOptions);
+  mlir::ebpf::registerebpfMemTranslation(importOptions);
 
   return failed(
       mlir::mlirTranslateMain(argc, argv, "MLIR Translation Testing Tool"));
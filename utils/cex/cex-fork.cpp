@@ -0,0 +1,27 @@
+//===- cex-fork.cpp - Fork server for fuzzing a model ---------------------===//
+//
+// This file is licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Provides the main function of a fork server binary, linked with the lowered
+// model and libcex:
+//
+//   clang++ model.ll libcexfork.a libcex.a -o model-fork
+//   afl-fuzz -i seeds -o findings -- ./model-fork @@
+//   afl-fuzz -i seeds -o findings -- ./model-fork --persistent=1000 @@
+//
+// Test inputs have the layout of libfuzz inputs, and also hold the values of
+// the initial states. --max-steps needs a model lowered with checkpoints.
+//
+//===----------------------------------------------------------------------===//
+
+#include "cex.h"
+
+extern "C" void _main(void);
+
+int main(int argc, char **argv) {
+  return cex_fork_server(argc, argv, _main);
+}
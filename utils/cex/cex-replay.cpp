@@ -0,0 +1,54 @@
+//===- cex-replay.cpp - Validate BTOR2 witnesses against a model ---------===//
+//
+// This file is licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Provides the main function of a replay binary, linked with the lowered
+// model and libcex:
+//
+//   clang++ model.ll libcexreplay.a libcex.a -o model-replay
+//   ./model-replay witness1.txt witness2.txt ...
+//   ./model-replay --minimize witness.txt minimal.txt
+//   ./model-replay --state trace.bin 1000
+//
+// Every witness is replayed in process; the exit code is 1 if any witness
+// was rejected. --state prints the states of a step of a
+// binary trace recorded with checkpoints.
+//
+//===----------------------------------------------------------------------===//
+
+#include "cex.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+extern "C" void _main(void);
+
+int main(int argc, char **argv) {
+  if (argc > 1 && std::strcmp(argv[1], "--minimize") == 0) {
+    if (argc != 4) {
+      std::fprintf(stderr, "usage: %s --minimize <witness> <output>\n",
+                   argv[0]);
+      return 1;
+    }
+    return cex_minimize(argv[2], argv[3], _main);
+  }
+  if (argc > 1 && std::strcmp(argv[1], "--state") == 0) {
+    if (argc != 4) {
+      std::fprintf(stderr, "usage: %s --state <trace> <step>\n", argv[0]);
+      return 1;
+    }
+    return cex_reconstruct(argv[2], std::strtoull(argv[3], nullptr, 0), _main);
+  }
+  int rejected = 0;
+  for (int i = 1; i < argc; ++i) {
+    rejected += cex_replay(argv[i], _main);
+  }
+  std::fprintf(stderr, "[cex] %d of %d witnesses confirmed\n",
+               argc - 1 - rejected, argc - 1);
+  return rejected != 0;
+}
@@ -0,0 +1,53 @@
+//===- cex-trace.cpp - Print a binary libcex trace as text ---------------===//
+//
+// This file is licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Usage: cex-trace [trace file]
+//
+// Reads a trace written with CEX_TRACE, or from stdin, and prints the lines
+// that libcex prints when tracing to stdout.
+//
+//===----------------------------------------------------------------------===//
+
+#include "trace.h"
+
+#include <cstdio>
+#include <cstring>
+
+int main(int argc, char **argv) {
+  std::FILE *in = stdin;
+  if (argc > 1) {
+    in = std::fopen(argv[1], "rb");
+    if (!in) {
+      std::fprintf(stderr, "cex-trace: unable to open %s\n", argv[1]);
+      return 1;
+    }
+  }
+
+  char magic[sizeof(cex::traceMagic)];
+  if (std::fread(magic, 1, sizeof(magic), in) != sizeof(magic) ||
+      std::memcmp(magic, cex::traceMagic, sizeof(magic)) != 0) {
+    std::fprintf(stderr, "cex-trace: not a libcex trace\n");
+    return 1;
+  }
+
+  static cex::TraceRecord records[4096];
+  char line[cex::traceLineSize];
+  size_t size;
+  while ((size = std::fread(records, sizeof(records[0]), 4096, in)) > 0) {
+    for (size_t i = 0; i < size; ++i) {
+      const int length = cex::formatTraceRecord(records[i], line);
+      if (length == 0) {
+        std::fprintf(stderr, "cex-trace: unknown record kind %u\n",
+                     records[i].kind);
+        return 1;
+      }
+      std::fwrite(line, 1, length, stdout);
+    }
+  }
+  return 0;
+}
@@ -1,53 +1,598 @@
 #include "cex.h"
+#include "forkserver.h"
+#include "replay.h"
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
 #include <cstdlib>
-#include <ctime>
+#include <cstring>
 #include <iostream>
+#include <mutex>
+#include <random>
+#include <vector>
+
+namespace {
+
+// Nondeterministic values come from a per-thread xoshiro256** generator.
+// All threads derive their state from one seed, taken from --seed or
+// CEX_SEED, so that runs can be repeated: the generator of the thread with
+// index i is the generator of the seed advanced by i jumps of 2^128 values,
+// so the sequences of the threads do not overlap. Threads are numbered in
+// the order in which they first draw or trace, from --thread (CEX_THREAD)
+// on, and the trace names the thread of its records, so that the values of
+// one thread are drawn again by a run with the same seed and that thread
+// index. With --record (CEX_RECORD) every drawn value is appended to a
+// binary file, and with --replay (CEX_REPLAY) the values are read back from
+// such a file instead of being generated.
+
+constexpr char recordMagic[8] = {'C', 'E', 'X', 'N', 'D', 0, 0, 1};
+
+uint64_t splitmix64(uint64_t &x) {
+  uint64_t z = (x += 0x9e3779b97f4a7c15);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+  return z ^ (z >> 31);
+}
+
+uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+struct Xoshiro256 {
+  explicit Xoshiro256(uint64_t seed) {
+    for (auto &word : s) {
+      word = splitmix64(seed);
+    }
+  }
+
+  uint64_t next() {
+    const uint64_t result = rotl(s[1] * 5, 7) * 9;
+    const uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+  }
+
+  /// Advances the generator by 2^128 values
+  void jump() {
+    static constexpr uint64_t polynomial[] = {
+        0x180ec6d33cfd0aba, 0xd5a61266f0c9392c, 0xa9582618e03fc9aa,
+        0x39abdc4529b1661c};
+    uint64_t jumped[4] = {0, 0, 0, 0};
+    for (const uint64_t word : polynomial) {
+      for (int bit = 0; bit < 64; ++bit) {
+        if (word & (uint64_t(1) << bit)) {
+          for (int i = 0; i < 4; ++i) {
+            jumped[i] ^= s[i];
+          }
+        }
+        next();
+      }
+    }
+    std::copy(jumped, jumped + 4, s);
+  }
+
+  uint64_t s[4];
+};
+
+struct NDSource {
+  std::once_flag configured;
+  uint64_t seed = 0;
+  bool hasSeed = false;
+  std::FILE *record = nullptr;
+  std::FILE *replay = nullptr;
+  std::mutex fileMutex;
+};
+
+NDSource g_nd;
+
+// the index of the first thread, and of the next thread to be numbered
+std::atomic<uint64_t> g_nextThread{0};
+std::once_flag g_threadsConfigured;
+
+// The arguments of the process. glibc and dyld pass them to the
+// constructors of a library, so the flags of libcex work with any main.
+int g_argc = 0;
+char **g_argv = nullptr;
+
+__attribute__((constructor)) void saveArguments(int argc, char **argv) {
+  g_argc = argc;
+  g_argv = argv;
+}
+
+/// @return the value of the flag, such as "--seed=", in the arguments, or
+/// else the value of the environment variable
+const char *getOption(int argc, char **argv, const char *flag,
+                      const char *variable) {
+  const size_t length = std::strlen(flag);
+  for (int i = 1; i < argc; ++i) {
+    if (std::strncmp(argv[i], flag, length) == 0) {
+      return argv[i] + length;
+    }
+  }
+  return std::getenv(variable);
+}
+
+void configureThreads(int argc, char **argv) {
+  std::call_once(g_threadsConfigured, [&] {
+    if (const char *first = getOption(argc, argv, "--thread=", "CEX_THREAD")) {
+      g_nextThread = std::strtoull(first, nullptr, 0);
+    }
+  });
+}
+
+/// @return the index of the calling thread
+uint64_t threadIndex() {
+  configureThreads(g_argc, g_argv);
+  thread_local const uint64_t index = g_nextThread++;
+  return index;
+}
+
+/// @return the generator of the values of thread
+Xoshiro256 threadGenerator(uint64_t thread) {
+  Xoshiro256 generator(g_nd.seed);
+  for (uint64_t i = 0; i < thread; ++i) {
+    generator.jump();
+  }
+  return generator;
+}
+
+struct NDOptions {
+  NDOptions(int argc, char **argv)
+      : seed(getOption(argc, argv, "--seed=", "CEX_SEED")),
+        record(getOption(argc, argv, "--record=", "CEX_RECORD")),
+        replay(getOption(argc, argv, "--replay=", "CEX_REPLAY")) {}
+
+  const char *seed;
+  const char *record;
+  const char *replay;
+};
+
+void closeFiles() {
+  if (g_nd.record) {
+    std::fclose(g_nd.record);
+    g_nd.record = nullptr;
+  }
+  if (g_nd.replay) {
+    std::fclose(g_nd.replay);
+    g_nd.replay = nullptr;
+  }
+}
+
+void openRecord(const char *path) {
+  g_nd.record = std::fopen(path, "wb");
+  if (!g_nd.record) {
+    std::cerr << "[cex] unable to record to " << path << "\n";
+    exit(1);
+  }
+  std::fwrite(recordMagic, 1, sizeof(recordMagic), g_nd.record);
+  std::fwrite(&g_nd.seed, sizeof(g_nd.seed), 1, g_nd.record);
+}
+
+void openReplay(const char *path) {
+  g_nd.replay = std::fopen(path, "rb");
+  char magic[sizeof(recordMagic)];
+  uint64_t seed;
+  if (!g_nd.replay ||
+      std::fread(magic, 1, sizeof(magic), g_nd.replay) != sizeof(magic) ||
+      std::memcmp(magic, recordMagic, sizeof(magic)) != 0 ||
+      std::fread(&seed, sizeof(seed), 1, g_nd.replay) != 1) {
+    std::cerr << "[cex] " << path << " is not a recording of nd values\n";
+    exit(1);
+  }
+  // values drawn past the end of the recording continue its sequence
+  if (!g_nd.hasSeed) {
+    g_nd.seed = seed;
+    g_nd.hasSeed = true;
+  }
+}
+
+void setup(const NDOptions &options) {
+  if (options.seed) {
+    g_nd.seed = std::strtoull(options.seed, nullptr, 0);
+    g_nd.hasSeed = true;
+  }
+  if (options.replay) {
+    openReplay(options.replay);
+  }
+  if (!g_nd.hasSeed) {
+    std::random_device device;
+    g_nd.seed = (uint64_t(device()) << 32) | device();
+    // report the seed, so that the run can be repeated
+    std::cerr << "[cex] seed: " << g_nd.seed << "\n";
+  }
+  if (options.record) {
+    openRecord(options.record);
+  }
+  std::atexit(closeFiles);
+}
+
+uint64_t drawValue() {
+  std::call_once(g_nd.configured, [] { setup(NDOptions(g_argc, g_argv)); });
+  if (g_nd.replay || g_nd.record) {
+    // recordings are one sequence for the whole process
+    static Xoshiro256 shared = threadGenerator(threadIndex());
+    std::lock_guard<std::mutex> lock(g_nd.fileMutex);
+    uint64_t value;
+    if (!g_nd.replay ||
+        std::fread(&value, sizeof(value), 1, g_nd.replay) != 1) {
+      value = shared.next();
+    }
+    if (g_nd.record) {
+      std::fwrite(&value, sizeof(value), 1, g_nd.record);
+    }
+    return value;
+  }
+  thread_local Xoshiro256 generator = threadGenerator(threadIndex());
+  return generator.next();
+}
+
+// The print hooks append fixed size records to a per-thread buffer, which
+// is written out in blocks when it fills up and when the thread or the
+// process exits. The records of a step that is retried, because its values
+// violate a constraint, are dropped from the buffer. With --trace
+// (CEX_TRACE) the records go to a binary file that cex-trace decodes;
+// otherwise they are printed to stdout as text.
+
+constexpr size_t traceBlock = 4096;
+
+struct TraceBuffer;
+
+struct TraceSink {
+  std::once_flag configured;
+  std::FILE *file = nullptr;
+  bool binary = false;
+  // record the states every checkpointInterval steps, if not zero
+  uint64_t checkpointInterval = 0;
+  // the attempts of a step that may violate a constraint
+  uint64_t retryLimit = 100;
+  std::mutex mutex;
+  std::vector<TraceBuffer *> buffers;
+  // the thread of the records written last, named by a thread record
+  // whenever it changes
+  uint64_t thread = 0;
+};
+
+TraceSink g_trace;
+
+void writeRecords(uint64_t thread, const cex::TraceRecord *records,
+                  size_t size) {
+  const bool switched = thread != g_trace.thread;
+  const cex::TraceRecord marker = {cex::TRACE_THREAD, {}, 0, 0, 0, 0, thread};
+  g_trace.thread = thread;
+  if (g_trace.binary) {
+    if (switched) {
+      std::fwrite(&marker, sizeof(marker), 1, g_trace.file);
+    }
+    std::fwrite(records, sizeof(*records), size, g_trace.file);
+  } else {
+    static char text[(traceBlock + 1) * cex::traceLineSize];
+    size_t length = switched ? cex::formatTraceRecord(marker, text) : 0;
+    for (size_t i = 0; i < size; ++i) {
+      length += cex::formatTraceRecord(records[i], text + length);
+    }
+    std::fwrite(text, 1, length, g_trace.file);
+  }
+  std::fflush(g_trace.file);
+}
+
+struct TraceBuffer {
+  TraceBuffer() {
+    std::lock_guard<std::mutex> lock(g_trace.mutex);
+    g_trace.buffers.push_back(this);
+  }
+
+  ~TraceBuffer() {
+    std::lock_guard<std::mutex> lock(g_trace.mutex);
+    flushLocked();
+    auto &buffers = g_trace.buffers;
+    buffers.erase(std::remove(buffers.begin(), buffers.end(), this),
+                  buffers.end());
+  }
+
+  void flushLocked() {
+    if (size > 0 && g_trace.file) {
+      writeRecords(thread, records, size);
+    }
+    size = 0;
+    hasMark = false;
+  }
+
+  void flush() {
+    std::lock_guard<std::mutex> lock(g_trace.mutex);
+    flushLocked();
+  }
+
+  /// Makes room for a record, keeping the records after the mark, which a
+  /// retried step may still drop
+  void flushBeforeMark() {
+    if (!hasMark || mark == 0) {
+      hasMark = false;
+      flush();
+      return;
+    }
+    std::lock_guard<std::mutex> lock(g_trace.mutex);
+    if (g_trace.file) {
+      writeRecords(thread, records, mark);
+    }
+    std::copy(records + mark, records + size, records);
+    size -= mark;
+    mark = 0;
+  }
+
+  const uint64_t thread = threadIndex();
+  cex::TraceRecord records[traceBlock];
+  size_t size = 0;
+  // the records of the current step begin at mark
+  size_t mark = 0;
+  bool hasMark = false;
+};
+
+void closeTrace() {
+  std::lock_guard<std::mutex> lock(g_trace.mutex);
+  for (TraceBuffer *buffer : g_trace.buffers) {
+    buffer->flushLocked();
+  }
+  if (g_trace.file && g_trace.binary) {
+    std::fclose(g_trace.file);
+  }
+  g_trace.file = nullptr;
+}
+
+void setupTrace(int argc, char **argv) {
+  const char *path = getOption(argc, argv, "--trace=", "CEX_TRACE");
+  const char *checkpointInterval =
+      getOption(argc, argv, "--checkpoint=", "CEX_CHECKPOINT");
+  const char *retryLimit = getOption(argc, argv, "--retries=", "CEX_RETRIES");
+  if (checkpointInterval) {
+    g_trace.checkpointInterval = std::strtoull(checkpointInterval, nullptr, 0);
+  }
+  if (retryLimit) {
+    g_trace.retryLimit = std::strtoull(retryLimit, nullptr, 0);
+  }
+  if (path) {
+    g_trace.file = std::fopen(path, "wb");
+    if (!g_trace.file) {
+      std::cerr << "[cex] unable to trace to " << path << "\n";
+      exit(1);
+    }
+    g_trace.binary = true;
+    std::fwrite(cex::traceMagic, 1, sizeof(cex::traceMagic), g_trace.file);
+  } else {
+    g_trace.file = stdout;
+  }
+  std::atexit(closeTrace);
+}
+
+void configureTrace() {
+  std::call_once(g_trace.configured, [] { setupTrace(g_argc, g_argv); });
+}
+
+TraceBuffer &traceBuffer() {
+  configureTrace();
+  thread_local TraceBuffer buffer;
+  return buffer;
+}
+
+// the step of the model run by this thread
+thread_local uint64_t t_step = 0;
+// the attempts at the current step, and whether the step is being retried
+thread_local uint64_t t_retries = 0;
+thread_local bool t_retrying = false;
+thread_local bool t_stepRetried = false;
+
+void trace(cex::TraceKind kind, uint32_t num, uint32_t index, uint64_t value,
+           uint32_t width, uint16_t word = 0) {
+  if (cex::forkActive()) {
+    return;
+  }
+  if (cex::replayActive()) {
+    // only the lowest word of a value stands for its draw
+    if (word == 0) {
+      cex::replayRecord(kind, num, index, value, width);
+    }
+    return;
+  }
+  TraceBuffer &buffer = traceBuffer();
+  if (buffer.size == traceBlock) {
+    buffer.flushBeforeMark();
+  }
+  buffer.records[buffer.size++] = {kind, {}, word, num, width, index, value};
+}
+
+/// Text printed directly to stdout must come after the buffered records
+void flushTrace() { traceBuffer().flush(); }
+
+} // namespace
+
+// The coverage counters of a model lowered with convert-btor-to-llvm=coverage
+extern "C" uint8_t btor2mlir_coverage[] __attribute__((weak));
+extern "C" const uint64_t btor2mlir_coverage_size __attribute__((weak));
+
+namespace {
+
+void reportCoverage() {
+  const uint64_t size = btor2mlir_coverage_size;
+  const uint64_t covered =
+      std::count_if(btor2mlir_coverage, btor2mlir_coverage + size,
+                    [](uint8_t counter) { return counter != 0; });
+  std::cerr << "[cex] coverage: " << covered << " of " << size
+            << " counters\n";
+}
+
+/// With CEX_COVERAGE, report at exit how many coverage counters were hit
+struct CoverageReport {
+  CoverageReport() {
+    if (&btor2mlir_coverage_size && std::getenv("CEX_COVERAGE")) {
+      std::atexit(reportCoverage);
+    }
+  }
+} g_coverageReport;
+
+} // namespace
 
 extern "C" {
-// extern void _main(void);
 
-// int LLVMFuzzerTestOneInput(const uint8_t *Data, size_t Size) {
-//   _main();
-//   return 0;  // Values other than 0 and -1 are reserved for future use.
-// }
+void cex_configure(int argc, char **argv) {
+  configureThreads(argc, argv);
+  std::call_once(g_trace.configured, [&] { setupTrace(argc, argv); });
+  std::call_once(g_nd.configured, [&] { setup(NDOptions(argc, argv)); });
+}
 
 int nd_bv32() {
-  // use current time as seed for random generator
-  std::srand(std::time(nullptr));
-  int random_value = std::rand();
-  return random_value;
+  if (cex::forkActive()) {
+    return static_cast<int>(cex::forkDraw(sizeof(uint32_t)));
+  }
+  if (cex::replayActive()) {
+    return static_cast<int>(cex::replayDraw());
+  }
+  return static_cast<int>(drawValue());
 }
 
-void __TRACKER() {
-  std::cout << "finished another loop" << std::endl;
+int64_t nd_64() {
+  if (cex::forkActive()) {
+    return static_cast<int64_t>(cex::forkDraw(sizeof(uint64_t)));
+  }
+  if (cex::replayActive()) {
+    return static_cast<int64_t>(cex::replayDraw());
+  }
+  return static_cast<int64_t>(drawValue());
 }
 
+void __TRACKER() { trace(cex::TRACE_LOOP, 0, 0, 0, 0); }
+
 void __SEA_assume(bool x) {
   if (!x) {
+    if (cex::forkActive()) {
+      cex::forkEndTest();
+    }
+    if (cex::replayActive()) {
+      cex::replayStop("__SEA_assume failed");
+    }
+    flushTrace();
     std::cout << "[sea] __SEA_assume failed" << std::endl;
     exit(1);
   }
 }
 
 void __VERIFIER_error() {
+  if (cex::forkActive()) {
+    // the fuzzer sees a crash
+    std::abort();
+  }
+  if (cex::replayActive()) {
+    cex::replayStop("__VERIFIER_error was executed");
+  }
+  flushTrace();
   std::cout << "[sea] __VERIFIER_error was executed" << std::endl;
   exit(1);
 }
 
 void __VERIFIER_assert(bool x, int property) {
-  std::cout << "[sea] __VERIFIER_assert was called for property: " << property << std::endl;
+  trace(cex::TRACE_ASSERT, property, 0, 0, 0);
+}
+
+void btor2mlir_print_input_num(uint64_t num, uint64_t value, uint64_t width) {
+  trace(cex::TRACE_INPUT, num, 0, value, width);
+}
+
+void btor2mlir_print_state_num(uint64_t num, uint64_t value, uint64_t width) {
+  trace(cex::TRACE_STATE, num, 0, value, width);
+}
+
+void btor2mlir_print_array_state_num(uint64_t num, uint64_t index,
+                                     uint64_t value, uint64_t width) {
+  trace(cex::TRACE_ARRAY, num, index, value, width);
+}
+
+// Values wider than 64 bits are printed one 64 bit word at a time
+
+void btor2mlir_print_input_word(uint64_t num, uint64_t word, uint64_t value,
+                                uint64_t width) {
+  trace(cex::TRACE_INPUT, num, 0, value, width, word);
+}
+
+void btor2mlir_print_state_word(uint64_t num, uint64_t word, uint64_t value,
+                                uint64_t width) {
+  trace(cex::TRACE_STATE, num, 0, value, width, word);
 }
 
-void btor2mlir_print_input_num(unsigned num, unsigned value, unsigned width) { 
-  std::cout << "input, " << num << ", " << value << ", " << width << std::endl;
+void btor2mlir_print_array_state_word(uint64_t num, uint64_t index,
+                                      uint64_t word, uint64_t value,
+                                      uint64_t width) {
+  trace(cex::TRACE_ARRAY, num, index, value, width, word);
 }
 
-void btor2mlir_print_state_num(unsigned num, unsigned value, unsigned width) { 
-  std::cout << "state, " << num << ", " << value << ", " << width << std::endl;
+bool btor2mlir_resume(bool resumable) {
+  if (cex::forkActive()) {
+    cex::forkResume();
+    return false;
+  }
+  return cex::replayActive() && cex::replayResume(resumable);
+}
+
+uint64_t btor2mlir_resume_state(uint64_t id) {
+  return cex::replayActive() ? cex::replayResumeState(id) : 0;
 }
 
-void btor2mlir_print_array_state_num(unsigned num, unsigned index, unsigned value, unsigned width) { 
-  std::cout << "array, " << num << ", " << index << ", " << value << ", " << width << std::endl;
+bool btor2mlir_checkpoint_due() {
+  if (cex::forkActive()) {
+    return cex::forkCheckpointDue();
+  }
+  if (cex::replayActive()) {
+    return cex::replayCheckpointDue();
+  }
+  if (t_stepRetried) {
+    // the step has been counted
+    return false;
+  }
+  configureTrace();
+  const uint64_t interval = g_trace.checkpointInterval;
+  return interval && t_step++ % interval == 0;
+}
+
+void btor2mlir_print_checkpoint_num(uint64_t num, uint64_t value,
+                                    uint64_t width) {
+  // t_step has moved past the step being recorded
+  trace(cex::TRACE_CHECKPOINT, num, t_step - 1, value, width);
+  if (!cex::forkActive() && !cex::replayActive()) {
+    // the states stay in the trace if the step is retried
+    TraceBuffer &buffer = traceBuffer();
+    buffer.mark = buffer.size;
+  }
+}
+
+void btor2mlir_step_begin() {
+  if (cex::forkActive() || cex::replayActive()) {
+    return;
+  }
+  t_stepRetried = t_retrying;
+  t_retrying = false;
+  if (!t_stepRetried) {
+    TraceBuffer &buffer = traceBuffer();
+    buffer.mark = buffer.size;
+    buffer.hasMark = true;
+    t_retries = 0;
+  }
+}
+
+bool btor2mlir_retry_step() {
+  // witnesses and test inputs fix the values of every step
+  if (cex::forkActive() || cex::replayActive()) {
+    return false;
+  }
+  TraceBuffer &buffer = traceBuffer();
+  if (!buffer.hasMark || t_retries++ >= g_trace.retryLimit) {
+    return false;
+  }
+  // the values of the rejected attempt do not belong to the run
+  buffer.size = buffer.mark;
+  t_retrying = true;
+  return true;
 }
 
 bool __seahorn_get_value_i1(int ctr, bool *g_arr, int g_arr_sz) {
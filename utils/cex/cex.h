@@ -8,8 +8,52 @@
 #ifndef CEX_H
 #define CEX_H
 
+#include <cstdint>
+
 extern "C" {
 
+/// Configure libcex from the flags --seed=N, --record=FILE, --replay=FILE,
+/// --trace=FILE, --checkpoint=N and --retries=N, which take precedence over
+/// CEX_SEED, CEX_RECORD, CEX_REPLAY, CEX_TRACE, CEX_CHECKPOINT and
+/// CEX_RETRIES. Without a call, the flags are read from the arguments of the
+/// process, along with the environment, when they are first needed; a call
+/// is only needed to pass other arguments.
+extern void cex_configure(int argc, char **argv);
+extern int nd_bv32(void);
+extern int64_t nd_64(void);
+
+/// Run model on the values of the BTOR2 witness at witnessPath, and check
+/// that the claimed bad property fails at the last frame of the witness.
+/// The first replay of a model probes it to learn the order of its draws.
+/// @return 0 if the witness is confirmed, and 1 otherwise
+extern int cex_replay(const char *witnessPath, void (*model)(void));
+
+/// Shrink a witness that cex_replay confirms by delta debugging: values are
+/// set to zero, and trailing frames dropped, while model still fails the
+/// same property. The result is written to outputPath.
+/// @return 0 on success, and 1 otherwise
+extern int cex_minimize(const char *witnessPath, const char *outputPath,
+                        void (*model)(void));
+
+/// Print the states of model at the head of step, as "checkpoint" lines on
+/// stdout, from a binary trace of a run with checkpoints. The model resumes
+/// from the latest checkpoint of the trace before step if it can, and
+/// otherwise re-executes from the start on the recorded draws.
+/// @return 0 on success, and 1 otherwise
+extern int cex_reconstruct(const char *tracePath, uint64_t step,
+                           void (*model)(void));
+
+/// Run model as an AFL style fork server: the model is snapshot before its
+/// first draw, or at its first step if it was lowered with checkpoints and
+/// its init block draws nothing, and every test forks from there. Tests read
+/// all their values, initial states included, from the file named by the
+/// first argument that is not an option, or from stdin. With --persistent=N
+/// (CEX_PERSISTENT) a child runs N tests, and with --max-steps=N
+/// (CEX_MAX_STEPS) the steps are bounded, which needs a model lowered with
+/// checkpoints. Without a fork server parent, the tests run in process.
+/// @return 0 when the tests are done
+extern int cex_fork_server(int argc, char **argv, void (*model)(void));
+
 extern void __VERIFIER_error(void);
 extern void __VERIFIER_assert(bool, int property);
 
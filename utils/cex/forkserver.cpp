@@ -0,0 +1,216 @@
+//===- forkserver.cpp - AFL style fork server inside libcex ---------------===//
+//
+// This file is licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "forkserver.h"
+#include "cex.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <csetjmp>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+// The model runs until it takes its snapshot, right before it needs its
+// first value of the test or, for a model lowered with checkpoints, at its
+// first step if that comes first. A model whose init block draws values is
+// thus snapshot inside the init block, and every later value, initial or
+// not, comes from the test. There the fork server answers the requests of
+// its parent on the AFL descriptors, and every test runs in a child forked
+// from the snapshot. A test reads the values of the model from its input,
+// four bytes for nd_bv32 as libfuzz does, and ends when the input is used
+// up, an assumption fails or the step bound is reached. Steps are counted
+// at the checkpoint hooks, so the step bound needs a model lowered with
+// checkpoints. A violated property aborts. In persistent mode a child runs
+// several tests: it stops itself between them, as AFL expects, and runs the
+// model again from its entry.
+
+constexpr int forkServerControl = 198;
+constexpr int forkServerStatus = 199;
+
+struct ForkServer {
+  bool active = false;
+  // an AFL parent answered the handshake
+  bool connected = false;
+  bool forked = false;
+  // the model was lowered with checkpoints, so its steps can be counted
+  bool counted = false;
+
+  uint64_t persistent = 1;
+  uint64_t maxSteps = 0;
+  const char *inputPath = nullptr;
+
+  uint64_t tests = 0;
+  uint64_t steps = 0;
+  std::vector<uint8_t> input;
+  size_t position = 0;
+  std::jmp_buf testEnd;
+};
+
+ForkServer g_fork;
+
+bool readAll(int fd, std::vector<uint8_t> &data) {
+  uint8_t block[4096];
+  ssize_t size;
+  while ((size = read(fd, block, sizeof(block))) > 0) {
+    data.insert(data.end(), block, block + size);
+  }
+  return size == 0;
+}
+
+void startTest() {
+  g_fork.input.clear();
+  g_fork.position = 0;
+  g_fork.steps = 0;
+  if (g_fork.inputPath) {
+    const int fd = open(g_fork.inputPath, O_RDONLY);
+    if (fd < 0 || !readAll(fd, g_fork.input)) {
+      std::fprintf(stderr, "[cex] unable to read %s\n", g_fork.inputPath);
+      std::exit(1);
+    }
+    close(fd);
+  } else {
+    // AFL rewrites the same file behind stdin for every test
+    lseek(STDIN_FILENO, 0, SEEK_SET);
+    readAll(STDIN_FILENO, g_fork.input);
+  }
+}
+
+/// Answers the requests of the parent until a child is forked, which
+/// returns to run the test
+void serve() {
+  pid_t child = -1;
+  bool stopped = false;
+  for (;;) {
+    uint32_t timedOut;
+    if (read(forkServerControl, &timedOut, sizeof(timedOut)) !=
+        sizeof(timedOut)) {
+      _exit(0);
+    }
+    int status;
+    if (stopped && timedOut) {
+      // the parent killed the stopped child
+      waitpid(child, &status, 0);
+      stopped = false;
+    }
+    if (stopped) {
+      kill(child, SIGCONT);
+      stopped = false;
+    } else {
+      child = fork();
+      if (child < 0) {
+        _exit(1);
+      }
+      if (child == 0) {
+        close(forkServerControl);
+        close(forkServerStatus);
+        return;
+      }
+    }
+    if (write(forkServerStatus, &child, sizeof(child)) != sizeof(child) ||
+        waitpid(child, &status, g_fork.persistent > 1 ? WUNTRACED : 0) < 0) {
+      _exit(1);
+    }
+    stopped = WIFSTOPPED(status);
+    if (write(forkServerStatus, &status, sizeof(status)) != sizeof(status)) {
+      _exit(1);
+    }
+  }
+}
+
+void snapshot() {
+  g_fork.forked = true;
+  if (g_fork.maxSteps && !g_fork.counted) {
+    std::fprintf(stderr, "[cex] --max-steps needs a model lowered with "
+                         "checkpoints\n");
+    std::exit(1);
+  }
+  const uint32_t hello = 0;
+  g_fork.connected = write(forkServerStatus, &hello, sizeof(hello)) ==
+                     sizeof(hello);
+  if (g_fork.connected) {
+    serve();
+  }
+  startTest();
+}
+
+} // namespace
+
+bool cex::forkActive() { return g_fork.active; }
+
+uint64_t cex::forkDraw(size_t size) {
+  if (!g_fork.forked) {
+    snapshot();
+  }
+  if (g_fork.position + size > g_fork.input.size()) {
+    forkEndTest();
+  }
+  uint64_t value = 0;
+  std::memcpy(&value, g_fork.input.data() + g_fork.position, size);
+  g_fork.position += size;
+  return value;
+}
+
+void cex::forkResume() { g_fork.counted = true; }
+
+bool cex::forkCheckpointDue() {
+  if (!g_fork.forked) {
+    snapshot();
+  }
+  if (g_fork.maxSteps && g_fork.steps++ >= g_fork.maxSteps) {
+    forkEndTest();
+  }
+  return false;
+}
+
+void cex::forkEndTest() { std::longjmp(g_fork.testEnd, 1); }
+
+extern "C" int cex_fork_server(int argc, char **argv, void (*model)(void)) {
+  const char *persistent = std::getenv("CEX_PERSISTENT");
+  const char *maxSteps = std::getenv("CEX_MAX_STEPS");
+  for (int i = 1; i < argc; ++i) {
+    if (std::strncmp(argv[i], "--persistent=", 13) == 0) {
+      persistent = argv[i] + 13;
+    } else if (std::strncmp(argv[i], "--max-steps=", 12) == 0) {
+      maxSteps = argv[i] + 12;
+    } else if (std::strncmp(argv[i], "--", 2) != 0) {
+      g_fork.inputPath = argv[i];
+    }
+  }
+  if (persistent) {
+    g_fork.persistent = std::max<uint64_t>(1, std::strtoull(persistent,
+                                                            nullptr, 0));
+  }
+  if (maxSteps) {
+    g_fork.maxSteps = std::strtoull(maxSteps, nullptr, 0);
+  }
+
+  g_fork.active = true;
+  g_fork.tests = 0;
+  // every test ends here
+  if (setjmp(g_fork.testEnd) != 0) {
+    if (++g_fork.tests == g_fork.persistent) {
+      g_fork.active = false;
+      return 0;
+    }
+    if (g_fork.connected) {
+      raise(SIGSTOP);
+    }
+    startTest();
+  }
+  model();
+  g_fork.active = false;
+  return 0;
+}
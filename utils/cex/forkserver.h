@@ -0,0 +1,41 @@
+//===- forkserver.h - AFL style fork server inside libcex -------*- C++ -*-===//
+//
+// This file is licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// While cex_fork_server runs a model, the runtime hooks of libcex hand their
+// calls to the functions below: values come from the test input, and tests
+// end without tracing.
+//
+//===----------------------------------------------------------------------===//
+#ifndef CEX_FORKSERVER_H
+#define CEX_FORKSERVER_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cex {
+
+/// @return true while cex_fork_server runs a model
+bool forkActive();
+
+/// @return the next value of the test input, of size bytes
+uint64_t forkDraw(size_t size);
+
+/// Called at the entry of a model lowered with checkpoints, before it draws
+/// any value, so that its steps are counted
+void forkResume();
+
+/// Called at the head of every step of a model lowered with checkpoints
+/// @return false, as tests do not record states
+bool forkCheckpointDue();
+
+/// Ends the current test, e.g. on a failed assumption
+[[noreturn]] void forkEndTest();
+
+} // namespace cex
+
+#endif
@@ -0,0 +1,991 @@
+//===- replay.cpp - Replay of BTOR2 witnesses inside libcex ---------------===//
+//
+// This file is licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "replay.h"
+#include "cex.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+// nd_bv32 does not know which state or input it draws for; only the print
+// hook that follows each draw names it. The first replay of a model therefore
+// probes it with zero values, to learn the order in which it draws initial
+// states, inputs and the states without next of every step. Replays then
+// hand out the values of the witness in that order, and end at the first
+// violated property, which must be the claimed one at the last frame.
+
+constexpr uint64_t probeTrackerLimit = 1 << 16;
+constexpr uint64_t replayTrackerLimit = 1 << 24;
+
+struct Key {
+  uint8_t kind;
+  uint32_t id;
+  uint64_t index;
+
+  bool operator==(const Key &other) const {
+    return kind == other.kind && id == other.id && index == other.index;
+  }
+  bool operator<(const Key &other) const {
+    return std::tie(kind, id, index) <
+           std::tie(other.kind, other.id, other.index);
+  }
+};
+
+struct Entry {
+  Key key = {};
+  // the value as written in the witness, which a minimized witness repeats
+  std::string bits;
+  // nd_bv32 draws the low 32 bits of every value
+  uint32_t value = 0;
+  // width of the index as written in the witness
+  uint32_t indexWidth = 0;
+
+  bool isZero() const { return bits.find('1') == std::string::npos; }
+
+  void setZero() {
+    bits.assign(bits.size(), '0');
+    value = 0;
+  }
+
+  bool operator<(const Entry &other) const { return key < other.key; }
+};
+
+/// The assignments of one '#' or '@' block of a witness
+struct Section {
+  std::vector<Entry> listed;
+  std::vector<Entry> sorted;
+
+  uint32_t lookup(const Key &key) const {
+    auto it = std::lower_bound(
+        sorted.begin(), sorted.end(), key,
+        [](const Entry &entry, const Key &key) { return entry.key < key; });
+    // missing values are zero, as for btorsim
+    return it != sorted.end() && it->key == key ? it->value : 0;
+  }
+};
+
+struct Witness {
+  std::vector<uint32_t> bads;
+  std::vector<Section> states, inputs;
+  size_t numFrames = 0;
+};
+
+enum SectionType { SECTION_INIT, SECTION_INPUT, SECTION_STEP };
+constexpr int numSectionTypes = 3;
+
+/// The order in which a model draws the values of each kind of section
+struct Schedule {
+  void (*model)(void) = nullptr;
+  std::vector<Key> order[numSectionTypes];
+  bool known[numSectionTypes] = {};
+};
+
+enum Mode { MODE_OFF, MODE_PROBE, MODE_REPLAY, MODE_RECONSTRUCT };
+
+struct ReplayState {
+  Mode mode = MODE_OFF;
+  std::jmp_buf stop;
+  std::string reason;
+  uint64_t trackerCalls = 0;
+
+  // probing
+  SectionType section = SECTION_INIT;
+  bool started[numSectionTypes] = {};
+  std::set<Key> seen;
+  bool probed = false;
+
+  // replaying
+  const Witness *witness = nullptr;
+  size_t frame = 0;
+  size_t position = 0;
+  Key pending = {};
+  bool hasPending = false;
+  bool badFired = false;
+  uint32_t badProperty = 0;
+  bool confirmed = false;
+};
+
+Schedule g_schedule;
+ReplayState g_replay;
+
+// A trace records the values that the model draws, and the states at its
+// checkpoints. The states of any other step are recomputed: the model resumes
+// from the latest checkpoint before it, if all of its states can be set from
+// the runtime, or else starts over, and is fed the draws recorded after that
+// point until it reaches the step.
+
+struct Draw {
+  Key key;
+  uint32_t value;
+};
+
+struct Checkpoint {
+  uint64_t step = 0;
+  // the number of draws before the step
+  size_t position = 0;
+  std::map<uint64_t, uint64_t> states;
+};
+
+struct Reconstruction {
+  std::vector<Draw> draws;
+  std::map<uint64_t, Checkpoint> checkpoints;
+  uint64_t target = 0;
+
+  const Checkpoint *resumeFrom = nullptr;
+  bool resumed = false;
+  bool resuming = false;
+  bool sawCheckpoint = false;
+  bool collecting = false;
+  uint64_t step = 0;
+  size_t position = 0;
+  bool hasPending = false;
+  Key pending = {};
+  std::vector<cex::TraceRecord> states;
+};
+
+Reconstruction g_reconstruct;
+
+//===----------------------------------------------------------------------===//
+// Witness parsing
+//===----------------------------------------------------------------------===//
+
+uint64_t parseBits(const char *begin, const char *end) {
+  uint64_t value = 0;
+  for (const char *bit = std::max(begin, end - 64); bit < end; ++bit) {
+    value = (value << 1) | (*bit == '1');
+  }
+  return value;
+}
+
+bool isBits(const char *begin, const char *end) {
+  return begin < end &&
+         std::all_of(begin, end, [](char c) { return c == '0' || c == '1'; });
+}
+
+bool parseNumber(const char *begin, const char *end, uint64_t &value) {
+  if (begin == end || end - begin > 19) {
+    return false;
+  }
+  value = 0;
+  for (const char *digit = begin; digit < end; ++digit) {
+    if (*digit < '0' || *digit > '9') {
+      return false;
+    }
+    value = value * 10 + (*digit - '0');
+  }
+  return true;
+}
+
+/// Splits a line into its space separated tokens
+std::vector<std::pair<const char *, const char *>> tokenize(const char *begin,
+                                                            const char *end) {
+  std::vector<std::pair<const char *, const char *>> tokens;
+  while (begin < end) {
+    while (begin < end && (*begin == ' ' || *begin == '\t' || *begin == '\r')) {
+      ++begin;
+    }
+    const char *token = begin;
+    while (begin < end && *begin != ' ' && *begin != '\t' && *begin != '\r') {
+      ++begin;
+    }
+    if (token < begin) {
+      tokens.emplace_back(token, begin);
+    }
+  }
+  return tokens;
+}
+
+bool parseWitness(const char *data, size_t size, Witness &witness,
+                  std::string &error) {
+  const char *const end = data + size;
+  Section *section = nullptr;
+  bool inputs = false;
+  unsigned lineNumber = 0;
+  for (const char *line = data; line < end;) {
+    const char *lineEnd = static_cast<const char *>(
+        std::memchr(line, '\n', end - line));
+    if (!lineEnd) {
+      lineEnd = end;
+    }
+    ++lineNumber;
+    auto tokens = tokenize(line, lineEnd);
+    line = lineEnd + 1;
+    if (tokens.empty() || *tokens[0].first == ';') {
+      continue;
+    }
+
+    const char *first = tokens[0].first;
+    const size_t length = tokens[0].second - first;
+    uint64_t number;
+    if (length == 1 && *first == '.') {
+      break;
+    }
+    if (*first == 'b' || *first == 'j') {
+      for (auto &[begin, tokenEnd] : tokens) {
+        if (*begin == 'b' && parseNumber(begin + 1, tokenEnd, number)) {
+          witness.bads.push_back(number);
+        }
+      }
+      continue;
+    }
+    if (*first == '#' || *first == '@') {
+      if (!parseNumber(first + 1, tokens[0].second, number)) {
+        error = "line " + std::to_string(lineNumber) + ": malformed frame";
+        return false;
+      }
+      witness.numFrames = std::max<size_t>(witness.numFrames, number + 1);
+      inputs = *first == '@';
+      auto &sections = inputs ? witness.inputs : witness.states;
+      if (sections.size() <= number) {
+        sections.resize(number + 1);
+      }
+      section = &sections[number];
+      continue;
+    }
+    if (length == 3 && std::strncmp(first, "sat", 3) == 0) {
+      continue;
+    }
+
+    // <index> [<bits>] <bits> [<symbol>]
+    Entry entry;
+    entry.key = {inputs ? cex::TRACE_INPUT : cex::TRACE_STATE, 0, 0};
+    size_t valueToken = 1;
+    if (!section || tokens.size() < 2 ||
+        !parseNumber(first, tokens[0].second, number) || number > UINT32_MAX) {
+      error = "line " + std::to_string(lineNumber) + ": malformed assignment";
+      return false;
+    }
+    entry.key.id = number;
+    auto [indexBegin, indexEnd] = tokens[1];
+    if (*indexBegin == '[') {
+      if (inputs || tokens.size() < 3 || indexEnd[-1] != ']' ||
+          !isBits(indexBegin + 1, indexEnd - 1)) {
+        error = "line " + std::to_string(lineNumber) + ": malformed index";
+        return false;
+      }
+      entry.key.kind = cex::TRACE_ARRAY;
+      entry.key.index = parseBits(indexBegin + 1, indexEnd - 1);
+      entry.indexWidth = indexEnd - indexBegin - 2;
+      valueToken = 2;
+    }
+    auto [valueBegin, valueEnd] = tokens[valueToken];
+    if (!isBits(valueBegin, valueEnd)) {
+      error = "line " + std::to_string(lineNumber) + ": malformed value";
+      return false;
+    }
+    entry.bits.assign(valueBegin, valueEnd);
+    entry.value = static_cast<uint32_t>(parseBits(valueBegin, valueEnd));
+    section->listed.push_back(entry);
+  }
+
+  if (witness.bads.empty()) {
+    error = "the witness claims no bad property";
+    return false;
+  }
+  return true;
+}
+
+/// Prepares the sections of witness for lookups, after their values changed
+void finalize(Witness &witness) {
+  witness.states.resize(witness.numFrames);
+  witness.inputs.resize(witness.numFrames);
+  for (auto *sections : {&witness.states, &witness.inputs}) {
+    for (Section &frame : *sections) {
+      frame.sorted = frame.listed;
+      std::sort(frame.sorted.begin(), frame.sorted.end());
+    }
+  }
+}
+
+bool loadWitness(const char *path, Witness &witness) {
+  const int fd = open(path, O_RDONLY);
+  struct stat status;
+  if (fd < 0 || fstat(fd, &status) != 0) {
+    std::fprintf(stderr, "[cex] unable to open %s\n", path);
+    if (fd >= 0) {
+      close(fd);
+    }
+    return false;
+  }
+  const size_t size = status.st_size;
+  void *data =
+      size ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+  close(fd);
+  if (data == MAP_FAILED) {
+    std::fprintf(stderr, "[cex] unable to map %s\n", path);
+    return false;
+  }
+
+  std::string error;
+  const bool parsed =
+      parseWitness(static_cast<const char *>(data), size, witness, error);
+  if (data) {
+    munmap(data, size);
+  }
+  if (!parsed) {
+    std::fprintf(stderr, "[cex] %s: %s\n", path, error.c_str());
+    return false;
+  }
+  finalize(witness);
+  return true;
+}
+
+void writeBits(std::FILE *out, uint64_t value, uint32_t width) {
+  for (uint32_t bit = width; bit-- > 0;) {
+    std::fputc(bit < 64 && (value >> bit) & 1 ? '1' : '0', out);
+  }
+}
+
+void writeSection(std::FILE *out, const Section &section) {
+  for (const Entry &entry : section.listed) {
+    std::fprintf(out, "%u ", entry.key.id);
+    if (entry.key.kind == cex::TRACE_ARRAY) {
+      std::fputc('[', out);
+      writeBits(out, entry.key.index, entry.indexWidth);
+      std::fputs("] ", out);
+    }
+    std::fputs(entry.bits.c_str(), out);
+    std::fputc('\n', out);
+  }
+}
+
+bool writeWitness(const char *path, const Witness &witness) {
+  std::FILE *out = std::fopen(path, "w");
+  if (!out) {
+    std::fprintf(stderr, "[cex] unable to write %s\n", path);
+    return false;
+  }
+  std::fputs("sat\n", out);
+  for (size_t i = 0; i < witness.bads.size(); ++i) {
+    std::fprintf(out, "%sb%u", i ? " " : "", witness.bads[i]);
+  }
+  std::fputc('\n', out);
+  for (size_t frame = 0; frame < witness.numFrames; ++frame) {
+    std::fprintf(out, "#%zu\n", frame);
+    writeSection(out, witness.states[frame]);
+    std::fprintf(out, "@%zu\n", frame);
+    writeSection(out, witness.inputs[frame]);
+  }
+  std::fputs(".\n", out);
+  return std::fclose(out) == 0;
+}
+
+//===----------------------------------------------------------------------===//
+// Probing
+//===----------------------------------------------------------------------===//
+
+// Nothing with a destructor may be alive between the model and a stop
+[[noreturn]] void stop() { std::longjmp(g_replay.stop, 1); }
+
+[[noreturn]] void stop(const char *reason) {
+  g_replay.reason = reason;
+  stop();
+}
+
+void startSection(SectionType type) {
+  // the section that ends now has been seen in full
+  g_schedule.known[g_replay.section] = true;
+  if (g_replay.started[type]) {
+    // both kinds of step sections are known, the one not seen is empty
+    g_schedule.known[SECTION_INPUT] = g_schedule.known[SECTION_STEP] = true;
+    g_replay.probed = true;
+    stop();
+  }
+  g_replay.started[type] = true;
+  g_replay.section = type;
+  g_replay.seen.clear();
+}
+
+void probeRecord(cex::TraceKind kind, const Key &key) {
+  const bool repeated = g_replay.seen.count(key) != 0;
+  if (kind == cex::TRACE_INPUT &&
+      (g_replay.section != SECTION_INPUT || repeated)) {
+    startSection(SECTION_INPUT);
+  } else if (kind == cex::TRACE_STATE &&
+             (g_replay.section == SECTION_INPUT || repeated)) {
+    startSection(SECTION_STEP);
+  }
+  g_schedule.order[g_replay.section].push_back(key);
+  g_replay.seen.insert(key);
+}
+
+void probe(void (*model)(void)) {
+  g_schedule = Schedule();
+  g_schedule.model = model;
+  g_replay.section = SECTION_INIT;
+  std::fill(std::begin(g_replay.started), std::end(g_replay.started), false);
+  g_replay.started[SECTION_INIT] = true;
+  g_replay.seen.clear();
+  g_replay.trackerCalls = 0;
+  g_replay.probed = false;
+  g_replay.mode = MODE_PROBE;
+  if (setjmp(g_replay.stop) == 0) {
+    model();
+  }
+  g_replay.mode = MODE_OFF;
+  if (g_replay.probed) {
+    return;
+  }
+  if (g_replay.trackerCalls >= probeTrackerLimit) {
+    // the model has stopped drawing values
+    for (bool &known : g_schedule.known) {
+      known = true;
+    }
+    return;
+  }
+  // the probe hit a bad state: the orders that it has not seen in full are
+  // taken from the witness, and checked against the print hooks
+  for (int type = 0; type < numSectionTypes; ++type) {
+    if (!g_schedule.known[type]) {
+      g_schedule.order[type].clear();
+    }
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// Replaying
+//===----------------------------------------------------------------------===//
+
+const Section &currentSection() {
+  static const Section empty;
+  const Witness &witness = *g_replay.witness;
+  if (g_replay.frame >= witness.numFrames) {
+    return empty;
+  }
+  return g_replay.section == SECTION_INPUT ? witness.inputs[g_replay.frame]
+                                           : witness.states[g_replay.frame];
+}
+
+size_t sectionSize() {
+  return g_schedule.known[g_replay.section]
+             ? g_schedule.order[g_replay.section].size()
+             : currentSection().listed.size();
+}
+
+bool isEmpty(SectionType type) {
+  return g_schedule.known[type] && g_schedule.order[type].empty();
+}
+
+void nextSection() {
+  if (isEmpty(SECTION_INPUT) && isEmpty(SECTION_STEP)) {
+    stop("the model draws more values than while it was probed");
+  }
+  do {
+    if (g_replay.section == SECTION_INPUT) {
+      g_replay.section = SECTION_STEP;
+      ++g_replay.frame;
+    } else {
+      g_replay.section = SECTION_INPUT;
+    }
+  } while (isEmpty(g_replay.section));
+  g_replay.position = 0;
+  if (g_replay.frame >= g_replay.witness->numFrames) {
+    g_replay.reason = "no bad property after " +
+                      std::to_string(g_replay.witness->numFrames) + " frames";
+    stop();
+  }
+}
+
+std::string describe(const Key &key) {
+  const char *kind = key.kind == cex::TRACE_INPUT ? "input" : "state";
+  std::string text = std::string(kind) + " " + std::to_string(key.id);
+  if (key.kind == cex::TRACE_ARRAY) {
+    text += "[" + std::to_string(key.index) + "]";
+  }
+  return text;
+}
+
+[[noreturn]] void replayBad(uint32_t property) {
+  const Witness &witness = *g_replay.witness;
+  const size_t claimed = witness.numFrames - 1;
+  const bool claimedProperty =
+      std::find(witness.bads.begin(), witness.bads.end(), property) !=
+      witness.bads.end();
+  // without values drawn in every step, steps cannot be told apart
+  const bool framesKnown = !isEmpty(SECTION_INPUT) || !isEmpty(SECTION_STEP);
+  g_replay.badFired = true;
+  g_replay.badProperty = property;
+  g_replay.reason = "b" + std::to_string(property) + " fails at frame " +
+                    (framesKnown ? std::to_string(g_replay.frame) : "?");
+  if (!claimedProperty) {
+    g_replay.reason += ", which is not claimed";
+  } else if (framesKnown && g_replay.frame != claimed) {
+    g_replay.reason += ", the witness claims frame " + std::to_string(claimed);
+  } else {
+    g_replay.confirmed = true;
+  }
+  stop();
+}
+
+//===----------------------------------------------------------------------===//
+// Reconstructing
+//===----------------------------------------------------------------------===//
+
+bool loadTrace(const char *path, Reconstruction &trace) {
+  std::FILE *in = std::fopen(path, "rb");
+  if (!in) {
+    std::fprintf(stderr, "[cex] unable to open %s\n", path);
+    return false;
+  }
+  char magic[sizeof(cex::traceMagic)];
+  if (std::fread(magic, sizeof(magic), 1, in) != 1 ||
+      std::memcmp(magic, cex::traceMagic, sizeof(magic)) != 0) {
+    std::fprintf(stderr, "[cex] %s: not a binary trace\n", path);
+    std::fclose(in);
+    return false;
+  }
+  cex::TraceRecord record;
+  while (std::fread(&record, sizeof(record), 1, in) == 1) {
+    switch (record.kind) {
+    case cex::TRACE_INPUT:
+    case cex::TRACE_STATE:
+    case cex::TRACE_ARRAY: {
+      // the higher words of a wide value are not drawn
+      if (record.word != 0) {
+        break;
+      }
+      const Key key = {record.kind, record.num,
+                       record.kind == cex::TRACE_ARRAY ? record.index : 0u};
+      trace.draws.push_back({key, static_cast<uint32_t>(record.value)});
+      break;
+    }
+    case cex::TRACE_CHECKPOINT: {
+      Checkpoint &checkpoint = trace.checkpoints[record.index];
+      checkpoint.step = record.index;
+      checkpoint.position = trace.draws.size();
+      checkpoint.states[record.num] = record.value;
+      break;
+    }
+    default:
+      break;
+    }
+  }
+  std::fclose(in);
+  return true;
+}
+
+uint32_t reconstructDraw() {
+  Reconstruction &trace = g_reconstruct;
+  if (trace.collecting) {
+    stop();
+  }
+  if (trace.resuming) {
+    // the values that the model draws before it is resumed are not used
+    return 0;
+  }
+  if (trace.position >= trace.draws.size()) {
+    g_replay.reason =
+        trace.sawCheckpoint
+            ? "the trace ends before step " + std::to_string(trace.target)
+            : "the model was not lowered with checkpoints";
+    stop();
+  }
+  const Draw &draw = trace.draws[trace.position++];
+  trace.pending = draw.key;
+  trace.hasPending = true;
+  return draw.value;
+}
+
+void reconstructRecord(cex::TraceKind kind, const Key &key, uint64_t value,
+                       uint32_t width) {
+  Reconstruction &trace = g_reconstruct;
+  if (kind == cex::TRACE_CHECKPOINT) {
+    if (trace.collecting) {
+      trace.states.push_back({cex::TRACE_CHECKPOINT, {}, 0, key.id, width,
+                              static_cast<uint32_t>(trace.target), value});
+    }
+    return;
+  }
+  if (trace.collecting) {
+    stop();
+  }
+  switch (kind) {
+  case cex::TRACE_INPUT:
+  case cex::TRACE_STATE:
+  case cex::TRACE_ARRAY:
+    if (trace.resuming) {
+      break;
+    }
+    if (!trace.hasPending || !(trace.pending == key)) {
+      g_replay.reason =
+          "the model draws " + describe(key) + " where the trace has " +
+          (trace.hasPending ? describe(trace.pending) : "nothing");
+      stop();
+    }
+    trace.hasPending = false;
+    break;
+  case cex::TRACE_LOOP:
+    if (++g_replay.trackerCalls >= replayTrackerLimit) {
+      stop("the model stops drawing values");
+    }
+    break;
+  case cex::TRACE_ASSERT:
+    g_replay.reason = "b" + std::to_string(key.id) + " fails before step " +
+                      std::to_string(trace.target);
+    stop();
+  default:
+    break;
+  }
+}
+
+bool reconstructCheckpointDue() {
+  Reconstruction &trace = g_reconstruct;
+  if (trace.collecting) {
+    stop();
+  }
+  trace.sawCheckpoint = true;
+  if (trace.resuming) {
+    trace.resuming = false;
+    trace.position = trace.resumeFrom->position;
+    trace.step = trace.resumeFrom->step;
+  }
+  if (trace.step++ == trace.target) {
+    trace.collecting = true;
+    return true;
+  }
+  return false;
+}
+
+} // namespace
+
+bool cex::replayActive() { return g_replay.mode != MODE_OFF; }
+
+uint32_t cex::replayDraw() {
+  if (g_replay.mode == MODE_PROBE) {
+    return 0;
+  }
+  if (g_replay.mode == MODE_RECONSTRUCT) {
+    return reconstructDraw();
+  }
+  while (g_replay.position >= sectionSize()) {
+    nextSection();
+  }
+  const Section &section = currentSection();
+  const size_t position = g_replay.position++;
+  uint32_t value;
+  if (g_schedule.known[g_replay.section]) {
+    g_replay.pending = g_schedule.order[g_replay.section][position];
+    value = section.lookup(g_replay.pending);
+  } else {
+    g_replay.pending = section.listed[position].key;
+    value = section.listed[position].value;
+  }
+  g_replay.hasPending = true;
+  return value;
+}
+
+void cex::replayRecord(TraceKind kind, uint32_t num, uint64_t index,
+                       uint64_t value, uint32_t width) {
+  const Key key = {kind, num, kind == TRACE_ARRAY ? index : 0};
+  if (g_replay.mode == MODE_RECONSTRUCT) {
+    reconstructRecord(kind, key, value, width);
+    return;
+  }
+  switch (kind) {
+  case TRACE_INPUT:
+  case TRACE_STATE:
+  case TRACE_ARRAY:
+    if (g_replay.mode == MODE_PROBE) {
+      probeRecord(kind, key);
+    } else if (!g_replay.hasPending || !(g_replay.pending == key)) {
+      g_replay.reason =
+          "the model draws " + describe(key) + " where the witness has " +
+          (g_replay.hasPending ? describe(g_replay.pending) : "nothing");
+      stop();
+    }
+    g_replay.hasPending = false;
+    break;
+  case TRACE_LOOP:
+    if (++g_replay.trackerCalls >= (g_replay.mode == MODE_PROBE
+                                        ? probeTrackerLimit
+                                        : replayTrackerLimit)) {
+      stop("the model stops drawing values");
+    }
+    break;
+  case TRACE_ASSERT:
+    if (g_replay.mode == MODE_PROBE) {
+      stop("bad state while probing");
+    }
+    replayBad(num);
+  case TRACE_CHECKPOINT:
+  case TRACE_THREAD:
+    break;
+  }
+}
+
+bool cex::replayResume(bool resumable) {
+  if (g_replay.mode != MODE_RECONSTRUCT || !resumable ||
+      !g_reconstruct.resumeFrom) {
+    return false;
+  }
+  g_reconstruct.resumed = g_reconstruct.resuming = true;
+  return true;
+}
+
+uint64_t cex::replayResumeState(uint64_t id) {
+  if (g_replay.mode != MODE_RECONSTRUCT || !g_reconstruct.resumeFrom) {
+    return 0;
+  }
+  const auto &states = g_reconstruct.resumeFrom->states;
+  auto it = states.find(id);
+  return it != states.end() ? it->second : 0;
+}
+
+bool cex::replayCheckpointDue() {
+  return g_replay.mode == MODE_RECONSTRUCT && reconstructCheckpointDue();
+}
+
+void cex::replayStop(const char *reason) { stop(reason); }
+
+namespace {
+/// Replays witness on model, leaving the outcome in g_replay
+void run(const Witness &witness, void (*model)(void)) {
+  if (g_schedule.model != model) {
+    probe(model);
+  }
+  g_replay.witness = &witness;
+  g_replay.section = SECTION_INIT;
+  g_replay.frame = 0;
+  g_replay.position = 0;
+  g_replay.hasPending = false;
+  g_replay.badFired = false;
+  g_replay.confirmed = false;
+  g_replay.trackerCalls = 0;
+  g_replay.mode = MODE_REPLAY;
+  if (setjmp(g_replay.stop) == 0) {
+    model();
+    g_replay.reason = "the model returned";
+  }
+  g_replay.mode = MODE_OFF;
+  g_replay.witness = nullptr;
+}
+
+/// The assignments that minimization may set to zero
+struct Assignment {
+  bool input;
+  size_t frame;
+  size_t position;
+};
+
+Entry &entryOf(Witness &witness, const Assignment &assignment) {
+  auto &sections = assignment.input ? witness.inputs : witness.states;
+  return sections[assignment.frame].listed[assignment.position];
+}
+
+const Entry &entryOf(const Witness &witness, const Assignment &assignment) {
+  return entryOf(const_cast<Witness &>(witness), assignment);
+}
+
+size_t countNonzero(const Witness &witness) {
+  size_t count = 0;
+  for (size_t frame = 0; frame < witness.numFrames; ++frame) {
+    for (const Section *section :
+         {&witness.states[frame], &witness.inputs[frame]}) {
+      count += std::count_if(
+          section->listed.begin(), section->listed.end(),
+          [](const Entry &entry) { return !entry.isZero(); });
+    }
+  }
+  return count;
+}
+
+/// Delta debugging of the nonzero assignments of a confirmed witness:
+/// finds a subset of them that still makes the model fail the same
+/// property, with every other assignment set to zero. A failure at an
+/// earlier frame drops the frames after it.
+class Minimizer {
+public:
+  Minimizer(const Witness &witness, void (*model)(void), uint32_t property)
+      : original(witness), model(model), property(property),
+        numFrames(witness.numFrames) {
+    for (bool input : {false, true}) {
+      const auto &sections = input ? witness.inputs : witness.states;
+      for (size_t frame = 0; frame < numFrames; ++frame) {
+        const auto &listed = sections[frame].listed;
+        for (size_t i = 0; i < listed.size(); ++i) {
+          if (!listed[i].isZero()) {
+            nonzero.push_back({input, frame, i});
+          }
+        }
+      }
+    }
+  }
+
+  Witness minimize() {
+    std::vector<Assignment> kept = nonzero;
+    size_t granularity = 2;
+    while (kept.size() >= 2) {
+      granularity = std::min(granularity, kept.size());
+      const size_t chunk = (kept.size() + granularity - 1) / granularity;
+      bool reduced = false;
+      for (size_t begin = 0; begin < kept.size() && !reduced;
+           begin += chunk) {
+        const size_t end = std::min(begin + chunk, kept.size());
+        std::vector<Assignment> subset(kept.begin() + begin,
+                                       kept.begin() + end);
+        std::vector<Assignment> complement(kept.begin(), kept.begin() + begin);
+        complement.insert(complement.end(), kept.begin() + end, kept.end());
+        if (fails(subset)) {
+          kept = std::move(subset);
+          granularity = 2;
+          reduced = true;
+        } else if (granularity > 2 && fails(complement)) {
+          kept = std::move(complement);
+          granularity = std::max<size_t>(granularity - 1, 2);
+          reduced = true;
+        }
+      }
+      if (!reduced) {
+        if (granularity == kept.size()) {
+          break;
+        }
+        granularity = std::min(granularity * 2, kept.size());
+      }
+      dropLateFrames(kept);
+    }
+    if (kept.size() == 1 && fails({})) {
+      kept.clear();
+    }
+    dropLateFrames(kept);
+    Witness result = candidate(kept);
+    result.bads = {property};
+    return result;
+  }
+
+  size_t tests = 0;
+
+private:
+  Witness candidate(const std::vector<Assignment> &kept) const {
+    Witness witness = original;
+    for (const Assignment &assignment : nonzero) {
+      entryOf(witness, assignment).setZero();
+    }
+    for (const Assignment &assignment : kept) {
+      entryOf(witness, assignment) = entryOf(original, assignment);
+    }
+    witness.numFrames = numFrames;
+    witness.states.resize(numFrames);
+    witness.inputs.resize(numFrames);
+    finalize(witness);
+    return witness;
+  }
+
+  bool fails(const std::vector<Assignment> &kept) {
+    ++tests;
+    const Witness witness = candidate(kept);
+    run(witness, model);
+    if (!g_replay.badFired || g_replay.badProperty != property) {
+      return false;
+    }
+    numFrames = std::min(numFrames, g_replay.frame + 1);
+    return true;
+  }
+
+  void dropLateFrames(std::vector<Assignment> &kept) const {
+    kept.erase(std::remove_if(kept.begin(), kept.end(),
+                              [&](const Assignment &assignment) {
+                                return assignment.frame >= numFrames;
+                              }),
+               kept.end());
+  }
+
+  const Witness &original;
+  void (*model)(void);
+  const uint32_t property;
+  size_t numFrames;
+  std::vector<Assignment> nonzero;
+};
+} // namespace
+
+extern "C" int cex_replay(const char *witnessPath, void (*model)(void)) {
+  Witness witness;
+  if (!loadWitness(witnessPath, witness)) {
+    return 1;
+  }
+  run(witness, model);
+  std::fprintf(stderr, "[cex] %s: %s: %s\n", witnessPath,
+               g_replay.confirmed ? "confirmed" : "rejected",
+               g_replay.reason.c_str());
+  return g_replay.confirmed ? 0 : 1;
+}
+
+extern "C" int cex_minimize(const char *witnessPath, const char *outputPath,
+                            void (*model)(void)) {
+  Witness witness;
+  if (!loadWitness(witnessPath, witness)) {
+    return 1;
+  }
+  run(witness, model);
+  if (!g_replay.confirmed) {
+    std::fprintf(stderr, "[cex] %s: rejected: %s\n", witnessPath,
+                 g_replay.reason.c_str());
+    return 1;
+  }
+
+  Minimizer minimizer(witness, model, g_replay.badProperty);
+  const Witness minimal = minimizer.minimize();
+  std::fprintf(stderr,
+               "[cex] %s: %zu frames and %zu nonzero values, minimized to "
+               "%zu frames and %zu nonzero values in %zu replays\n",
+               witnessPath, witness.numFrames, countNonzero(witness),
+               minimal.numFrames, countNonzero(minimal), minimizer.tests);
+  return writeWitness(outputPath, minimal) ? 0 : 1;
+}
+
+extern "C" int cex_reconstruct(const char *tracePath, uint64_t step,
+                               void (*model)(void)) {
+  Reconstruction &trace = g_reconstruct;
+  trace = Reconstruction();
+  if (!loadTrace(tracePath, trace)) {
+    return 1;
+  }
+  trace.target = step;
+  auto latest = trace.checkpoints.upper_bound(step);
+  if (latest != trace.checkpoints.begin()) {
+    trace.resumeFrom = &std::prev(latest)->second;
+  }
+
+  g_replay.reason.clear();
+  g_replay.trackerCalls = 0;
+  g_replay.mode = MODE_RECONSTRUCT;
+  if (setjmp(g_replay.stop) == 0) {
+    model();
+    g_replay.reason = "the model returned";
+  }
+  g_replay.mode = MODE_OFF;
+
+  if (!trace.collecting) {
+    std::fprintf(stderr, "[cex] %s: %s\n", tracePath,
+                 g_replay.reason.c_str());
+    return 1;
+  }
+  if (trace.resumed) {
+    std::fprintf(stderr, "[cex] %s: resumed from step %llu\n", tracePath,
+                 static_cast<unsigned long long>(trace.resumeFrom->step));
+  }
+  char line[cex::traceLineSize];
+  for (const cex::TraceRecord &record : trace.states) {
+    std::fwrite(line, 1, cex::formatTraceRecord(record, line), stdout);
+  }
+  return 0;
+}
@@ -0,0 +1,47 @@
+//===- replay.h - Replay of BTOR2 witnesses inside libcex -------*- C++ -*-===//
+//
+// This file is licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// While cex_replay or cex_reconstruct run a model, the runtime hooks of libcex
+// hand their calls to the functions below instead of generating values and
+// tracing them.
+//
+//===----------------------------------------------------------------------===//
+#ifndef CEX_REPLAY_H
+#define CEX_REPLAY_H
+
+#include "trace.h"
+
+#include <cstdint>
+
+namespace cex {
+
+/// @return true while cex_replay runs a model
+bool replayActive();
+
+/// @return the next nondeterministic value of the model
+uint32_t replayDraw();
+
+/// Called by the hooks with the record they would otherwise trace
+void replayRecord(TraceKind kind, uint32_t num, uint64_t index,
+                  uint64_t value, uint32_t width);
+
+/// @return true if the model should start from recorded states
+bool replayResume(bool resumable);
+
+/// @return the recorded value of state id to start from
+uint64_t replayResumeState(uint64_t id);
+
+/// @return true if the model should report its states at this step
+bool replayCheckpointDue();
+
+/// Ends the current run of the model, e.g. on a failed assumption
+[[noreturn]] void replayStop(const char *reason);
+
+} // namespace cex
+
+#endif
@@ -0,0 +1,99 @@
+//===- trace.h - Binary trace records written by libcex ---------*- C++ -*-===//
+//
+// This file is licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// A binary trace is traceMagic followed by fixed size TraceRecords, in the
+// order in which the runtime hooks were called. formatTraceRecord gives the
+// textual line that libcex prints for a record when no trace file is set.
+//
+//===----------------------------------------------------------------------===//
+#ifndef CEX_TRACE_H
+#define CEX_TRACE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+namespace cex {
+
+constexpr char traceMagic[8] = {'C', 'E', 'X', 'T', 'R', 0, 0, 1};
+
+enum TraceKind : uint8_t {
+  TRACE_INPUT = 0,
+  TRACE_STATE = 1,
+  TRACE_ARRAY = 2,
+  TRACE_LOOP = 3,
+  TRACE_ASSERT = 4,
+  // the value of state num, a BTOR2 id, at the head of step index
+  TRACE_CHECKPOINT = 5,
+  // the records that follow are of the thread with index value
+  TRACE_THREAD = 6,
+};
+
+/// A value wider than 64 bits takes one record per 64 bit word, lowest word
+/// first, which all carry the width of the value
+struct TraceRecord {
+  uint8_t kind;
+  uint8_t reserved;
+  uint16_t word;
+  uint32_t num;
+  uint32_t width;
+  uint32_t index;
+  uint64_t value;
+};
+
+static_assert(sizeof(TraceRecord) == 24, "trace records are 24 bytes");
+
+constexpr size_t traceLineSize = 128;
+
+/// Print record as one line of text into buffer, which should hold at least
+/// traceLineSize bytes. The words of a value wider than 64 bits end with the
+/// number of the word.
+/// @return the length of the line, or 0 for an unknown record kind
+inline int formatTraceRecord(const TraceRecord &record, char *buffer) {
+  const unsigned long long value = record.value;
+  const bool isWide = record.width > 64;
+  switch (record.kind) {
+  case TRACE_INPUT:
+  case TRACE_STATE: {
+    const char *kind = record.kind == TRACE_INPUT ? "input" : "state";
+    if (isWide) {
+      return std::snprintf(buffer, traceLineSize, "%s, %u, %llu, %u, %u\n",
+                           kind, record.num, value, record.width, record.word);
+    }
+    return std::snprintf(buffer, traceLineSize, "%s, %u, %llu, %u\n", kind,
+                         record.num, value, record.width);
+  }
+  case TRACE_ARRAY:
+    if (isWide) {
+      return std::snprintf(buffer, traceLineSize,
+                           "array, %u, %u, %llu, %u, %u\n", record.num,
+                           record.index, value, record.width, record.word);
+    }
+    return std::snprintf(buffer, traceLineSize, "array, %u, %u, %llu, %u\n",
+                         record.num, record.index, value, record.width);
+  case TRACE_LOOP:
+    return std::snprintf(buffer, traceLineSize, "finished another loop\n");
+  case TRACE_CHECKPOINT:
+    return std::snprintf(buffer, traceLineSize,
+                         "checkpoint, %u, %u, %llu, %u\n", record.index,
+                         record.num, value, record.width);
+  case TRACE_THREAD:
+    return std::snprintf(buffer, traceLineSize, "thread, %llu\n", value);
+  case TRACE_ASSERT:
+    return std::snprintf(buffer, traceLineSize,
+                         "[sea] __VERIFIER_assert was called for property: "
+                         "%u\n",
+                         record.num);
+  default:
+    return 0;
+  }
+}
+
+} // namespace cex
+
+#endif
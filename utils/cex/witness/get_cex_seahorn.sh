@@ -52,8 +52,8 @@ clang++-14 $BTOR.mlir.opt.ll /tmp/h2.ll $BTOR2MLIR/run/lib/libcex.a -o h2.out
 echo "./h2.out > /tmp/h2.txt"
 env ./h2.out > /tmp/h2.txt
 
-echo "python3 witness_generator.py /tmp/h2.txt"
-python3 witness_generator.py /tmp/h2.txt
+echo "$BTOR2MLIR/bin/btor2mlir-witness /tmp/h2.txt -o cex.txt"
+$BTOR2MLIR/bin/btor2mlir-witness /tmp/h2.txt -o cex.txt
 
 # echo "$BTORTOOLS/btorsim -v $BTOR cex.txt"
 # $BTORTOOLS/btorsim -v $BTOR cex.txt
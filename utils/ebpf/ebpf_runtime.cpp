@@ -0,0 +1,345 @@
+#include "ebpf_runtime.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// map types and update flags as defined by linux/bpf.h
+enum MapType : int64_t {
+  BPF_MAP_TYPE_HASH = 1,
+  BPF_MAP_TYPE_ARRAY = 2,
+  BPF_MAP_TYPE_PERCPU_ARRAY = 6,
+  BPF_MAP_TYPE_LRU_HASH = 9,
+};
+
+enum UpdateFlags : int64_t { BPF_ANY = 0, BPF_NOEXIST = 1, BPF_EXIST = 2 };
+
+unsigned numCpus() {
+  static const unsigned cpus = std::max(1u, std::thread::hardware_concurrency());
+  return cpus;
+}
+
+[[noreturn]] void fail(const char *message, int64_t value) {
+  std::fprintf(stderr, "[ebpf] %s: %lld\n", message,
+               static_cast<long long>(value));
+  std::abort();
+}
+
+std::mutex g_cpusMutex;
+std::vector<bool> g_usedCpus;
+
+/// A cpu that a thread holds from its first use until it exits, so that no
+/// two threads share the per-cpu values of a cpu
+struct CpuSlot {
+  CpuSlot() {
+    std::lock_guard<std::mutex> lock(g_cpusMutex);
+    g_usedCpus.resize(numCpus());
+    auto free = std::find(g_usedCpus.begin(), g_usedCpus.end(), false);
+    if (free == g_usedCpus.end()) {
+      fail("more threads run programs than there are cpus", numCpus());
+    }
+    *free = true;
+    cpu = free - g_usedCpus.begin();
+  }
+
+  ~CpuSlot() {
+    std::lock_guard<std::mutex> lock(g_cpusMutex);
+    g_usedCpus[cpu] = false;
+  }
+
+  unsigned cpu;
+};
+
+/// Each thread that runs a program behaves as one cpu
+unsigned currentCpu() {
+  thread_local const CpuSlot slot;
+  return slot.cpu;
+}
+
+struct Map {
+  Map(int64_t key_size, int64_t value_size, int64_t max_entries)
+      : key_size(key_size), value_size(value_size), max_entries(max_entries) {}
+  virtual ~Map() = default;
+
+  virtual void *lookup(const uint8_t *key) = 0;
+  virtual int64_t update(const uint8_t *key, const uint8_t *value,
+                         int64_t flags) = 0;
+  virtual int64_t remove(const uint8_t *key) = 0;
+
+  const size_t key_size, value_size, max_entries;
+};
+
+/// Array maps are indexed by a 32 bit key; per-cpu arrays keep one copy of
+/// every value for each cpu
+struct ArrayMap : public Map {
+  ArrayMap(int64_t key_size, int64_t value_size, int64_t max_entries,
+           bool per_cpu)
+      : Map(key_size, value_size, max_entries),
+        copies(per_cpu ? numCpus() : 1),
+        values(copies * max_entries * value_size, 0) {}
+
+  uint8_t *slot(const uint8_t *key) {
+    uint32_t index;
+    std::memcpy(&index, key, sizeof(index));
+    if (index >= max_entries) {
+      return nullptr;
+    }
+    const unsigned copy = copies > 1 ? currentCpu() : 0;
+    return &values[(copy * max_entries + index) * value_size];
+  }
+
+  void *lookup(const uint8_t *key) override { return slot(key); }
+
+  int64_t update(const uint8_t *key, const uint8_t *value,
+                 int64_t flags) override {
+    uint8_t *dst = slot(key);
+    if (!dst) {
+      return -E2BIG;
+    }
+    if (flags == BPF_NOEXIST) {
+      // every element of an array exists
+      return -EEXIST;
+    }
+    std::memcpy(dst, value, value_size);
+    return 0;
+  }
+
+  int64_t remove(const uint8_t *) override { return -EINVAL; }
+
+  const size_t copies;
+  std::vector<uint8_t> values;
+};
+
+/// Set when a hash map retires a value, so that quiescing is free otherwise
+std::atomic<bool> g_retired{false};
+
+/// The values of a hash map are never written once a lookup may have
+/// returned them: as in the kernel, an update stores a new copy of the value
+/// and a program writes to the copy it looked up. The old copies are freed
+/// by ebpf_runtime_quiesce. LRU maps evict the least recently used entry
+/// instead of failing when they are full.
+struct HashMap : public Map {
+  HashMap(int64_t key_size, int64_t value_size, int64_t max_entries, bool lru)
+      : Map(key_size, value_size, max_entries), lru(lru) {}
+
+  struct Entry {
+    std::unique_ptr<uint8_t[]> value;
+    std::atomic<uint64_t> lastUse{0};
+  };
+
+  void *lookup(const uint8_t *key) override {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto it = entries.find(std::string(key, key + key_size));
+    if (it == entries.end()) {
+      return nullptr;
+    }
+    if (lru) {
+      it->second.lastUse.store(clock.fetch_add(1, std::memory_order_relaxed),
+                               std::memory_order_relaxed);
+    }
+    return it->second.value.get();
+  }
+
+  int64_t update(const uint8_t *key, const uint8_t *value,
+                 int64_t flags) override {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    std::string k(key, key + key_size);
+    auto it = entries.find(k);
+    if (it != entries.end() && flags == BPF_NOEXIST) {
+      return -EEXIST;
+    }
+    if (it == entries.end() && flags == BPF_EXIST) {
+      return -ENOENT;
+    }
+    if (it == entries.end() && entries.size() >= max_entries) {
+      if (!lru || entries.empty()) {
+        return -E2BIG;
+      }
+      evictLeastRecentlyUsed();
+    }
+    std::unique_ptr<uint8_t[]> v(new uint8_t[value_size]);
+    std::memcpy(v.get(), value, value_size);
+    Entry &entry = it != entries.end() ? it->second : entries[std::move(k)];
+    if (entry.value) {
+      // a program may still hold a pointer to the old value
+      retire(std::move(entry.value));
+    }
+    entry.value = std::move(v);
+    entry.lastUse.store(clock.fetch_add(1, std::memory_order_relaxed),
+                        std::memory_order_relaxed);
+    return 0;
+  }
+
+  int64_t remove(const uint8_t *key) override {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    auto it = entries.find(std::string(key, key + key_size));
+    if (it == entries.end()) {
+      return -ENOENT;
+    }
+    // a program may still hold a pointer to the value
+    retire(std::move(it->second.value));
+    entries.erase(it);
+    return 0;
+  }
+
+  /// Frees the retired values; no program may run on the map meanwhile
+  void reclaim() {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    retired.clear();
+  }
+
+  void retire(std::unique_ptr<uint8_t[]> value) {
+    retired.push_back(std::move(value));
+    g_retired.store(true, std::memory_order_relaxed);
+  }
+
+  /// The kernel only approximates the order of use as well, so a scan is
+  /// enough for the sizes of maps that programs are benchmarked with
+  void evictLeastRecentlyUsed() {
+    auto victim = entries.begin();
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+      if (it->second.lastUse.load(std::memory_order_relaxed) <
+          victim->second.lastUse.load(std::memory_order_relaxed)) {
+        victim = it;
+      }
+    }
+    retire(std::move(victim->second.value));
+    entries.erase(victim);
+  }
+
+  const bool lru;
+  std::atomic<uint64_t> clock{0};
+  std::shared_mutex mutex;
+  std::unordered_map<std::string, Entry> entries;
+  std::vector<std::unique_ptr<uint8_t[]>> retired;
+};
+
+constexpr int64_t maxMapFd = 1024;
+std::atomic<Map *> g_maps[maxMapFd];
+std::mutex g_mapsMutex;
+
+Map *toMap(int64_t map) { return reinterpret_cast<Map *>(map); }
+const uint8_t *toBytes(int64_t ptr) {
+  return reinterpret_cast<const uint8_t *>(ptr);
+}
+
+} // namespace
+
+extern "C" {
+
+int64_t ebpf_map_get(int64_t fd, int64_t type, int64_t key_size,
+                     int64_t value_size, int64_t max_entries) {
+  if (fd < 0 || fd >= maxMapFd) {
+    fail("map fd out of range", fd);
+  }
+  if (Map *map = g_maps[fd].load(std::memory_order_acquire)) {
+    return reinterpret_cast<int64_t>(map);
+  }
+  std::lock_guard<std::mutex> lock(g_mapsMutex);
+  if (Map *map = g_maps[fd].load(std::memory_order_relaxed)) {
+    return reinterpret_cast<int64_t>(map);
+  }
+  Map *map = nullptr;
+  switch (type) {
+  case BPF_MAP_TYPE_HASH:
+    map = new HashMap(key_size, value_size, max_entries, false);
+    break;
+  case BPF_MAP_TYPE_LRU_HASH:
+    map = new HashMap(key_size, value_size, max_entries, true);
+    break;
+  case BPF_MAP_TYPE_ARRAY:
+    map = new ArrayMap(key_size, value_size, max_entries, false);
+    break;
+  case BPF_MAP_TYPE_PERCPU_ARRAY:
+    map = new ArrayMap(key_size, value_size, max_entries, true);
+    break;
+  default:
+    fail("unsupported map type", type);
+  }
+  g_maps[fd].store(map, std::memory_order_release);
+  return reinterpret_cast<int64_t>(map);
+}
+
+int64_t ebpf_helper_map_lookup_elem(int64_t map, int64_t key, int64_t, int64_t,
+                                    int64_t) {
+  return reinterpret_cast<int64_t>(toMap(map)->lookup(toBytes(key)));
+}
+
+int64_t ebpf_helper_map_update_elem(int64_t map, int64_t key, int64_t value,
+                                    int64_t flags, int64_t) {
+  return toMap(map)->update(toBytes(key), toBytes(value), flags);
+}
+
+int64_t ebpf_helper_map_delete_elem(int64_t map, int64_t key, int64_t, int64_t,
+                                    int64_t) {
+  return toMap(map)->remove(toBytes(key));
+}
+
+int64_t ebpf_helper_ktime_get_ns(int64_t, int64_t, int64_t, int64_t, int64_t) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+int64_t ebpf_helper_trace_printk(int64_t fmt, int64_t fmt_size, int64_t,
+                                 int64_t, int64_t) {
+  // the format is printed as is, without its arguments
+  std::fwrite(toBytes(fmt), 1, strnlen(reinterpret_cast<const char *>(fmt),
+                                       static_cast<size_t>(fmt_size)),
+              stderr);
+  return fmt_size;
+}
+
+int64_t ebpf_helper_get_prandom_u32(int64_t, int64_t, int64_t, int64_t,
+                                    int64_t) {
+  thread_local std::minstd_rand generator(std::random_device{}());
+  return static_cast<uint32_t>(generator());
+}
+
+int64_t ebpf_helper_get_smp_processor_id(int64_t, int64_t, int64_t, int64_t,
+                                         int64_t) {
+  return currentCpu();
+}
+
+int64_t ebpf_helper_unsupported(int64_t helper) {
+  fail("unsupported helper", helper);
+}
+
+void ebpf_assertion_failed(void) {
+  std::fprintf(stderr, "[ebpf] memory access out of bounds or through null\n");
+  std::abort();
+}
+
+void ebpf_runtime_quiesce(void) {
+  if (!g_retired.exchange(false, std::memory_order_acquire)) {
+    return;
+  }
+  for (auto &slot : g_maps) {
+    Map *map = slot.load(std::memory_order_acquire);
+    if (auto *hash = dynamic_cast<HashMap *>(map)) {
+      hash->reclaim();
+    }
+  }
+}
+
+void ebpf_runtime_reset(void) {
+  std::lock_guard<std::mutex> lock(g_mapsMutex);
+  for (auto &map : g_maps) {
+    delete map.exchange(nullptr);
+  }
+}
+}
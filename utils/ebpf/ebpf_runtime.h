@@ -0,0 +1,50 @@
+//===- ebpf_runtime.h - Local Map Runtime for eBPF -----------------*- C++ -*-===//
+//
+// This file is licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+#ifndef EBPF_RUNTIME_H
+#define EBPF_RUNTIME_H
+
+#include <cstdint>
+
+// Programs lowered with --convert-ebpf-to-llvm="ebpf-runtime=native" call
+// these functions. Every value is passed as a 64 bit register, and pointers
+// (maps, keys and values) are plain addresses.
+extern "C" {
+
+/// Returns the map for `fd`, creating it on first use
+extern int64_t ebpf_map_get(int64_t fd, int64_t type, int64_t key_size,
+                            int64_t value_size, int64_t max_entries);
+
+extern int64_t ebpf_helper_map_lookup_elem(int64_t map, int64_t key, int64_t,
+                                           int64_t, int64_t);
+extern int64_t ebpf_helper_map_update_elem(int64_t map, int64_t key,
+                                           int64_t value, int64_t flags,
+                                           int64_t);
+extern int64_t ebpf_helper_map_delete_elem(int64_t map, int64_t key, int64_t,
+                                           int64_t, int64_t);
+extern int64_t ebpf_helper_ktime_get_ns(int64_t, int64_t, int64_t, int64_t,
+                                        int64_t);
+extern int64_t ebpf_helper_trace_printk(int64_t fmt, int64_t fmt_size,
+                                        int64_t, int64_t, int64_t);
+extern int64_t ebpf_helper_get_prandom_u32(int64_t, int64_t, int64_t, int64_t,
+                                           int64_t);
+extern int64_t ebpf_helper_get_smp_processor_id(int64_t, int64_t, int64_t,
+                                                int64_t, int64_t);
+extern int64_t ebpf_helper_unsupported(int64_t helper);
+
+/// Called when a memory access fails the checks of the importer
+extern void ebpf_assertion_failed(void);
+
+/// Frees the map values that updates and deletes replaced. Call it while no
+/// program runs, e.g. after each run of a program.
+extern void ebpf_runtime_quiesce(void);
+
+/// Drops every map, e.g. between runs of a benchmark
+extern void ebpf_runtime_reset(void);
+}
+
+#endif
@@ -1,9 +1,22 @@
-/** Definitions of nd() functions for fuzzing */
+/** Definitions of nd() functions for fuzzing
+ *
+ * Links a lowered model into a libFuzzer target: every nondeterministic value
+ * of the model is read from the fuzz input, and _main runs until the input is
+ * used up, an assumption fails, or FUZZ_MAX_STEPS steps are done. A violated
+ * property aborts, so that libFuzzer saves the input as a crash. Running the
+ * target on that input with FUZZ_TRACE=1 prints the trace of libcex, which
+ * btor2mlir-witness turns into a BTOR2 witness:
+ *
+ *   clang -fsanitize=fuzzer model.ll libfuzz.a -o model-fuzz
+ *   ./model-fuzz corpus/
+ *   FUZZ_TRACE=1 ./model-fuzz crash-<sha1> | btor2mlir-witness -o cex.txt
+ */
 
 #include <assert.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <setjmp.h>
@@ -16,11 +29,27 @@ uint8_t *g_fuzz_data_iterator;
 /** jmp environment */
 jmp_buf g_jmp_buf;
 
+/** Bound on the steps of _main per input, from FUZZ_MAX_STEPS */
+uint64_t g_max_steps = 1024;
+uint64_t g_steps;
+/** The first input of a step: the model draws it again in the next step */
+int64_t g_step_input;
+/** Print the trace of libcex, from FUZZ_TRACE */
+bool g_fuzz_trace;
+
+// -- the model has used up the input
 #define UPDATE_FUZZ_ITERATOR(TYPE)                                             \
-  if (g_fuzz_data_iterator + sizeof(TYPE) - g_fuzz_data >= g_fuzz_data_size) { \
-    longjmp(g_jmp_buf, 1);                                             \
+  if ((size_t)(g_fuzz_data_iterator - g_fuzz_data) + sizeof(TYPE) >            \
+      g_fuzz_data_size) {                                                      \
+    longjmp(g_jmp_buf, 1);                                                     \
   }
 
+static void count_step(void) {
+  if (++g_steps > g_max_steps) {
+    longjmp(g_jmp_buf, 1);
+  }
+}
+
 // bool nd_bool(void) {
 //   int tmp;
 //   UPDATE_FUZZ_ITERATOR(bool)
@@ -65,10 +94,18 @@ uint32_t nd_bv32(void) {
   UPDATE_FUZZ_ITERATOR(uint32_t);
   memcpy(&res, g_fuzz_data_iterator, sizeof(uint32_t));
   g_fuzz_data_iterator += sizeof(uint32_t);
-  fprintf(stdout, "[sea] nd_bv32: %d\n", res);
-  fflush(stdout);
 
-  return 1;
+  return res;
+}
+
+uint64_t nd_64(void) {
+  uint64_t res;
+
+  UPDATE_FUZZ_ITERATOR(uint64_t);
+  memcpy(&res, g_fuzz_data_iterator, sizeof(uint64_t));
+  g_fuzz_data_iterator += sizeof(uint64_t);
+
+  return res;
 }
 
 // uint64_t nd_uint64_t(void) {
@@ -113,14 +150,12 @@ uint32_t nd_bv32(void) {
 //   g_fuzz_data_iterator += size;
 // }
 
-void __VERIFIER_assert(bool v, int property) {
-  fprintf(stdout, "CHECK ASSERT\n");
-  if (v) {
-    fprintf(stdout, "[sea] __VERIFIER_assert was called for property: %d\n", property);
+void __VERIFIER_assert(bool v, int64_t property) {
+  // -- called on the way to __VERIFIER_error, with the violated property
+  if (!v) {
+    fprintf(stdout, "[sea] __VERIFIER_assert was called for property: %lld\n",
+            (long long)property);
   }
-  fflush(stdout);
-
-  return;
 }
 
 void __SEA_assume(bool v) {
@@ -135,41 +170,118 @@ void __VERIFIER_assume(int v) {
 }
 
 void __VERIFIER_error() {
+  // -- libFuzzer reports the abort as a crash, and saves the input
   fprintf(stdout, "[sea] __VERIFIER_error was executed\n");
   fflush(stdout);
-  assert(0);
+  abort();
 }
 
 void __TRACKER() {
-  fprintf(stdout, "finished another loop\n");
-  fflush(stdout);
+  // -- without inputs, the tracker calls before each property bound the steps
+  if (g_step_input < 0) {
+    count_step();
+  }
+  if (g_fuzz_trace) {
+    fprintf(stdout, "finished another loop\n");
+  }
 }
 
-void btor2mlir_print_input_num(unsigned num, unsigned value, unsigned width) { 
-  fprintf(stdout, "input, %d, %d, %d\n", num, value, width);
-  fflush(stdout);
+void btor2mlir_print_input_num(uint64_t num, uint64_t value, uint64_t width) {
+  if (g_step_input < 0) {
+    g_step_input = (int64_t)num;
+  } else if ((int64_t)num == g_step_input) {
+    count_step();
+  }
+  if (g_fuzz_trace) {
+    fprintf(stdout, "input, %llu, %llu, %llu\n", (unsigned long long)num,
+            (unsigned long long)value, (unsigned long long)width);
+  }
 }
 
-void btor2mlir_print_state_num(unsigned num, unsigned value, unsigned width) { 
-  fprintf(stdout, "state, %d, %d, %d\n", num, value, width);
-  fflush(stdout);
+void btor2mlir_print_state_num(uint64_t num, uint64_t value, uint64_t width) {
+  if (g_fuzz_trace) {
+    fprintf(stdout, "state, %llu, %llu, %llu\n", (unsigned long long)num,
+            (unsigned long long)value, (unsigned long long)width);
+  }
 }
 
-void btor2mlir_print_array_state_num(unsigned num, unsigned index, unsigned value, unsigned width) { 
-  fprintf(stdout, "state, %d, %d, %d, %d\n", num, index, value, width);
-  fflush(stdout);
+void btor2mlir_print_array_state_num(uint64_t num, uint64_t index,
+                                     uint64_t value, uint64_t width) {
+  if (g_fuzz_trace) {
+    fprintf(stdout, "array, %llu, %llu, %llu, %llu\n", (unsigned long long)num,
+            (unsigned long long)index, (unsigned long long)value,
+            (unsigned long long)width);
+  }
+}
+
+// -- values wider than 64 bits are printed one 64 bit word at a time
+void btor2mlir_print_input_word(uint64_t num, uint64_t word, uint64_t value,
+                                uint64_t width) {
+  if (word == 0) {
+    btor2mlir_print_input_num(num, value, width);
+  } else if (g_fuzz_trace) {
+    fprintf(stdout, "input, %llu, %llu, %llu, %llu\n", (unsigned long long)num,
+            (unsigned long long)value, (unsigned long long)width,
+            (unsigned long long)word);
+  }
+}
+
+void btor2mlir_print_state_word(uint64_t num, uint64_t word, uint64_t value,
+                                uint64_t width) {
+  if (g_fuzz_trace) {
+    fprintf(stdout, "state, %llu, %llu, %llu, %llu\n", (unsigned long long)num,
+            (unsigned long long)value, (unsigned long long)width,
+            (unsigned long long)word);
+  }
+}
+
+void btor2mlir_print_array_state_word(uint64_t num, uint64_t index,
+                                      uint64_t word, uint64_t value,
+                                      uint64_t width) {
+  if (g_fuzz_trace) {
+    fprintf(stdout, "array, %llu, %llu, %llu, %llu, %llu\n",
+            (unsigned long long)num, (unsigned long long)index,
+            (unsigned long long)value, (unsigned long long)width,
+            (unsigned long long)word);
+  }
 }
 
 /** expected entry of verification harness */
-extern int _main(void);
+extern void _main(void);
+
+/** coverage counters of a model lowered with convert-btor-to-llvm=coverage */
+extern uint8_t btor2mlir_coverage[] __attribute__((weak));
+extern const uint64_t btor2mlir_coverage_size __attribute__((weak));
+extern void __sanitizer_cov_8bit_counters_init(uint8_t *start, uint8_t *end)
+    __attribute__((weak));
+
+int LLVMFuzzerInitialize(int *argc, char ***argv) {
+  (void)argc;
+  (void)argv;
+  // -- libFuzzer is guided by the state coverage of the model as well
+  if (&btor2mlir_coverage_size && __sanitizer_cov_8bit_counters_init) {
+    __sanitizer_cov_8bit_counters_init(
+        btor2mlir_coverage, btor2mlir_coverage + btor2mlir_coverage_size);
+  }
+
+  const char *max_steps = getenv("FUZZ_MAX_STEPS");
+  const char *trace = getenv("FUZZ_TRACE");
+  if (max_steps) {
+    g_max_steps = strtoull(max_steps, NULL, 0);
+  }
+  g_fuzz_trace = trace && strcmp(trace, "0") != 0;
+  return 0;
+}
 
-int LLVMFuzzerTestOneInput(uint8_t *Data, size_t Size) {
-  g_fuzz_data = Data;
+int LLVMFuzzerTestOneInput(const uint8_t *Data, size_t Size) {
+  g_fuzz_data = (uint8_t *)Data;
   g_fuzz_data_size = Size;
   g_fuzz_data_iterator = g_fuzz_data;
+  g_steps = 0;
+  g_step_input = -1;
 
   if (setjmp(g_jmp_buf)) {
-    // assumption failed, abort
+    // input exhausted, step bound reached or assumption failed
     return 0;
   }
   _main();